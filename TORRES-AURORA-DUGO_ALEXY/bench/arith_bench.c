@@ -0,0 +1,83 @@
+// Counting loop cost : "i = i + 1" evaluated 1M times through the cache,
+// compiled again on every iteration, and forking expr like the scripts
+// did before $((...)).
+//
+// Usage : bench/arith_bench [iterations]
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+
+// MODULES INCLUDES
+#include "arith.h"
+#include "vars.h"
+
+// Forks are slow, the expr loop is shorter and scaled
+#define EXPR_ITERATIONS 1000
+
+extern char **environ;
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} // double now_ms()
+
+int main(int argc, char **argv)
+{
+    long iterations = argc > 1 ? atol(argv[1]) : 1000000;
+    const char *text = "i = i + 1";
+    long long result = 0;
+    double start, elapsed;
+    long n;
+
+    vars_set("i", "0");
+    start = now_ms();
+    for(n = 0; n < iterations; ++n)
+        arith_eval(text, strlen(text), &result);
+    elapsed = now_ms() - start;
+    printf("arith : %ld iterations cached     %8.1f ms  %6.0f ns/iteration  (i = %s)\n",
+           iterations, elapsed, elapsed * 1e6 / iterations, vars_get("i"));
+
+    vars_set("i", "0");
+    start = now_ms();
+    for(n = 0; n < iterations; ++n)
+    {
+        struct arith_expr *expr = arith_compile(text, strlen(text));
+        arith_run(expr, &result);
+        arith_free(expr);
+    }
+    elapsed = now_ms() - start;
+    printf("arith : %ld iterations recompiled %8.1f ms  %6.0f ns/iteration\n",
+           iterations, elapsed, elapsed * 1e6 / iterations);
+
+    // One expr process per iteration, output thrown away
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    char *expr_argv[] = {"expr", "1", "+", "1", NULL};
+    start = now_ms();
+    for(n = 0; n < EXPR_ITERATIONS; ++n)
+    {
+        pid_t pid;
+        int status;
+        if(posix_spawnp(&pid, "expr", &actions, NULL, expr_argv, environ) != 0)
+            break;
+        waitpid(pid, &status, 0);
+    }
+    elapsed = now_ms() - start;
+    posix_spawn_file_actions_destroy(&actions);
+    printf("arith : %ld iterations with expr  %8.1f ms  %6.0f ns/iteration (extrapolated from %d)\n",
+           iterations, elapsed * iterations / EXPR_ITERATIONS, elapsed * 1e6 / EXPR_ITERATIONS, EXPR_ITERATIONS);
+
+    return EXIT_SUCCESS;
+} // int main(int, char**)
@@ -0,0 +1,45 @@
+#!/bin/bash
+# Result cache : a slow deterministic command over an input file run
+# plain, then behind cached once to fill the cache and again on hits.
+# Reports the time per run and the hit rate from stats.
+#
+# Usage : bench/cached.sh [runs] [input lines]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+RUNS=${1:-50}
+LINES=${2:-200000}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+seq "$LINES" > "$TMP/input"
+cat > "$TMP/work.sh" <<EOF
+sort -n -r $TMP/input | md5sum
+EOF
+
+run() {
+    local name=$1 prefix=$2
+    {
+        echo "ASR2_CACHE_DIR=$TMP/cache"
+        for i in $(seq "$RUNS"); do
+            echo "$prefix sh $TMP/work.sh"
+        done
+        echo "stats"
+    } > "$TMP/$name.sh"
+
+    local TIMEFORMAT="%R"
+    local elapsed
+    elapsed=$( { time "$SHELL_BIN" -c "$TMP/$name.sh" < /dev/null > "$TMP/$name.out" 2>&1; } 2>&1 )
+    awk -v n="$name" -v s="$elapsed" -v r="$RUNS" '
+        /^cache_rate/ { rate = $2 }
+        / -$/ { sums[$1] = 1 }
+        END {
+            count = 0
+            for(k in sums) count++
+            printf "cached : %-6s %4d runs %8.0f ms %8.2f ms/run  hit rate %-6s %d distinct outputs\n",
+                   n, r, s * 1e3, s * 1e3 / r, rate == "" ? "-" : rate, count
+        }' "$TMP/$name.out"
+}
+
+run plain ""
+run cold "cached -i $TMP/input --"
+run warm "cached -i $TMP/input --"
@@ -0,0 +1,55 @@
+#!/bin/bash
+# cd cost : going back and forth between two deep directories, with
+# and without pwd, in the shell against bash and dash.
+#
+# Usage : bench/cd.sh [iterations]
+
+SHELL_BIN=${SHELL_BIN:-./main}
+ITERATIONS=${1:-50000}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+mkdir -p "$TMP/one/a/b/c/d/e/f/g" "$TMP/two/a/b/c/d/e/f/g"
+
+cat > "$TMP/cd.sh" <<EOF
+i=0
+while [ \$i -lt $ITERATIONS ]; do
+    cd $TMP/one/a/b/c/d/e/f/g
+    cd ../../../../../../../../two/a/b/c/d/e/f/g
+    i=\$((i + 1))
+done
+EOF
+
+cat > "$TMP/pwd.sh" <<EOF
+i=0
+while [ \$i -lt $ITERATIONS ]; do
+    cd $TMP/one/a/b/c/d/e/f/g
+    pwd
+    cd $TMP/two/a/b/c/d/e/f/g
+    pwd
+    i=\$((i + 1))
+done
+EOF
+
+# Prints the time per cd of a script, best of RUNS runs
+run() {
+    local label=$1 shell=$2 script=$3
+    local TIMEFORMAT="%R"
+    local elapsed best=""
+    [ -x "$(command -v "$shell")" ] || return
+    for i in $(seq "${RUNS:-3}"); do
+        elapsed=$( { time "$shell" $4 "$script" < /dev/null > /dev/null 2>&1; } 2>&1 )
+        if [ -z "$best" ] || awk -v a="$elapsed" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+            best=$elapsed
+        fi
+    done
+    awk -v l="$label" -v n="$((ITERATIONS * 2))" -v s="$best" \
+        'BEGIN { printf "%-28s %8.0f ms  %6.2f us/cd\n", l, s * 1e3, s * 1e6 / n }'
+}
+
+run "cd (shell)" "$SHELL_BIN" "$TMP/cd.sh" -c
+run "cd (bash)" bash "$TMP/cd.sh"
+run "cd (dash)" dash "$TMP/cd.sh"
+run "cd + pwd (shell)" "$SHELL_BIN" "$TMP/pwd.sh" -c
+run "cd + pwd (bash)" bash "$TMP/pwd.sh"
+run "cd + pwd (dash)" dash "$TMP/pwd.sh"
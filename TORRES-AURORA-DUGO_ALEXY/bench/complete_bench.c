@@ -0,0 +1,92 @@
+// Command completion latency : a PATH of N executables, first completion
+// builds the trie, the next ones only stat the PATH directories.
+//
+// Usage : bench/complete_bench [executables]
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+
+// MODULES INCLUDES
+#include "complete.h"
+
+#define COMPLETIONS 1000
+#define DIRS 10
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} // double now_ms()
+
+int main(int argc, char **argv)
+{
+    long executables = argc > 1 ? atol(argv[1]) : 20000;
+    char root[] = "/tmp/complete_bench.XXXXXX";
+    char path[DIRS * 64], dir[48], file[PATH_MAX], line[64];
+    char *old_path = getenv("PATH") ? strdup(getenv("PATH")) : NULL;
+    struct completion result;
+    double start, worst = 0, total = 0;
+    long i;
+
+    if(mkdtemp(root) == NULL)
+        return EXIT_FAILURE;
+
+    // Executables spread over DIRS directories, like a real PATH
+    path[0] = '\0';
+    for(i = 0; i < DIRS; ++i)
+    {
+        snprintf(dir, sizeof(dir), "%s/bin%ld", root, i);
+        mkdir(dir, 0755);
+        snprintf(path + strlen(path), sizeof(path) - strlen(path), "%s%s", i ? ":" : "", dir);
+    }
+    for(i = 0; i < executables; ++i)
+    {
+        snprintf(file, sizeof(file), "%s/bin%ld/cmd%05ld", root, i % DIRS, i);
+        close(open(file, O_CREAT | O_WRONLY, 0755));
+    }
+    setenv("PATH", path, 1);
+
+    start = now_ms();
+    complete_line("cmd0000", 7, &result);
+    complete_free(&result);
+    printf("complete : %ld executables indexed in %.1f ms\n", executables, now_ms() - start);
+
+    for(i = 0; i < COMPLETIONS; ++i)
+    {
+        // From a few characters (many matches) to a full name
+        int len = snprintf(line, sizeof(line), "cmd%05ld", rand() % executables);
+        len = 3 + i % (len - 2);
+
+        start = now_ms();
+        complete_line(line, len, &result);
+        complete_free(&result);
+        double elapsed = now_ms() - start;
+        total += elapsed;
+        if(elapsed > worst)
+            worst = elapsed;
+    }
+    printf("complete : %d completions, %.3f ms average, %.3f ms worst\n",
+           COMPLETIONS, total / COMPLETIONS, worst);
+
+    // One new executable, only its directory is scanned again
+    snprintf(file, sizeof(file), "%s/bin0/zzz_new", root);
+    close(open(file, O_CREAT | O_WRONLY, 0755));
+    start = now_ms();
+    complete_line("zzz", 3, &result);
+    printf("complete : new executable found (%d) in %.3f ms\n", result.total, now_ms() - start);
+    complete_free(&result);
+
+    setenv("PATH", old_path ? old_path : "/bin:/usr/bin", 1);
+    snprintf(line, sizeof(line), "rm -rf %s", root);
+    return system(line) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+} // int main(int, char**)
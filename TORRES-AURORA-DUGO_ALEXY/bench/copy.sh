@@ -0,0 +1,39 @@
+#!/bin/bash
+# File copy throughput : builtin cat (copy_file_range, sendfile, splice)
+# against the external cat, for "cat f > out" and "cat f | wc -c".
+#
+# Usage : bench/copy.sh [size_mb]
+
+SHELL_BIN=${SHELL_BIN:-./main}
+SIZE_MB=${1:-1024}
+EXTERNAL_CAT=$(command -v cat)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom > "$TMP/big"
+
+# Prints MB/s, user and system CPU time of a script run by the shell,
+# best of RUNS runs since writeback of the previous run adds noise
+run() {
+    local label=$1 script=$2
+    local TIMEFORMAT="%R %U %S"
+    local times best=""
+    echo "$script" > "$TMP/script.sh"
+    for i in $(seq "${RUNS:-3}"); do
+        rm -f "$TMP/out"
+        sync
+        times=$( { time "$SHELL_BIN" -c "$TMP/script.sh" < /dev/null > /dev/null 2>&1; } 2>&1 )
+        if [ -z "$best" ] || awk -v a="${times%% *}" -v b="${best%% *}" 'BEGIN { exit !(a < b) }'; then
+            best=$times
+        fi
+    done
+    set -- $best
+    awk -v l="$label" -v mb="$SIZE_MB" -v r="$1" -v u="$2" -v s="$3" \
+        'BEGIN { printf "%-28s %8.0f MB/s  user %.2fs  sys %.2fs\n", l, mb / r, u, s }'
+}
+
+run "builtin cat f > out" "cat $TMP/big > $TMP/out"
+run "external cat f > out" "$EXTERNAL_CAT $TMP/big > $TMP/out"
+run "builtin cat f | wc -c" "cat $TMP/big | wc -c"
+run "external cat f | wc -c" "$EXTERNAL_CAT $TMP/big | wc -c"
+run "wc -c < f" "wc -c < $TMP/big"
@@ -0,0 +1,63 @@
+// Builtin lookup cost : the generated perfect hash against the strcmp
+// loop over the table it replaced, for builtin names and for external
+// command names, which used to go through the whole table.
+//
+// Usage : bench/dispatch_bench [lookups]
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// MODULES INCLUDES
+#include "builtins_hash.h"
+
+static const char *externals[] = {
+    "ls", "grep", "make", "gcc", "sed", "awk", "git", "find", "sort", "xargs"
+};
+
+#define EXTERNAL_COUNT (sizeof(externals) / sizeof(externals[0]))
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} // double now_ms()
+
+static int linear_find(const char *name)
+{
+    int i;
+    for(i = 0; i < BUILTINS_COUNT; ++i)
+    {
+        if(strcmp(name, builtins_names[i]) == 0)
+            return i;
+    }
+    return -1;
+} // int linear_find(const char*)
+
+static void run(const char *label, const char *const *names, size_t count, long lookups, int (*find)(const char*))
+{
+    // Keeps the lookups from being optimized away
+    volatile int sink = 0;
+    double start = now_ms();
+    long n;
+
+    for(n = 0; n < lookups; ++n)
+        sink += find(names[n % count]);
+    double elapsed = now_ms() - start;
+    printf("dispatch : %-28s %8.1f ms  %6.1f ns/lookup\n", label, elapsed, elapsed * 1e6 / lookups);
+} // run(const char*, const char* const*, size_t, long, int (*)(const char*))
+
+int main(int argc, char **argv)
+{
+    long lookups = argc > 1 ? atol(argv[1]) : 10000000;
+
+    printf("dispatch : %d builtins, %d slots\n", BUILTINS_COUNT, BUILTINS_HASH_SIZE);
+    run("builtin, perfect hash", builtins_names, BUILTINS_COUNT, lookups, builtins_find);
+    run("builtin, strcmp loop", builtins_names, BUILTINS_COUNT, lookups, linear_find);
+    run("external, perfect hash", externals, EXTERNAL_COUNT, lookups, builtins_find);
+    run("external, strcmp loop", externals, EXTERNAL_COUNT, lookups, linear_find);
+    return EXIT_SUCCESS;
+} // int main(int, char**)
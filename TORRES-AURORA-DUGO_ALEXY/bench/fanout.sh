@@ -0,0 +1,41 @@
+#!/bin/sh
+# Fan-out throughput : "producer |> (wc -c, ...)" against the classic
+# "producer | tee >(wc -c) ... | wc -c" with bash process substitution.
+#
+# Usage : bench/fanout.sh [size_mb] [consumers]
+
+SHELL_BIN=${SHELL_BIN:-./main}
+SIZE_MB=${1:-1024}
+CONSUMERS=${2:-3}
+BYTES=$((SIZE_MB * 1024 * 1024))
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+now_ns() { date +%s%N; }
+
+# Prints the GB/s delivered to each consumer
+rate() {
+    awk -v b="$BYTES" -v ns="$1" 'BEGIN { printf "%.2f GB/s", b / ns }'
+}
+
+list="wc -c"
+subst=""
+i=1
+while [ $i -lt "$CONSUMERS" ]; do
+    list="$list, wc -c"
+    subst="$subst >(wc -c > /dev/null)"
+    i=$((i + 1))
+done
+
+echo "head -c $BYTES /dev/zero |> ($list)" > "$TMP/fanout.sh"
+start=$(now_ns)
+"$SHELL_BIN" -c "$TMP/fanout.sh" < /dev/null > /dev/null 2>&1
+end=$(now_ns)
+echo "fanout  ${SIZE_MB}MB x $CONSUMERS consumers : $(rate $((end - start)))"
+
+if command -v bash > /dev/null; then
+    start=$(now_ns)
+    bash -c "head -c $BYTES /dev/zero | tee $subst | wc -c > /dev/null"
+    end=$(now_ns)
+    echo "tee     ${SIZE_MB}MB x $CONSUMERS consumers : $(rate $((end - start)))"
+fi
@@ -0,0 +1,69 @@
+#!/bin/bash
+# Call cost : a shell function called in a loop against the same
+# commands in a helper script run by a new shell on every call, then a
+# countdown whose function computes the next value from $1 and $#.
+#
+# Usage : bench/function.sh [calls]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+CALLS=${1:-10000}
+# A process per call, the helper loop is shorter and scaled
+HELPER_CALLS=$((CALLS / 50))
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cat > "$TMP/function.sh" <<EOF
+add() {
+    local sum=\$((\$1 + \$2))
+    total=\$((total + sum))
+    return 0
+}
+i=0
+total=0
+while [ \$i -lt $CALLS ]; do
+    add \$i 1
+    i=\$((i + 1))
+done
+EOF
+
+cat > "$TMP/countdown.sh" <<EOF
+dec() {
+    n=\$((\$1 - \$#))
+}
+n=$CALLS
+while [ \$n -gt 0 ]; do
+    dec \$n
+done
+EOF
+
+cat > "$TMP/helper.sh" <<EOF
+sum=\$((1 + 2))
+total=\$((sum))
+EOF
+
+cat > "$TMP/script.sh" <<EOF
+i=0
+while [ \$i -lt $HELPER_CALLS ]; do
+    $SHELL_BIN -c $TMP/helper.sh
+    i=\$((i + 1))
+done
+EOF
+
+# Prints the time per call of a script, best of RUNS runs
+run() {
+    local label=$1 script=$2 calls=$3
+    local TIMEFORMAT="%R"
+    local elapsed best=""
+    for i in $(seq "${RUNS:-3}"); do
+        elapsed=$( { time "$SHELL_BIN" -c "$script" < /dev/null > /dev/null 2>&1; } 2>&1 )
+        if [ -z "$best" ] || awk -v a="$elapsed" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+            best=$elapsed
+        fi
+    done
+    awk -v l="$label" -v n="$calls" -v s="$best" \
+        'BEGIN { printf "%-28s %6d calls %8.0f ms  %8.2f us/call\n", l, n, s * 1e3, s * 1e6 / n }'
+}
+
+run "function call" "$TMP/function.sh" "$CALLS"
+run "helper script (main -c)" "$TMP/script.sh" "$HELPER_CALLS"
+run "countdown on \$1 and \$#" "$TMP/countdown.sh" "$CALLS"
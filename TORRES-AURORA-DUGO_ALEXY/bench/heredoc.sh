@@ -0,0 +1,56 @@
+#!/bin/bash
+# Here-document cost : a small body through a pipe and a large one
+# through a memfd, against the same bytes read from a file with <.
+#
+# Usage : bench/heredoc.sh [iterations]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+ITERATIONS=${1:-2000}
+# Large bodies copy a megabyte each, the loop is shorter
+LARGE_ITERATIONS=$((ITERATIONS / 20))
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+seq 1 10 > "$TMP/small.txt"
+seq 1 150000 > "$TMP/large.txt"
+
+# Script running cat on a body of file $1, as a here-document when $2 is set
+script() {
+    local file=$1 heredoc=$2 iterations=$3
+    echo "i=0"
+    echo "while [ \$i -lt $iterations ]; do"
+    if [ -n "$heredoc" ]; then
+        echo "cat <<'EOF'"
+        cat "$file"
+        echo "EOF"
+    else
+        echo "cat < $file"
+    fi
+    echo "i=\$((i + 1))"
+    echo "done"
+}
+
+script "$TMP/small.txt" 1 "$ITERATIONS" > "$TMP/small_heredoc.sh"
+script "$TMP/small.txt" "" "$ITERATIONS" > "$TMP/small_file.sh"
+script "$TMP/large.txt" 1 "$LARGE_ITERATIONS" > "$TMP/large_heredoc.sh"
+script "$TMP/large.txt" "" "$LARGE_ITERATIONS" > "$TMP/large_file.sh"
+
+# Prints the time per iteration of a script, best of RUNS runs
+run() {
+    local label=$1 script=$2 iterations=$3
+    local TIMEFORMAT="%R"
+    local elapsed best=""
+    for i in $(seq "${RUNS:-3}"); do
+        elapsed=$( { time "$SHELL_BIN" -c "$script" < /dev/null > /dev/null 2>&1; } 2>&1 )
+        if [ -z "$best" ] || awk -v a="$elapsed" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+            best=$elapsed
+        fi
+    done
+    awk -v l="$label" -v n="$iterations" -v s="$best" \
+        'BEGIN { printf "%-28s %6d runs %8.0f ms  %8.2f us/run\n", l, n, s * 1e3, s * 1e6 / n }'
+}
+
+run "small here-document (pipe)" "$TMP/small_heredoc.sh" "$ITERATIONS"
+run "small file" "$TMP/small_file.sh" "$ITERATIONS"
+run "large here-document (memfd)" "$TMP/large_heredoc.sh" "$LARGE_ITERATIONS"
+run "large file" "$TMP/large_file.sh" "$LARGE_ITERATIONS"
@@ -0,0 +1,86 @@
+// History search latency : fills a history file with N entries and
+// measures the reverse search, newest match first, like Ctrl-R.
+//
+// Usage : bench/history_bench [entries]
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <unistd.h>
+
+// MODULES INCLUDES
+#include "history.h"
+
+#define SEARCHES 1000
+
+static const char *words[] = {
+    "git", "make", "grep", "ssh", "docker", "kubectl", "cat", "ls", "cd", "vim",
+    "status", "commit", "build", "deploy", "logs", "--all", "-rn", "src", "/var/log", "prod"
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} // double now_ms()
+
+int main(int argc, char **argv)
+{
+    long entries = argc > 1 ? atol(argv[1]) : 1000000;
+    char path[] = "/tmp/history_bench.XXXXXX";
+    char line[256];
+    double start, worst = 0, total = 0;
+    long i, found = 0;
+
+    int fd = mkstemp(path);
+    if(fd == -1)
+        return EXIT_FAILURE;
+    close(fd);
+    unlink(path);
+
+    srand(42);
+    if(history_open(path) == -1 || history_set_max(entries) == -1)
+        return EXIT_FAILURE;
+
+    start = now_ms();
+    for(i = 0; i < entries; ++i)
+    {
+        snprintf(line, sizeof(line), "%s %s %s %ld", words[rand() % WORD_COUNT],
+                 words[rand() % WORD_COUNT], words[rand() % WORD_COUNT], i);
+        history_add(line);
+    }
+    printf("history : %ld entries added in %.0f ms\n", history_count(), now_ms() - start);
+
+    // First search builds the trigram index
+    start = now_ms();
+    history_search("build", -1);
+    printf("history : index built in %.0f ms\n", now_ms() - start);
+
+    for(i = 0; i < SEARCHES; ++i)
+    {
+        // Rare queries are the worst case, frequent ones hit at once
+        if(i % 2)
+            snprintf(line, sizeof(line), "%ld", rand() % entries);
+        else
+            snprintf(line, sizeof(line), "%s %s", words[rand() % WORD_COUNT], words[rand() % WORD_COUNT]);
+
+        start = now_ms();
+        found += history_search(line, -1) != -1;
+        double elapsed = now_ms() - start;
+        total += elapsed;
+        if(elapsed > worst)
+            worst = elapsed;
+    }
+    printf("history : %d searches, %ld found, %.3f ms average, %.3f ms worst\n",
+           SEARCHES, found, total / SEARCHES, worst);
+
+    history_close();
+    unlink(path);
+    return EXIT_SUCCESS;
+} // int main(int, char**)
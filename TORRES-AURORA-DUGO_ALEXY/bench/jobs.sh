@@ -0,0 +1,51 @@
+#!/bin/bash
+# Background job output : parallel jobs writing their lines in two
+# pieces, left on the terminal (off) or captured by the shell (line,
+# hold). Counts the lines mixed with another job and the peak memory
+# of the shell.
+#
+# Usage : bench/jobs.sh [jobs] [lines]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+JOBS=${1:-16}
+LINES=${2:-20000}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Two writes per line, another job can come in between
+cat > "$TMP/job.sh" <<EOF
+i=0
+while [ \$i -lt $LINES ]; do
+    printf "job\$1 "
+    echo "line \$i"
+    i=\$((i + 1))
+done
+EOF
+
+run() {
+    local mode=$1
+    {
+        echo "jobs -m $mode"
+        for i in $(seq "$JOBS"); do
+            echo "bash $TMP/job.sh $i &"
+        done
+        echo "wait"
+        echo "cat /proc/self/status"
+    } > "$TMP/$mode.sh"
+
+    local TIMEFORMAT="%R"
+    local elapsed
+    elapsed=$( { time "$SHELL_BIN" -c "$TMP/$mode.sh" < /dev/null > "$TMP/$mode.out" 2>&1; } 2>&1 )
+    awk -v m="$mode" -v s="$elapsed" -v n=$((JOBS * LINES)) '
+        /^VmHWM/ { rss = $2 }
+        /job[0-9]+ line [0-9]+$/ { sub(/^\[[0-9]+\] /, ""); if($0 ~ /^job[0-9]+ line [0-9]+$/) good++; next }
+        /job[0-9]/ { mixed++ }
+        END {
+            printf "jobs : %-5s %7d lines %6.0f ms  %6d mixed  %6d kB peak RSS\n",
+                   m, n, s * 1e3, n - good, rss
+        }' "$TMP/$mode.out"
+}
+
+run off
+run line
+run hold
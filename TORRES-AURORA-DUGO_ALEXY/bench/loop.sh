@@ -0,0 +1,61 @@
+#!/bin/bash
+# Control flow cost : a loop of builtins only ([, $((...)) and
+# assignments) run by the shell against bash and dash, and the same
+# commands unrolled as script lines, each one read and parsed.
+#
+# Usage : bench/loop.sh [iterations]
+
+SHELL_BIN=${SHELL_BIN:-./main}
+ITERATIONS=${1:-100000}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+cat > "$TMP/while.sh" <<EOF
+i=0
+while [ \$i -lt $ITERATIONS ]; do
+    i=\$((i + 1))
+done
+EOF
+
+cat > "$TMP/if.sh" <<EOF
+i=0
+even=0
+while [ \$i -lt $ITERATIONS ]; do
+    if [ \$((i % 2)) -eq 0 ]; then
+        even=\$((even + 1))
+    fi
+    i=\$((i + 1))
+done
+EOF
+
+# One line per iteration, nothing is parsed only once
+i=0
+while [ $i -lt "$ITERATIONS" ]; do
+    echo "[ \$i -lt $ITERATIONS ]"
+    echo 'i=$((i + 1))'
+    i=$((i + 1))
+done > "$TMP/unrolled.sh"
+
+# Prints the time per iteration of a script, best of RUNS runs
+run() {
+    local label=$1 shell=$2 script=$3
+    local TIMEFORMAT="%R"
+    local elapsed best=""
+    [ -x "$(command -v "$shell")" ] || return
+    for i in $(seq "${RUNS:-3}"); do
+        elapsed=$( { time "$shell" $4 "$script" < /dev/null > /dev/null 2>&1; } 2>&1 )
+        if [ -z "$best" ] || awk -v a="$elapsed" -v b="$best" 'BEGIN { exit !(a < b) }'; then
+            best=$elapsed
+        fi
+    done
+    awk -v l="$label" -v n="$ITERATIONS" -v s="$best" \
+        'BEGIN { printf "%-28s %8.0f ms  %6.2f us/iteration\n", l, s * 1e3, s * 1e6 / n }'
+}
+
+run "while loop (shell)" "$SHELL_BIN" "$TMP/while.sh" -c
+run "while loop (bash)" bash "$TMP/while.sh"
+run "while loop (dash)" dash "$TMP/while.sh"
+run "while + if (shell)" "$SHELL_BIN" "$TMP/if.sh" -c
+run "while + if (bash)" bash "$TMP/if.sh"
+run "while + if (dash)" dash "$TMP/if.sh"
+run "unrolled lines (shell)" "$SHELL_BIN" "$TMP/unrolled.sh" -c
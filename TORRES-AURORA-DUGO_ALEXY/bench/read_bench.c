@@ -0,0 +1,152 @@
+// Line reading throughput of read : a generated file of N megabytes
+// read line by line with each method of the input module, from the
+// file and from a pipe, against a byte per read like other shells.
+// Byte reads only get the first BYTE_LIMIT of the input, they would
+// take minutes on the whole of it.
+//
+// Usage : bench/read_bench [megabytes]
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+// MODULES INCLUDES
+#include "input.h"
+#include "copy.h"
+
+#define BYTE_LIMIT (16LL * 1024 * 1024)
+
+static const char *words[] = {
+    "alpha", "beta", "gamma", "delta", "epsilon", "zeta", "eta", "theta",
+    "iota", "kappa", "lambda", "mu", "nu", "xi", "omicron", "pi"
+};
+#define WORD_COUNT (sizeof(words) / sizeof(words[0]))
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} // double now_ms()
+
+// Lines of 3 to 10 words, about 45 bytes
+static int generate(const char *path, long long size)
+{
+    FILE *file = fopen(path, "w");
+    long long written = 0, line = 0;
+
+    if(file == NULL)
+        return -1;
+    srand(42);
+    while(written < size)
+    {
+        int count = 3 + rand() % 8, i;
+        written += fprintf(file, "%lld", line++);
+        for(i = 0; i < count; ++i)
+            written += fprintf(file, " %s", words[rand() % WORD_COUNT]);
+        written += fprintf(file, "\n");
+    }
+    return fclose(file);
+} // int generate(const char*, long long)
+
+// Input of the path, through a pipe written by a child when piped
+static int open_input(const char *path, int piped, pid_t *writer)
+{
+    int fd = open(path, O_RDONLY), fds[2];
+
+    *writer = -1;
+    if(fd == -1 || !piped)
+        return fd;
+    if(pipe(fds) == -1)
+        return -1;
+    *writer = fork();
+    if(*writer == 0)
+    {
+        close(fds[0]);
+        copy_fd(fd, fds[1], NULL);
+        _exit(EXIT_SUCCESS);
+    }
+    close(fd);
+    close(fds[1]);
+    return fds[0];
+} // int open_input(const char*, int, pid_t*)
+
+static void run(const char *label, const char *path, int piped, int method, long long limit)
+{
+    struct input_buffer line = {NULL, 0, 0};
+    long long lines = 0, bytes = 0;
+    pid_t writer;
+    int fd = open_input(path, piped, &writer);
+
+    if(fd == -1)
+    {
+        perror(label);
+        return;
+    }
+    double start = now_ms();
+    while(bytes < limit && input_line(fd, &line, method) == 1)
+    {
+        bytes += line.len + 1;
+        ++lines;
+    }
+    double elapsed = now_ms() - start;
+    close(fd);
+    if(writer > 0)
+    {
+        kill(writer, SIGTERM);
+        waitpid(writer, NULL, 0);
+    }
+    input_free(&line);
+    printf("read : %-28s %5lld MB %10lld lines %9.0f ms %12.0f lines/s\n", label, bytes >> 20,
+           lines, elapsed, lines * 1e3 / elapsed);
+} // run(const char*, const char*, int, int, long long)
+
+static int count_line(const char *line, size_t len, void *data)
+{
+    ++*(long long*)data;
+    return 0;
+} // int count_line(const char*, size_t, void*)
+
+int main(int argc, char **argv)
+{
+    long long size = (argc > 1 ? atoll(argv[1]) : 1024) * 1024 * 1024;
+    char path[] = "/tmp/read_bench.XXXXXX";
+    long long lines = 0;
+
+    int fd = mkstemp(path);
+    if(fd == -1)
+        return EXIT_FAILURE;
+    close(fd);
+    double start = now_ms();
+    if(generate(path, size) == -1)
+    {
+        unlink(path);
+        return EXIT_FAILURE;
+    }
+    printf("read : %lld MB generated in %.0f ms\n", size >> 20, now_ms() - start);
+
+    run("file, read/lseek", path, 0, INPUT_SEEK, size);
+    run("file, byte reads", path, 0, INPUT_BYTE, BYTE_LIMIT);
+    run("pipe, tee peek", path, 1, INPUT_TEE, size);
+    run("pipe, byte reads", path, 1, INPUT_BYTE, BYTE_LIMIT);
+
+    fd = open(path, O_RDONLY);
+    start = now_ms();
+    input_lines(fd, count_line, &lines);
+    double elapsed = now_ms() - start;
+    close(fd);
+    printf("read : %-28s %5lld MB %10lld lines %9.0f ms %12.0f lines/s\n", "file, whole stream (mapfile)",
+           size >> 20, lines, elapsed, lines * 1e3 / elapsed);
+
+    unlink(path);
+    return EXIT_SUCCESS;
+} // int main(int, char**)
@@ -0,0 +1,45 @@
+#!/bin/bash
+# Startup : time from launch to the end of a script whose only command
+# is a builtin, for the shell, its static build (make static) and
+# dash. Cold is the first launch once the page cache is dropped, or
+# of a fresh copy of the binary when it can't be; warm is the mean of
+# the next launches.
+#
+# Usage : bench/startup.sh [launches]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+STATIC_BIN=$(realpath "${STATIC_BIN:-./main-static}")
+LAUNCHES=${1:-500}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+echo "cd ." > "$TMP/script.sh"
+
+# dash reads its script as an operand, -c would run it as a command
+measure() {
+    local name=$1 bin=$2 flag=$3
+    local TIMEFORMAT="%R"
+    local cold warm
+
+    cp "$bin" "$TMP/$name"
+    sync
+    if ! echo 3 2> /dev/null > /proc/sys/vm/drop_caches; then
+        # The copy is still cached, at least it's a new inode
+        :
+    fi
+    cold=$( { time "$TMP/$name" $flag "$TMP/script.sh" < /dev/null > /dev/null 2>&1; } 2>&1 )
+    warm=$( { time for ((i = 0; i < LAUNCHES; ++i)); do
+                  "$TMP/$name" $flag "$TMP/script.sh" < /dev/null > /dev/null 2>&1
+              done; } 2>&1 )
+    awk -v n="$name" -v c="$cold" -v w="$warm" -v l="$LAUNCHES" 'BEGIN {
+        printf "startup : %-12s cold %8.2f ms  warm %8.3f ms\n", n, c * 1e3, w * 1e3 / l
+    }'
+}
+
+measure main "$SHELL_BIN" -c
+if [ -x "$STATIC_BIN" ]; then
+    measure main-static "$STATIC_BIN" -c
+fi
+if command -v dash > /dev/null; then
+    measure dash "$(command -v dash)"
+fi
@@ -0,0 +1,89 @@
+#!/bin/bash
+# Spawn storm : a script of short background commands, front commands
+# with known statuses and pipelines, while SIGINT and SIGQUIT are sent
+# to the shell. Checks that every front status is the expected one (a
+# SIGINT may drop the rest of a line, never give a wrong status),
+# that no child is left a zombie once the storm is over (before and
+# after wait) and that commands inherit no descriptor but 0, 1 and 2.
+# Reports the spawn and reap throughput.
+#
+# Usage : bench/stress.sh [rounds]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+ROUNDS=${1:-2000}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# Helpers, the shell has no quoting
+printf 'exit $1\n' > "$TMP/status.sh"
+# Descriptors of the command itself besides 0 1 2 and the one ls reads
+printf 'ls /proc/self/fd | wc -l\n' > "$TMP/fds.sh"
+cat > "$TMP/zombies.sh" <<'EOF'
+count=0
+for status in /proc/[0-9]*/status; do
+    if grep -q "^PPid:[[:space:]]*$PPID\$" "$status" 2> /dev/null \
+       && grep -q '^State:[[:space:]]*Z' "$status" 2> /dev/null; then
+        count=$((count + 1))
+    fi
+done
+echo "zombies $count"
+EOF
+
+# Every round : 4 background commands, 2 front ones and a 3 stage
+# pipeline, 9 processes
+{
+    echo "touch $TMP/start"
+    for ((i = 0; i < ROUNDS; ++i)); do
+        echo "/bin/true &"
+        echo "/bin/false &"
+        echo "/bin/true &"
+        echo "sh $TMP/status.sh $((i % 7)) &"
+        echo "sh $TMP/status.sh $((i % 5)) ; echo status $((i % 5)) \$?"
+        echo "/bin/true ; echo status 0 \$?"
+        echo "echo pipe | cat | /bin/true"
+        if ((i % 200 == 0)); then
+            echo "sh $TMP/fds.sh"
+        fi
+    done
+    echo "touch $TMP/stop"
+    # Lost SIGCHLD leave zombies until wait reaps them all
+    echo "sleep 0.5"
+    echo "sh $TMP/zombies.sh"
+    echo "wait"
+    echo "sh $TMP/zombies.sh"
+    echo "sh $TMP/fds.sh"
+} > "$TMP/storm.sh"
+
+start=$(date +%s%N)
+"$SHELL_BIN" -c "$TMP/storm.sh" < /dev/null > "$TMP/out" 2> "$TMP/err" &
+shell=$!
+
+# Signals once the shell runs its script until the script reaches its end
+while [ ! -e "$TMP/start" ] && kill -0 "$shell" 2> /dev/null; do
+    sleep 0.01
+done
+signals=0
+while [ ! -e "$TMP/stop" ] && kill -0 "$shell" 2> /dev/null; do
+    kill -INT "$shell" 2> /dev/null
+    kill -QUIT "$shell" 2> /dev/null
+    signals=$((signals + 2))
+    sleep 0.01
+done
+wait "$shell"
+shell_status=$?
+elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+
+awk -v rounds="$ROUNDS" -v ms="$elapsed" -v signals="$signals" -v status="$shell_status" '
+    $1 == "status" { statuses++; if($2 != $3) wrong++; next }
+    $1 == "zombies" { zombies = zombies == "" ? $2 : zombies + $2; next }
+    /^[0-9]+$/ { checks++; if($1 > 4) leaked++; next }
+    END {
+        processes = rounds * 9
+        printf "stress : %d rounds %d processes %d signals in %d ms, %.0f spawns/s\n",
+               rounds, processes, signals, ms, processes * 1000 / (ms > 0 ? ms : 1)
+        printf "stress : statuses %d/%d (dropped by SIGINT %d) wrong %d, zombies %s, fd checks %d leaked %d, shell status %d\n",
+               statuses, rounds * 2, rounds * 2 - statuses, wrong, zombies == "" ? "?" : zombies, checks, leaked, status
+        ok = wrong == 0 && zombies == "0" && checks > 0 && leaked == 0 && status == 0
+        print ok ? "stress : OK" : "stress : FAILED"
+        exit !ok
+    }' "$TMP/out"
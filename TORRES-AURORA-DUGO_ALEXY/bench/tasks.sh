@@ -0,0 +1,44 @@
+#!/bin/bash
+# Task graph : a diamond-shaped build of tasks waiting on I/O (sleep)
+# run one after the other by a plain script, then by tasks with more
+# and more slots. Reports the wall time and the critical path.
+#
+# Usage : bench/tasks.sh [width] [task ms]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+WIDTH=${1:-8}
+MS=${2:-100}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+SECONDS_TASK=$(awk -v m="$MS" 'BEGIN { printf "%.3f", m / 1000 }')
+
+# fetch, then WIDTH compiles each followed by a test, then a link
+{
+    echo "fetch : sleep $SECONDS_TASK"
+    for i in $(seq "$WIDTH"); do
+        echo "compile$i fetch : sleep $SECONDS_TASK"
+        echo "test$i compile$i : sleep $SECONDS_TASK"
+    done
+    echo "link $(seq -f 'compile%g' -s ' ' "$WIDTH") : sleep $SECONDS_TASK"
+} > "$TMP/graph"
+sed 's/^.* : //' "$TMP/graph" > "$TMP/plain.sh"
+
+measure() {
+    local name=$1 script=$2
+    local TIMEFORMAT="%R"
+    local elapsed
+    elapsed=$( { time "$SHELL_BIN" -c "$script" < /dev/null > "$TMP/out" 2>&1; } 2>&1 )
+    awk -v n="$name" -v s="$elapsed" '
+        /^critical/ { critical = $2 }
+        END {
+            printf "tasks : %-10s %8.0f ms wall  critical path %s\n",
+                   n, s * 1e3, critical == "" ? "-" : critical " ms"
+        }' "$TMP/out"
+}
+
+measure plain "$TMP/plain.sh"
+for jobs in 1 2 4 8 16; do
+    echo "tasks -j $jobs $TMP/graph" > "$TMP/tasks$jobs.sh"
+    measure "-j $jobs" "$TMP/tasks$jobs.sh"
+done
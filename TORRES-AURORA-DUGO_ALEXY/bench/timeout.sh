@@ -0,0 +1,40 @@
+#!/bin/bash
+# Deadlines : cost of ASR2_TIMEOUT on short commands (a pidfd, a
+# timerfd and a process group each), then how long after its deadline
+# a hung command is stopped, with SIGTERM, with a long grace time it
+# does not need and when it ignores SIGTERM.
+#
+# Usage : bench/timeout.sh [commands] [deadline ms]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+COMMANDS=${1:-2000}
+DEADLINE=${2:-200}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+run() {
+    local TIMEFORMAT="%R"
+    { time "$SHELL_BIN" -c "$1" < /dev/null > /dev/null 2>&1; } 2>&1
+}
+
+for limit in "" 10s; do
+    {
+        [ -n "$limit" ] && echo "ASR2_TIMEOUT=$limit"
+        for i in $(seq "$COMMANDS"); do
+            echo "/bin/true"
+        done
+    } > "$TMP/short.sh"
+    awk -v l="${limit:-none}" -v s="$(run "$TMP/short.sh")" -v n="$COMMANDS" 'BEGIN {
+        printf "timeout : deadline %-5s %6d commands %8.0f ms %8.1f us/command\n", l, n, s * 1e3, s * 1e6 / n
+    }'
+done
+
+printf 'trap "" TERM\nsleep 30\n' > "$TMP/stubborn.sh"
+echo "timeout ${DEADLINE}ms sleep 30" > "$TMP/hung.sh"
+echo "timeout -k 5s ${DEADLINE}ms sleep 30" > "$TMP/graced.sh"
+echo "timeout -k ${DEADLINE}ms ${DEADLINE}ms sh $TMP/stubborn.sh" > "$TMP/ignored.sh"
+for name in hung graced ignored; do
+    awk -v n="$name" -v s="$(run "$TMP/$name.sh")" -v d="$DEADLINE" 'BEGIN {
+        printf "timeout : %-8s deadline %5d ms stopped after %8.0f ms\n", n, d, s * 1e3
+    }'
+done
@@ -0,0 +1,122 @@
+// ** glob cost : walk_glob over a synthetic tree with 1 thread and
+// more, against find piped to sort giving the same sorted list.
+//
+// Usage : bench/walk_bench [directories] [files per directory]
+
+// Needed for mkdtemp
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+
+// MODULES INCLUDES
+#include "walk.h"
+
+static double now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+} // double now_ms()
+
+/*
+ * Directories 16 per level, each with files, half of them .c. Returns
+ * the number of .c files.
+ */
+static long build_tree(const char *root, long directories, long files)
+{
+    char path[PATH_MAX];
+    long d, f, matches = 0;
+
+    for(d = 0; d < directories; ++d)
+    {
+        // Directory d is a child of directory (d - 1) / 16
+        long parent = d, depth = 0;
+        char name[PATH_MAX] = "";
+        while(parent > 0 && depth < 32)
+        {
+            char part[PATH_MAX];
+            snprintf(part, sizeof(part), "/d%ld%s", parent, name);
+            strcpy(name, part);
+            parent = (parent - 1) / 16;
+            ++depth;
+        }
+        snprintf(path, sizeof(path), "%s%s", root, name);
+        mkdir(path, 0755);
+        for(f = 0; f < files; ++f)
+        {
+            char file[PATH_MAX + 32];
+            snprintf(file, sizeof(file), "%s/f%ld.%s", path, f, f % 2 ? "h" : "c");
+            int fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            if(fd != -1)
+                close(fd);
+            matches += f % 2 == 0;
+        }
+    }
+    return matches;
+} // long build_tree(const char*, long, long)
+
+static void run_walk(const char *root, int threads)
+{
+    char pattern[PATH_MAX];
+    struct walk_result result;
+    double start = now_ms();
+
+    snprintf(pattern, sizeof(pattern), "%s/**/*.c", root);
+    if(walk_glob(AT_FDCWD, pattern, NULL, threads, &result) == -1)
+    {
+        fprintf(stderr, "walk : walk_glob failed\n");
+        return;
+    }
+    double elapsed = now_ms() - start;
+    printf("walk : %-22s %2d threads %8zu matches %8.1f ms\n", "walk_glob", threads, result.count, elapsed);
+    walk_free(&result);
+} // run_walk(const char*, int)
+
+static void run_find(const char *root)
+{
+    char command[PATH_MAX * 2];
+    double start = now_ms();
+
+    snprintf(command, sizeof(command), "find %s -name '*.c' | LC_ALL=C sort > /dev/null", root);
+    if(system(command) != 0)
+        fprintf(stderr, "walk : find failed\n");
+    printf("walk : %-22s %2d thread  %8s         %8.1f ms\n", "find | sort", 1, "", now_ms() - start);
+} // run_find(const char*)
+
+int main(int argc, char **argv)
+{
+    long directories = argc > 1 ? atol(argv[1]) : 4000;
+    long files = argc > 2 ? atol(argv[2]) : 50;
+    char root[] = "/tmp/walk_benchXXXXXX";
+    char command[PATH_MAX];
+    int threads;
+
+    if(mkdtemp(root) == NULL)
+    {
+        perror("walk : mkdtemp");
+        return EXIT_FAILURE;
+    }
+    long matches = build_tree(root, directories, files);
+    printf("walk : %ld directories, %ld files, %ld .c\n", directories, directories * files, matches);
+
+    // Warm the dentry cache, every run reads the same tree
+    run_find(root);
+    run_find(root);
+    for(threads = 1; threads <= 8; threads *= 2)
+        run_walk(root, threads);
+
+    snprintf(command, sizeof(command), "rm -rf %s", root);
+    if(system(command) != 0)
+        fprintf(stderr, "walk : can't remove %s\n", root);
+    return EXIT_SUCCESS;
+} // int main(int, char**)
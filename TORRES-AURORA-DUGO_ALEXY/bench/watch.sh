@@ -0,0 +1,41 @@
+#!/bin/bash
+# watch cost : latency from a file change to the start of the run it
+# triggers, and CPU time used while waiting for changes.
+#
+# Usage : bench/watch.sh [changes]
+
+SHELL_BIN=$(realpath "${SHELL_BIN:-./main}")
+CHANGES=${1:-20}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+mkdir -p "$TMP/tree/a/b"
+echo "watch -n $((CHANGES + 1)) $TMP/tree -- /bin/date +%s%N" > "$TMP/watch.sh"
+
+"$SHELL_BIN" -c "$TMP/watch.sh" < /dev/null > "$TMP/runs.txt" &
+pid=$!
+sleep 0.5
+
+# CPU ticks of the shell, user and system
+ticks() {
+    awk '{ print $14 + $15 }' "/proc/$pid/stat"
+}
+
+idle_start=$(ticks)
+sleep 2
+idle_end=$(ticks)
+
+for i in $(seq "$CHANGES"); do
+    date +%s%N >> "$TMP/changes.txt"
+    echo "$i" >> "$TMP/tree/a/b/file"
+    sleep 0.2
+done
+wait "$pid"
+
+# The first run is the initial one, the others follow the changes
+tail -n +2 "$TMP/runs.txt" | paste "$TMP/changes.txt" - | awk -v idle=$((idle_end - idle_start)) '
+    { latency = ($2 - $1) / 1e6; total += latency; if(latency > worst) worst = latency }
+    END {
+        printf "watch : %d changes, rerun latency %.1f ms average, %.1f ms worst\n", NR, total / NR, worst
+        printf "watch : %d CPU ticks in 2 s idle\n", idle
+    }'
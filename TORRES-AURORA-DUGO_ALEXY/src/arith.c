@@ -0,0 +1,669 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// HEADER
+#include "arith.h"
+#include "vars.h"
+
+/*
+ * ############################################################
+ * #######   COMPILED FORM
+ * ############################################################
+ */
+
+// Stack machine instructions
+enum arith_op {
+    OP_CONST, OP_LOAD, OP_STORE, OP_POP, OP_DUP, OP_BOOL,
+    OP_JZ, OP_JNZ, OP_JMP,
+    OP_NEG, OP_NOT, OP_BNOT,
+    OP_MUL, OP_DIV, OP_MOD, OP_POW, OP_ADD, OP_SUB, OP_SHL, OP_SHR,
+    OP_LT, OP_LE, OP_GT, OP_GE, OP_EQ, OP_NE, OP_AND, OP_XOR, OP_OR
+}; // enum arith_op
+
+struct arith_instr {
+    enum arith_op op;
+    long long value;            /* constant or jump target */
+    char *name;                 /* variable of LOAD and STORE */
+}; // struct arith_instr
+
+struct arith_expr {
+    struct arith_instr *code;
+    int count;
+    int capacity;
+    char *text;                 /* source, key of the cache */
+    size_t len;
+    struct arith_expr *next;    /* cache bucket chain */
+}; // struct arith_expr
+
+// 64 bits two's complement, overflow wraps around like in bash
+#define WRAP(X) ((long long)(X))
+
+static char error_message[128];
+
+static void set_error(const char *message, const char *text, size_t len)
+{
+    if(text == NULL)
+        text = "";
+    snprintf(error_message, sizeof(error_message), "%s in '%.*s'", message, (int)len, text);
+} // set_error(const char*, const char*, size_t)
+
+const char* arith_error(void)
+{
+    return error_message;
+} // const char* arith_error()
+
+/*
+ * ############################################################
+ * #######   PARSER
+ * ############################################################
+ */
+
+enum token_type { T_END, T_NUM, T_NAME, T_PARAM, T_OP };
+
+// Longest operators first
+static const char *operators[] = {
+    "<<=", ">>=", "**", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "^=", "|=",
+    "<<", ">>", "<=", ">=", "==", "!=", "&&", "||",
+    "+", "-", "*", "/", "%", "<", ">", "&", "^", "|", "!", "~", "=", "?", ":", ",", "(", ")",
+    NULL
+};
+
+struct parser {
+    const char *text;
+    size_t len;
+    size_t pos;
+    enum token_type type;
+    const char *op;             /* operator of a T_OP token */
+    long long value;            /* T_NUM */
+    char name[ARITH_NAME_SIZE]; /* T_NAME, T_PARAM */
+    struct arith_expr *expr;
+    int failed;
+}; // struct parser
+
+static void fail(struct parser *p, const char *message)
+{
+    if(!p->failed)
+        set_error(message, p->text, p->len);
+    p->failed = 1;
+    p->type = T_END;
+} // fail(struct parser*, const char*)
+
+static void next_token(struct parser *p)
+{
+    int i;
+
+    while(p->pos < p->len && isspace((unsigned char)p->text[p->pos]))
+        ++p->pos;
+    if(p->pos >= p->len || p->failed)
+    {
+        p->type = T_END;
+        return;
+    }
+
+    const char *start = p->text + p->pos;
+    if(isdigit((unsigned char)*start))
+    {
+        char *end;
+        char number[32];
+        size_t n = 0;
+        while(p->pos + n < p->len && isalnum((unsigned char)start[n]) && n + 1 < sizeof(number))
+        {
+            number[n] = start[n];
+            ++n;
+        }
+        number[n] = '\0';
+        p->value = strtoll(number, &end, 0);
+        if(*end != '\0')
+        {
+            fail(p, "Invalid number");
+            return;
+        }
+        p->pos += n;
+        p->type = T_NUM;
+        return;
+    }
+
+    // $name is the same as name, the text stays cacheable
+    if(*start == '$')
+    {
+        ++start;
+        ++p->pos;
+
+        // $1, $# and $? are read when run, they cannot be assigned
+        if(p->pos < p->len && (isdigit((unsigned char)*start) || *start == '#' || *start == '?'))
+        {
+            p->name[0] = *start;
+            p->name[1] = '\0';
+            ++p->pos;
+            p->type = T_PARAM;
+            return;
+        }
+    }
+    if(isalpha((unsigned char)*start) || *start == '_')
+    {
+        size_t n = 0;
+        while(p->pos + n < p->len && (isalnum((unsigned char)start[n]) || start[n] == '_'))
+            ++n;
+        if(n >= ARITH_NAME_SIZE)
+        {
+            fail(p, "Variable name too long");
+            return;
+        }
+        memcpy(p->name, start, n);
+        p->name[n] = '\0';
+        p->pos += n;
+        p->type = T_NAME;
+        return;
+    }
+
+    for(i = 0; operators[i] != NULL; ++i)
+    {
+        size_t n = strlen(operators[i]);
+        if(p->pos + n <= p->len && strncmp(start, operators[i], n) == 0)
+        {
+            p->op = operators[i];
+            p->pos += n;
+            p->type = T_OP;
+            return;
+        }
+    }
+    fail(p, "Unexpected character");
+} // next_token(struct parser*)
+
+static int is_op(struct parser *p, const char *op)
+{
+    return p->type == T_OP && strcmp(p->op, op) == 0;
+} // int is_op(struct parser*, const char*)
+
+static int emit(struct parser *p, enum arith_op op, long long value, const char *name)
+{
+    struct arith_expr *expr = p->expr;
+
+    if(expr->count == expr->capacity)
+    {
+        int capacity = expr->capacity ? expr->capacity * 2 : 16;
+        struct arith_instr *code = realloc(expr->code, sizeof(struct arith_instr) * capacity);
+        if(code == NULL)
+        {
+            fail(p, "Out of memory");
+            return -1;
+        }
+        expr->code = code;
+        expr->capacity = capacity;
+    }
+    expr->code[expr->count].op = op;
+    expr->code[expr->count].value = value;
+    expr->code[expr->count].name = name ? strdup(name) : NULL;
+    return expr->count++;
+} // int emit(struct parser*, enum arith_op, long long, const char*)
+
+static void patch(struct parser *p, int at)
+{
+    if(at >= 0)
+        p->expr->code[at].value = p->expr->count;
+} // patch(struct parser*, int)
+
+static void parse_comma(struct parser *p);
+static void parse_assign(struct parser *p);
+static void parse_unary(struct parser *p);
+
+// Binary operators by precedence, lowest first
+struct binary_level {
+    const char *ops[5];
+    enum arith_op codes[5];
+}; // struct binary_level
+
+static const struct binary_level levels[] = {
+    {{"|"}, {OP_OR}},
+    {{"^"}, {OP_XOR}},
+    {{"&"}, {OP_AND}},
+    {{"==", "!="}, {OP_EQ, OP_NE}},
+    {{"<", "<=", ">", ">="}, {OP_LT, OP_LE, OP_GT, OP_GE}},
+    {{"<<", ">>"}, {OP_SHL, OP_SHR}},
+    {{"+", "-"}, {OP_ADD, OP_SUB}},
+    {{"*", "/", "%"}, {OP_MUL, OP_DIV, OP_MOD}},
+};
+#define LEVEL_COUNT ((int)(sizeof(levels) / sizeof(levels[0])))
+
+// ** is right associative and binds tighter than * but not than unary -
+static void parse_power(struct parser *p)
+{
+    parse_unary(p);
+    if(is_op(p, "**"))
+    {
+        next_token(p);
+        parse_power(p);
+        emit(p, OP_POW, 0, NULL);
+    }
+} // parse_power(struct parser*)
+
+static void parse_binary(struct parser *p, int level)
+{
+    int i;
+
+    if(level == LEVEL_COUNT)
+    {
+        parse_power(p);
+        return;
+    }
+
+    parse_binary(p, level + 1);
+    for(;;)
+    {
+        for(i = 0; i < 5 && levels[level].ops[i] != NULL; ++i)
+        {
+            if(is_op(p, levels[level].ops[i]))
+                break;
+        }
+        if(i == 5 || levels[level].ops[i] == NULL)
+            return;
+        next_token(p);
+        parse_binary(p, level + 1);
+        emit(p, levels[level].codes[i], 0, NULL);
+    }
+} // parse_binary(struct parser*, int)
+
+static void parse_primary(struct parser *p)
+{
+    if(p->type == T_NUM)
+    {
+        emit(p, OP_CONST, p->value, NULL);
+        next_token(p);
+    }
+    else if(p->type == T_PARAM)
+    {
+        emit(p, OP_LOAD, 0, p->name);
+        next_token(p);
+    }
+    else if(p->type == T_NAME)
+    {
+        char name[ARITH_NAME_SIZE];
+        strcpy(name, p->name);
+        next_token(p);
+        emit(p, OP_LOAD, 0, name);
+
+        // Post increment, the old value stays on the stack
+        if(is_op(p, "++") || is_op(p, "--"))
+        {
+            emit(p, OP_DUP, 0, NULL);
+            emit(p, OP_CONST, 1, NULL);
+            emit(p, is_op(p, "++") ? OP_ADD : OP_SUB, 0, NULL);
+            emit(p, OP_STORE, 0, name);
+            emit(p, OP_POP, 0, NULL);
+            next_token(p);
+        }
+    }
+    else if(is_op(p, "("))
+    {
+        next_token(p);
+        parse_comma(p);
+        if(!is_op(p, ")"))
+        {
+            fail(p, "Missing )");
+            return;
+        }
+        next_token(p);
+    }
+    else
+        fail(p, "Syntax error");
+} // parse_primary(struct parser*)
+
+static void parse_unary(struct parser *p)
+{
+    if(is_op(p, "++") || is_op(p, "--"))
+    {
+        enum arith_op op = is_op(p, "++") ? OP_ADD : OP_SUB;
+        next_token(p);
+        if(p->type != T_NAME)
+        {
+            fail(p, "Increment needs a variable");
+            return;
+        }
+        emit(p, OP_LOAD, 0, p->name);
+        emit(p, OP_CONST, 1, NULL);
+        emit(p, op, 0, NULL);
+        emit(p, OP_STORE, 0, p->name);
+        next_token(p);
+        return;
+    }
+
+    if(is_op(p, "-") || is_op(p, "+") || is_op(p, "!") || is_op(p, "~"))
+    {
+        const char *op = p->op;
+        next_token(p);
+        parse_unary(p);
+        if(op[0] == '-')
+            emit(p, OP_NEG, 0, NULL);
+        else if(op[0] == '!')
+            emit(p, OP_NOT, 0, NULL);
+        else if(op[0] == '~')
+            emit(p, OP_BNOT, 0, NULL);
+        return;
+    }
+
+    parse_primary(p);
+} // parse_unary(struct parser*)
+
+// a && b, a || b and a ? b : c jump over the part not evaluated
+static void parse_and(struct parser *p)
+{
+    parse_binary(p, 0);
+    while(is_op(p, "&&"))
+    {
+        next_token(p);
+        int jump_false = emit(p, OP_JZ, 0, NULL);
+        parse_binary(p, 0);
+        emit(p, OP_BOOL, 0, NULL);
+        int jump_end = emit(p, OP_JMP, 0, NULL);
+        patch(p, jump_false);
+        emit(p, OP_CONST, 0, NULL);
+        patch(p, jump_end);
+    }
+} // parse_and(struct parser*)
+
+static void parse_or(struct parser *p)
+{
+    parse_and(p);
+    while(is_op(p, "||"))
+    {
+        next_token(p);
+        int jump_true = emit(p, OP_JNZ, 0, NULL);
+        parse_and(p);
+        emit(p, OP_BOOL, 0, NULL);
+        int jump_end = emit(p, OP_JMP, 0, NULL);
+        patch(p, jump_true);
+        emit(p, OP_CONST, 1, NULL);
+        patch(p, jump_end);
+    }
+} // parse_or(struct parser*)
+
+static void parse_ternary(struct parser *p)
+{
+    parse_or(p);
+    if(!is_op(p, "?"))
+        return;
+
+    next_token(p);
+    int jump_else = emit(p, OP_JZ, 0, NULL);
+    parse_comma(p);
+    if(!is_op(p, ":"))
+    {
+        fail(p, "Missing :");
+        return;
+    }
+    next_token(p);
+    int jump_end = emit(p, OP_JMP, 0, NULL);
+    patch(p, jump_else);
+    parse_assign(p);
+    patch(p, jump_end);
+} // parse_ternary(struct parser*)
+
+static void parse_assign(struct parser *p)
+{
+    static const char *assign_ops[] = {"=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "^=", "|=", NULL};
+    static const enum arith_op assign_codes[] = {OP_CONST, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_MOD,
+                                                 OP_SHL, OP_SHR, OP_AND, OP_XOR, OP_OR};
+    char name[ARITH_NAME_SIZE];
+    int i;
+
+    if(p->type == T_NAME)
+    {
+        // Look after the name for an assignment operator
+        size_t saved_pos = p->pos;
+        strcpy(name, p->name);
+        next_token(p);
+        for(i = 0; p->type == T_OP && assign_ops[i] != NULL; ++i)
+        {
+            if(strcmp(p->op, assign_ops[i]) == 0)
+                break;
+        }
+        if(p->type == T_OP && assign_ops[i] != NULL)
+        {
+            next_token(p);
+            if(i > 0)
+                emit(p, OP_LOAD, 0, name);
+            parse_assign(p);
+            if(i > 0)
+                emit(p, assign_codes[i], 0, NULL);
+            emit(p, OP_STORE, 0, name);
+            return;
+        }
+
+        // Not an assignment, back to the name
+        p->pos = saved_pos;
+        p->type = T_NAME;
+        strcpy(p->name, name);
+    }
+    parse_ternary(p);
+} // parse_assign(struct parser*)
+
+static void parse_comma(struct parser *p)
+{
+    parse_assign(p);
+    while(is_op(p, ","))
+    {
+        next_token(p);
+        emit(p, OP_POP, 0, NULL);
+        parse_assign(p);
+    }
+} // parse_comma(struct parser*)
+
+/*
+ * ############################################################
+ * #######   ARITHMETIC
+ * ############################################################
+ */
+
+void arith_free(struct arith_expr *expr)
+{
+    int i;
+
+    if(expr == NULL)
+        return;
+    for(i = 0; i < expr->count; ++i)
+        free(expr->code[i].name);
+    free(expr->code);
+    free(expr->text);
+    free(expr);
+} // arith_free(struct arith_expr*)
+
+// Compile text to the stack machine code, NULL on syntax error
+struct arith_expr* arith_compile(const char *text, size_t len)
+{
+    struct parser p;
+
+    memset(&p, 0, sizeof(p));
+    p.text = text;
+    p.len = len;
+    p.expr = calloc(1, sizeof(struct arith_expr));
+    if(p.expr == NULL)
+        return NULL;
+
+    next_token(&p);
+    // An empty expression is 0
+    if(p.type == T_END && !p.failed)
+        emit(&p, OP_CONST, 0, NULL);
+    else
+        parse_comma(&p);
+    if(p.type != T_END)
+        fail(&p, "Syntax error");
+
+    if(p.failed)
+    {
+        arith_free(p.expr);
+        return NULL;
+    }
+    return p.expr;
+} // struct arith_expr* arith_compile(const char*, size_t)
+
+static long long power(long long base, long long exponent)
+{
+    unsigned long long result = 1, factor = base;
+
+    while(exponent > 0)
+    {
+        if(exponent & 1)
+            result *= factor;
+        factor *= factor;
+        exponent >>= 1;
+    }
+    return WRAP(result);
+} // long long power(long long, long long)
+
+int arith_run(const struct arith_expr *expr, long long *result)
+{
+    long long stack[ARITH_STACK_SIZE];
+    int top = 0, pc = 0;
+
+    while(pc < expr->count)
+    {
+        const struct arith_instr *instr = &expr->code[pc++];
+
+        if(top >= ARITH_STACK_SIZE - 1)
+        {
+            set_error("Expression too complex", expr->text, expr->len);
+            return -1;
+        }
+
+        // Binary operators use the two values on top
+        long long right = top > 0 ? stack[top - 1] : 0;
+        long long left = top > 1 ? stack[top - 2] : 0;
+
+        switch(instr->op)
+        {
+            case OP_CONST: stack[top++] = instr->value; break;
+            case OP_LOAD: stack[top++] = vars_get_int(instr->name); break;
+            case OP_STORE:
+                if(vars_set_int(instr->name, right) == -1)
+                {
+                    set_error("Can't assign", expr->text, expr->len);
+                    return -1;
+                }
+                break;
+            case OP_POP: --top; break;
+            case OP_DUP: stack[top] = right; ++top; break;
+            case OP_BOOL: stack[top - 1] = right != 0; break;
+            case OP_JZ: --top; if(right == 0) pc = instr->value; break;
+            case OP_JNZ: --top; if(right != 0) pc = instr->value; break;
+            case OP_JMP: pc = instr->value; break;
+            case OP_NEG: stack[top - 1] = WRAP(0ULL - right); break;
+            case OP_NOT: stack[top - 1] = !right; break;
+            case OP_BNOT: stack[top - 1] = ~right; break;
+            case OP_DIV:
+            case OP_MOD:
+                if(right == 0)
+                {
+                    set_error("Division by zero", expr->text, expr->len);
+                    return -1;
+                }
+                // LLONG_MIN / -1 overflows, wraps like the other operators
+                if(right == -1)
+                    stack[top - 2] = instr->op == OP_DIV ? WRAP(0ULL - left) : 0;
+                else
+                    stack[top - 2] = instr->op == OP_DIV ? left / right : left % right;
+                --top;
+                break;
+            case OP_POW:
+                if(right < 0)
+                {
+                    set_error("Negative exponent", expr->text, expr->len);
+                    return -1;
+                }
+                stack[top - 2] = power(left, right);
+                --top;
+                break;
+            case OP_MUL: stack[top - 2] = WRAP((unsigned long long)left * right); --top; break;
+            case OP_ADD: stack[top - 2] = WRAP((unsigned long long)left + right); --top; break;
+            case OP_SUB: stack[top - 2] = WRAP((unsigned long long)left - right); --top; break;
+            case OP_SHL: stack[top - 2] = WRAP((unsigned long long)left << (right & 63)); --top; break;
+            case OP_SHR: stack[top - 2] = left >> (right & 63); --top; break;
+            case OP_LT: stack[top - 2] = left < right; --top; break;
+            case OP_LE: stack[top - 2] = left <= right; --top; break;
+            case OP_GT: stack[top - 2] = left > right; --top; break;
+            case OP_GE: stack[top - 2] = left >= right; --top; break;
+            case OP_EQ: stack[top - 2] = left == right; --top; break;
+            case OP_NE: stack[top - 2] = left != right; --top; break;
+            case OP_AND: stack[top - 2] = left & right; --top; break;
+            case OP_XOR: stack[top - 2] = left ^ right; --top; break;
+            case OP_OR: stack[top - 2] = left | right; --top; break;
+        }
+    }
+
+    *result = top > 0 ? stack[top - 1] : 0;
+    return 0;
+} // int arith_run(const struct arith_expr*, long long*)
+
+/*
+ * ############################################################
+ * #######   CACHE
+ * ############################################################
+ */
+
+static struct arith_expr *cache[ARITH_CACHE_BUCKETS];
+static int cache_count = 0;
+
+static unsigned int hash_text(const char *text, size_t len)
+{
+    unsigned int hash = 2166136261u;
+    size_t i;
+
+    for(i = 0; i < len; ++i)
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    return hash & (ARITH_CACHE_BUCKETS - 1);
+} // unsigned int hash_text(const char*, size_t)
+
+static void flush_cache(void)
+{
+    int i;
+
+    for(i = 0; i < ARITH_CACHE_BUCKETS; ++i)
+    {
+        while(cache[i] != NULL)
+        {
+            struct arith_expr *next = cache[i]->next;
+            arith_free(cache[i]);
+            cache[i] = next;
+        }
+    }
+    cache_count = 0;
+} // flush_cache()
+
+/*
+ * Evaluate text, compiled once : the same expression text (a loop body
+ * run again, a script line) is found in the cache and never parsed again.
+ */
+int arith_eval(const char *text, size_t len, long long *result)
+{
+    unsigned int bucket = hash_text(text, len);
+    struct arith_expr *expr;
+
+    for(expr = cache[bucket]; expr != NULL; expr = expr->next)
+    {
+        if(expr->len == len && memcmp(expr->text, text, len) == 0)
+            return arith_run(expr, result);
+    }
+
+    expr = arith_compile(text, len);
+    if(expr == NULL)
+        return -1;
+    expr->text = malloc(len + 1);
+    if(expr->text == NULL)
+    {
+        arith_free(expr);
+        return -1;
+    }
+    memcpy(expr->text, text, len);
+    expr->text[len] = '\0';
+    expr->len = len;
+
+    if(cache_count >= ARITH_CACHE_MAX)
+        flush_cache();
+    expr->next = cache[bucket];
+    cache[bucket] = expr;
+    ++cache_count;
+
+    return arith_run(expr, result);
+} // int arith_eval(const char*, size_t, long long*)
@@ -0,0 +1,33 @@
+#ifndef DEF_ARITH_H
+#define DEF_ARITH_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+// Buckets of the compiled expression cache
+#define ARITH_CACHE_BUCKETS 1024
+
+// Max compiled expressions kept, the cache is flushed when full
+#define ARITH_CACHE_MAX 4096
+
+// Evaluation stack depth
+#define ARITH_STACK_SIZE 64
+
+// Max length of a variable name in an expression
+#define ARITH_NAME_SIZE 64
+
+/*
+ * ############################################################
+ * #######   ARITHMETIC
+ * ############################################################
+ */
+
+struct arith_expr;
+
+struct arith_expr* arith_compile(const char *text, size_t len);
+void arith_free(struct arith_expr *expr);
+int arith_run(const struct arith_expr *expr, long long *result);
+int arith_eval(const char *text, size_t len, long long *result);
+const char* arith_error(void);
+
+#endif // DEF_ARITH_H
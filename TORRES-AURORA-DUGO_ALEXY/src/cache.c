@@ -0,0 +1,380 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <errno.h>
+
+// HEADER
+#include "cache.h"
+#include "copy.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+// Directory, / and the name of an entry
+#define ENTRY_PATH_SIZE (PATH_MAX + CACHE_NAME_SIZE + 1)
+
+static char dir[PATH_MAX];
+static long long limit = CACHE_SIZE_DEFAULT;
+
+// Entry seen by the eviction
+struct cache_entry {
+    char name[CACHE_NAME_SIZE];
+    long long size;
+    struct timespec used;       /* mtime, touched on each hit */
+}; // struct cache_entry
+
+// FNV-1a 64 twice, from two offset bases
+#define FNV_PRIME 1099511628211ULL
+static const uint64_t bases[2] = {14695981039346656037ULL, 0x6c62272e07bb0142ULL};
+
+static void mix(struct cache_key *key, const void *data, size_t len)
+{
+    const unsigned char *bytes = data;
+    uint64_t h0 = key->hash[0], h1 = key->hash[1];
+    size_t i;
+
+    for(i = 0; i < len; ++i)
+    {
+        h0 = (h0 ^ bytes[i]) * FNV_PRIME;
+        h1 = (h1 ^ bytes[i]) * FNV_PRIME;
+    }
+    key->hash[0] = h0;
+    key->hash[1] = h1;
+} // mix(struct cache_key*, const void*, size_t)
+
+static int is_entry_name(const char *name)
+{
+    return strlen(name) == CACHE_NAME_SIZE - 1 && strspn(name, "0123456789abcdef") == CACHE_NAME_SIZE - 1;
+} // int is_entry_name(const char*)
+
+static void entry_path(const char *name, char *path)
+{
+    snprintf(path, ENTRY_PATH_SIZE, "%s/%s", dir, name);
+} // entry_path(const char*, char*)
+
+static int make_dirs(void)
+{
+    char path[PATH_MAX];
+    char *slash;
+
+    snprintf(path, sizeof(path), "%s", dir);
+    for(slash = strchr(path + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/'))
+    {
+        *slash = '\0';
+        if(mkdir(path, 0755) == -1 && errno != EEXIST)
+            return -1;
+        *slash = '/';
+    }
+    if(mkdir(path, 0755) == -1 && errno != EEXIST)
+        return -1;
+    return 0;
+} // int make_dirs()
+
+/*
+ * Reads the first line of an entry and checks the entry has the size
+ * it tells. Returns the length of the line or -1.
+ */
+static int read_header(int fd, int *status, long long *out_len, long long *err_len)
+{
+    char header[CACHE_HEADER_MAX + 1], magic[CACHE_HEADER_MAX];
+    struct stat st;
+    ssize_t len = pread(fd, header, CACHE_HEADER_MAX, 0);
+    char *end;
+
+    if(len <= 0 || fstat(fd, &st) == -1)
+        return -1;
+    header[len] = '\0';
+    end = strchr(header, '\n');
+    if(end == NULL)
+        return -1;
+    *end = '\0';
+    if(sscanf(header, "%127s %d %lld %lld", magic, status, out_len, err_len) != 4
+       || strcmp(magic, CACHE_MAGIC) != 0 || *out_len < 0 || *err_len < 0)
+        return -1;
+
+    // A partial entry is never renamed in, this is another file
+    if(st.st_size != (end - header) + 1 + *out_len + *err_len)
+        return -1;
+    return (int)(end - header) + 1;
+} // int read_header(int, int*, long long*, long long*)
+
+static int compare_used(const void *a, const void *b)
+{
+    const struct cache_entry *first = a, *second = b;
+
+    if(first->used.tv_sec != second->used.tv_sec)
+        return first->used.tv_sec < second->used.tv_sec ? -1 : 1;
+    if(first->used.tv_nsec != second->used.tv_nsec)
+        return first->used.tv_nsec < second->used.tv_nsec ? -1 : 1;
+    return strcmp(first->name, second->name);
+} // int compare_used(const void*, const void*)
+
+// Entries of the cache and their total size, NULL if there are none
+static struct cache_entry* list_entries(size_t *count, long long *total)
+{
+    struct cache_entry *entries = NULL;
+    size_t capacity = 0;
+    struct dirent *dirent;
+    DIR *cache_dir = opendir(dir);
+
+    *count = 0;
+    *total = 0;
+    if(cache_dir == NULL)
+        return NULL;
+    while((dirent = readdir(cache_dir)) != NULL)
+    {
+        struct stat st;
+        if(!is_entry_name(dirent->d_name) || fstatat(dirfd(cache_dir), dirent->d_name, &st, 0) == -1)
+            continue;
+        if(*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            struct cache_entry *grown = realloc(entries, capacity * sizeof(struct cache_entry));
+            if(grown == NULL)
+                break;
+            entries = grown;
+        }
+        strcpy(entries[*count].name, dirent->d_name);
+        entries[*count].size = st.st_size;
+        entries[*count].used = st.st_mtim;
+        *total += st.st_size;
+        ++*count;
+    }
+    closedir(cache_dir);
+    return entries;
+} // struct cache_entry* list_entries(size_t*, long long*)
+
+// Least recently used entries out until the cache fits its limit
+static void evict(void)
+{
+    size_t count, i;
+    long long total;
+    struct cache_entry *entries = list_entries(&count, &total);
+
+    if(total > limit)
+    {
+        qsort(entries, count, sizeof(struct cache_entry), compare_used);
+        for(i = 0; i < count && total > limit; ++i)
+        {
+            char path[ENTRY_PATH_SIZE];
+            entry_path(entries[i].name, path);
+            if(unlink(path) == 0 || errno == ENOENT)
+                total -= entries[i].size;
+        }
+    }
+    free(entries);
+} // evict()
+
+/*
+ * ############################################################
+ * #######   RESULT CACHE
+ * ############################################################
+ */
+
+// dir and size may be NULL and 0 for the defaults
+void cache_configure(const char *path, long long size)
+{
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+
+    if(path != NULL && path[0] != '\0')
+        snprintf(dir, sizeof(dir), "%s", path);
+    else if(xdg != NULL && xdg[0] == '/')
+        snprintf(dir, sizeof(dir), "%s/%s", xdg, CACHE_DIR_NAME);
+    else if(home != NULL && home[0] == '/')
+        snprintf(dir, sizeof(dir), "%s/.cache/%s", home, CACHE_DIR_NAME);
+    else
+        snprintf(dir, sizeof(dir), "/tmp/%s-%ld", CACHE_DIR_NAME, (long)getuid());
+    limit = size > 0 ? size : CACHE_SIZE_DEFAULT;
+} // cache_configure(const char*, long long)
+
+void cache_key_init(struct cache_key *key)
+{
+    key->hash[0] = bases[0];
+    key->hash[1] = bases[1];
+    key->name[0] = '\0';
+} // cache_key_init(struct cache_key*)
+
+// Each piece goes in with its length, a b and ab are different keys
+void cache_key_add(struct cache_key *key, const char *data, size_t len)
+{
+    uint64_t size = len;
+
+    mix(key, &size, sizeof(size));
+    mix(key, data, len);
+} // cache_key_add(struct cache_key*, const char*, size_t)
+
+/*
+ * An input file : its contents, or with metadata its size, mtime and
+ * inode, which is cheaper but trusts the mtime.
+ */
+void cache_key_file(struct cache_key *key, const char *path, int metadata)
+{
+    struct stat st;
+    char buffer[64 * 1024];
+    ssize_t len;
+    int fd;
+
+    cache_key_add(key, path, strlen(path));
+    if(metadata)
+    {
+        if(stat(path, &st) == -1)
+        {
+            cache_key_add(key, "", 0);
+            return;
+        }
+        long long fields[5] = {st.st_size, st.st_mtim.tv_sec, st.st_mtim.tv_nsec, st.st_ino, st.st_dev};
+        mix(key, fields, sizeof(fields));
+        return;
+    }
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+    {
+        cache_key_add(key, "", 0);
+        return;
+    }
+    while((len = read(fd, buffer, sizeof(buffer))) > 0 || (len == -1 && errno == EINTR))
+    {
+        if(len > 0)
+            mix(key, buffer, len);
+    }
+    close(fd);
+    // After the contents, a file can't be taken for the next path
+    cache_key_add(key, "\1", 1);
+} // cache_key_file(struct cache_key*, const char*, int)
+
+void cache_key_end(struct cache_key *key)
+{
+    snprintf(key->name, CACHE_NAME_SIZE, "%016llx%016llx",
+             (unsigned long long)key->hash[0], (unsigned long long)key->hash[1]);
+} // cache_key_end(struct cache_key*)
+
+// Entry of key marked as used, -1 on a miss
+int cache_open(const struct cache_key *key)
+{
+    char path[ENTRY_PATH_SIZE];
+    int status, fd;
+    long long out_len, err_len;
+
+    if(dir[0] == '\0')
+        cache_configure(NULL, 0);
+    entry_path(key->name, path);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1)
+        return -1;
+    if(read_header(fd, &status, &out_len, &err_len) == -1)
+    {
+        close(fd);
+        return -1;
+    }
+    // The mtime is the last use for the eviction
+    futimens(fd, NULL);
+    return fd;
+} // int cache_open(const struct cache_key*)
+
+// Writes the stored outputs of an entry and returns its status
+int cache_replay(int fd, int out, int err)
+{
+    int status;
+    long long out_len, err_len;
+    int header = read_header(fd, &status, &out_len, &err_len);
+
+    if(header == -1 || lseek(fd, header, SEEK_SET) == -1)
+        return -1;
+    if(out_len > 0 && copy_fd_len(fd, out, out_len, NULL) != out_len)
+        return -1;
+    if(err_len > 0)
+    {
+        // Nothing is lost when stdout has failed, the offset is set again
+        lseek(fd, header + out_len, SEEK_SET);
+        copy_fd_len(fd, err, err_len, NULL);
+    }
+    return status;
+} // int cache_replay(int, int, int)
+
+/*
+ * New entry for key from the captured outputs out and err. It is
+ * written aside then renamed, readers see all of it or nothing.
+ */
+int cache_store(const struct cache_key *key, int status, int out, int err)
+{
+    char path[ENTRY_PATH_SIZE], temporary[ENTRY_PATH_SIZE + 32], header[CACHE_HEADER_MAX];
+    off_t out_len = lseek(out, 0, SEEK_END), err_len = lseek(err, 0, SEEK_END);
+    int fd, len, failed;
+
+    if(dir[0] == '\0')
+        cache_configure(NULL, 0);
+    if(out_len == -1 || err_len == -1 || make_dirs() == -1)
+        return -1;
+    entry_path(key->name, path);
+    snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", path, (long)getpid());
+    fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(fd == -1)
+        return -1;
+
+    len = snprintf(header, sizeof(header), "%s %d %lld %lld\n", CACHE_MAGIC, status,
+                   (long long)out_len, (long long)err_len);
+    failed = write(fd, header, len) != len;
+    if(!failed && out_len > 0)
+        failed = lseek(out, 0, SEEK_SET) == -1 || copy_fd_len(out, fd, out_len, NULL) != out_len;
+    if(!failed && err_len > 0)
+        failed = lseek(err, 0, SEEK_SET) == -1 || copy_fd_len(err, fd, err_len, NULL) != err_len;
+    if(close(fd) == -1 || failed || rename(temporary, path) == -1)
+    {
+        unlink(temporary);
+        return -1;
+    }
+    evict();
+    return 0;
+} // int cache_store(const struct cache_key*, int, int, int)
+
+int cache_clear(void)
+{
+    size_t count, i;
+    long long total;
+    struct cache_entry *entries;
+    int ret = 0;
+
+    if(dir[0] == '\0')
+        cache_configure(NULL, 0);
+    entries = list_entries(&count, &total);
+    for(i = 0; i < count; ++i)
+    {
+        char path[ENTRY_PATH_SIZE];
+        entry_path(entries[i].name, path);
+        if(unlink(path) == -1 && errno != ENOENT)
+            ret = -1;
+    }
+    free(entries);
+    return ret;
+} // int cache_clear()
+
+void cache_print(FILE *out)
+{
+    size_t count;
+    long long total;
+    struct cache_entry *entries;
+
+    if(dir[0] == '\0')
+        cache_configure(NULL, 0);
+    entries = list_entries(&count, &total);
+    free(entries);
+    fprintf(out, "directory    %s\n", dir);
+    fprintf(out, "entries      %zu\n", count);
+    fprintf(out, "size         %lld\n", total);
+    fprintf(out, "limit        %lld\n", limit);
+} // cache_print(FILE*)
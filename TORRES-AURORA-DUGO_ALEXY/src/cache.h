@@ -0,0 +1,46 @@
+#ifndef DEF_CACHE_H
+#define DEF_CACHE_H
+
+// STD INCLUDES
+#include <stdio.h>
+#include <stdint.h>
+
+// Shell variables : directory of the cache and its size limit in bytes
+#define CACHE_DIR_VAR  "ASR2_CACHE_DIR"
+#define CACHE_SIZE_VAR "ASR2_CACHE_SIZE"
+
+// Defaults, the directory is under $XDG_CACHE_HOME or $HOME/.cache
+#define CACHE_DIR_NAME "asr2_shell"
+#define CACHE_SIZE_DEFAULT (256LL * 1024 * 1024)
+
+// Hex name of an entry, two 64 bit hashes
+#define CACHE_NAME_SIZE 33
+
+// First line of an entry : magic, status, stdout and stderr sizes
+#define CACHE_MAGIC "ASR2CACHE1"
+#define CACHE_HEADER_MAX 128
+
+/*
+ * ############################################################
+ * #######   RESULT CACHE
+ * ############################################################
+ */
+
+// Hash of what the result of a command depends on
+struct cache_key {
+    uint64_t hash[2];
+    char name[CACHE_NAME_SIZE];
+}; // struct cache_key
+
+void cache_configure(const char *dir, long long size);
+void cache_key_init(struct cache_key *key);
+void cache_key_add(struct cache_key *key, const char *data, size_t len);
+void cache_key_file(struct cache_key *key, const char *path, int metadata);
+void cache_key_end(struct cache_key *key);
+int cache_open(const struct cache_key *key);
+int cache_replay(int fd, int out, int err);
+int cache_store(const struct cache_key *key, int status, int out, int err);
+int cache_clear(void);
+void cache_print(FILE *out);
+
+#endif // DEF_CACHE_H
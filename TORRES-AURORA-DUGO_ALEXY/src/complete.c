@@ -0,0 +1,490 @@
+// Needed for fdopendir and st_mtim
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+
+// HEADER
+#include "complete.h"
+
+/*
+ * ############################################################
+ * #######   TRIE
+ * ############################################################
+ */
+
+// Children are a sorted sibling list, nodes are never freed
+struct trie_node {
+    struct trie_node *child;
+    struct trie_node *sibling;
+    unsigned int words;         /* distinct words in this subtree, 0 means dead */
+    unsigned int terminal;      /* references to the word ending here */
+    char c;
+}; // struct trie_node
+
+static struct trie_node trie_root;
+
+static struct trie_node* trie_child(struct trie_node *node, char c, int create)
+{
+    struct trie_node **link = &node->child;
+
+    while(*link != NULL && (unsigned char)(*link)->c < (unsigned char)c)
+        link = &(*link)->sibling;
+    if(*link != NULL && (*link)->c == c)
+        return *link;
+    if(!create)
+        return NULL;
+
+    struct trie_node *child = calloc(1, sizeof(struct trie_node));
+    if(child == NULL)
+        return NULL;
+    child->c = c;
+    child->sibling = *link;
+    *link = child;
+    return child;
+} // struct trie_node* trie_child(struct trie_node*, char, int)
+
+static void trie_insert(const char *word)
+{
+    struct trie_node *node = &trie_root;
+    const char *c;
+
+    // Create the path first so a failed allocation changes nothing
+    for(c = word; *c != '\0'; ++c)
+    {
+        node = trie_child(node, *c, 1);
+        if(node == NULL)
+            return;
+    }
+
+    // Same name in another directory, only a new reference
+    if(node->terminal++ > 0)
+        return;
+
+    node = &trie_root;
+    node->words++;
+    for(c = word; *c != '\0'; ++c)
+    {
+        node = trie_child(node, *c, 0);
+        node->words++;
+    }
+} // trie_insert(const char*)
+
+static void trie_remove(const char *word)
+{
+    struct trie_node *node = &trie_root;
+    const char *c;
+
+    for(c = word; *c != '\0'; ++c)
+        node = trie_child(node, *c, 0);
+    if(--node->terminal > 0)
+        return;
+
+    node = &trie_root;
+    node->words--;
+    for(c = word; *c != '\0'; ++c)
+    {
+        node = trie_child(node, *c, 0);
+        node->words--;
+    }
+} // trie_remove(const char*)
+
+static struct trie_node* trie_find(const char *prefix)
+{
+    struct trie_node *node = &trie_root;
+
+    for(; *prefix != '\0' && node != NULL; ++prefix)
+        node = trie_child(node, *prefix, 0);
+    if(node == NULL || node->words == 0)
+        return NULL;
+    return node;
+} // struct trie_node* trie_find(const char*)
+
+// Words of the subtree in order, buffer holds the current word
+static void trie_collect(struct trie_node *node, char *buffer, int len, struct completion *result)
+{
+    struct trie_node *child;
+
+    if(node->terminal > 0 && result->count < COMPLETE_MAX)
+    {
+        buffer[len] = '\0';
+        result->words[result->count] = strdup(buffer);
+        result->is_dir[result->count++] = 0;
+    }
+
+    for(child = node->child; child != NULL && result->count < COMPLETE_MAX; child = child->sibling)
+    {
+        if(child->words == 0 || len + 1 >= PATH_MAX)
+            continue;
+        buffer[len] = child->c;
+        trie_collect(child, buffer, len + 1, result);
+    }
+} // trie_collect(struct trie_node*, char*, int, struct completion*)
+
+/*
+ * ############################################################
+ * #######   PATH EXECUTABLES
+ * ############################################################
+ */
+
+// A PATH directory and the names it added to the trie
+struct path_dir {
+    char *path;
+    int scanned;
+    struct timespec mtime;
+    char **names;
+    int count;
+    int capacity;
+}; // struct path_dir
+
+static struct path_dir dirs[COMPLETE_MAX_DIRS];
+static int dir_count = 0;
+static char *current_path = NULL;
+
+static void drop_names(struct path_dir *dir)
+{
+    int i;
+
+    for(i = 0; i < dir->count; ++i)
+    {
+        trie_remove(dir->names[i]);
+        free(dir->names[i]);
+    }
+    dir->count = 0;
+    dir->scanned = 0;
+} // drop_names(struct path_dir*)
+
+static void add_name(struct path_dir *dir, const char *name)
+{
+    if(dir->count == dir->capacity)
+    {
+        int capacity = dir->capacity ? dir->capacity * 2 : 64;
+        char **names = realloc(dir->names, sizeof(char*) * capacity);
+        if(names == NULL)
+            return;
+        dir->names = names;
+        dir->capacity = capacity;
+    }
+    dir->names[dir->count] = strdup(name);
+    if(dir->names[dir->count] == NULL)
+        return;
+    trie_insert(name);
+    dir->count++;
+} // add_name(struct path_dir*, const char*)
+
+static int compare_names(const void *a, const void *b)
+{
+    return strcmp(*(char * const*)a, *(char * const*)b);
+} // int compare_names(const void*, const void*)
+
+/*
+ * Names already known are kept without a stat, a chmod doesn't change
+ * the directory mtime anyway. Only new names are checked and the names
+ * gone are removed from the trie.
+ */
+static void scan_dir(struct path_dir *dir, const struct stat *dir_stat)
+{
+    struct dirent *entry;
+    struct stat file_stat;
+    int known = dir->count, kept = 0, i;
+
+    int fd = open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1)
+        return;
+    DIR *stream = fdopendir(fd);
+    char *seen = calloc(known + 1, 1);
+    if(stream == NULL || seen == NULL)
+    {
+        if(stream != NULL)
+            closedir(stream);
+        else
+            close(fd);
+        free(seen);
+        return;
+    }
+
+    while((entry = readdir(stream)) != NULL)
+    {
+        const char *name = entry->d_name;
+        if(entry->d_type != DT_REG && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN)
+            continue;
+
+        char **found = bsearch(&name, dir->names, known, sizeof(char*), compare_names);
+        if(found != NULL)
+        {
+            seen[found - dir->names] = 1;
+            continue;
+        }
+        if(fstatat(fd, name, &file_stat, 0) == 0 && S_ISREG(file_stat.st_mode) && (file_stat.st_mode & 0111))
+            add_name(dir, name);
+    }
+    closedir(stream);
+
+    // Drop the names gone, then keep the list sorted for the next scan
+    for(i = 0; i < dir->count; ++i)
+    {
+        if(i < known && !seen[i])
+        {
+            trie_remove(dir->names[i]);
+            free(dir->names[i]);
+            continue;
+        }
+        dir->names[kept++] = dir->names[i];
+    }
+    dir->count = kept;
+    free(seen);
+    if(dir->count > known)
+        qsort(dir->names, dir->count, sizeof(char*), compare_names);
+
+    dir->mtime = dir_stat->st_mtim;
+    dir->scanned = 1;
+} // scan_dir(struct path_dir*, const struct stat*)
+
+static void set_path(const char *path)
+{
+    int i;
+
+    for(i = 0; i < dir_count; ++i)
+    {
+        drop_names(&dirs[i]);
+        free(dirs[i].path);
+        dirs[i].path = NULL;
+    }
+    dir_count = 0;
+
+    free(current_path);
+    current_path = strdup(path);
+    if(current_path == NULL)
+        return;
+
+    // An empty entry is the current directory
+    const char *begin = path;
+    while(dir_count < COMPLETE_MAX_DIRS)
+    {
+        const char *end = strchr(begin, ':');
+        size_t len = end ? (size_t)(end - begin) : strlen(begin);
+        char *dir = len ? strndup(begin, len) : strdup(".");
+
+        // Same directory twice would only add references
+        for(i = 0; dir != NULL && i < dir_count; ++i)
+        {
+            if(strcmp(dirs[i].path, dir) == 0)
+                break;
+        }
+        if(dir != NULL && i == dir_count)
+            dirs[dir_count++].path = dir;
+        else
+            free(dir);
+
+        if(end == NULL)
+            break;
+        begin = end + 1;
+    }
+} // set_path(const char*)
+
+// Lazy first scan, then only the directories whose mtime changed
+static void refresh_path(void)
+{
+    const char *path = getenv("PATH");
+    struct stat dir_stat;
+    int i;
+
+    if(path == NULL)
+        path = "";
+    if(current_path == NULL || strcmp(current_path, path) != 0)
+        set_path(path);
+
+    for(i = 0; i < dir_count; ++i)
+    {
+        struct path_dir *dir = &dirs[i];
+        if(stat(dir->path, &dir_stat) == -1)
+        {
+            if(dir->scanned)
+                drop_names(dir);
+            continue;
+        }
+        if(dir->scanned && dir->mtime.tv_sec == dir_stat.st_mtim.tv_sec
+           && dir->mtime.tv_nsec == dir_stat.st_mtim.tv_nsec)
+            continue;
+
+        scan_dir(dir, &dir_stat);
+    }
+} // refresh_path()
+
+/*
+ * ############################################################
+ * #######   COMPLETION
+ * ############################################################
+ */
+
+static void complete_command(const char *word, struct completion *result)
+{
+    char buffer[PATH_MAX];
+    struct trie_node *node;
+
+    refresh_path();
+
+    node = trie_find(word);
+    if(node == NULL)
+        return;
+
+    // Common prefix : follow the only live child while no word ends
+    int len = snprintf(buffer, sizeof(buffer), "%s", word);
+    struct trie_node *prefix_node = node;
+    while(prefix_node->terminal == 0 && len + 1 < PATH_MAX)
+    {
+        struct trie_node *child, *live = NULL;
+        int live_count = 0;
+        for(child = prefix_node->child; child != NULL; child = child->sibling)
+        {
+            if(child->words > 0)
+            {
+                live = child;
+                ++live_count;
+            }
+        }
+        if(live_count != 1)
+            break;
+        buffer[len++] = live->c;
+        prefix_node = live;
+    }
+    buffer[len] = '\0';
+    result->prefix = strdup(buffer);
+    result->total = node->words;
+
+    len = snprintf(buffer, sizeof(buffer), "%s", word);
+    trie_collect(node, buffer, len, result);
+} // complete_command(const char*, struct completion*)
+
+static void complete_file(const char *word, struct completion *result)
+{
+    char dir_path[PATH_MAX];
+    char candidate[PATH_MAX];
+    struct dirent *entry;
+    struct stat file_stat;
+    size_t prefix_len = 0;
+
+    const char *slash = strrchr(word, '/');
+    const char *base = slash ? slash + 1 : word;
+    int dir_len = slash ? (int)(slash - word + 1) : 0;
+    size_t base_len = strlen(base);
+
+    snprintf(dir_path, sizeof(dir_path), "%.*s", dir_len, word);
+    DIR *stream = opendir(dir_len ? dir_path : ".");
+    if(stream == NULL)
+        return;
+
+    while((entry = readdir(stream)) != NULL)
+    {
+        const char *name = entry->d_name;
+        if(strncmp(name, base, base_len) != 0)
+            continue;
+        if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+        // Hidden files only when asked for
+        if(name[0] == '.' && base[0] != '.')
+            continue;
+
+        snprintf(candidate, sizeof(candidate), "%.*s%s", dir_len, word, name);
+        int is_dir = entry->d_type == DT_DIR;
+        if(entry->d_type == DT_LNK || entry->d_type == DT_UNKNOWN)
+            is_dir = fstatat(dirfd(stream), name, &file_stat, 0) == 0 && S_ISDIR(file_stat.st_mode);
+
+        // Shrink the common prefix to this match
+        if(result->prefix == NULL)
+        {
+            result->prefix = strdup(candidate);
+            prefix_len = result->prefix ? strlen(candidate) : 0;
+        }
+        else
+        {
+            size_t i = 0;
+            while(i < prefix_len && result->prefix[i] == candidate[i])
+                ++i;
+            prefix_len = i;
+            result->prefix[prefix_len] = '\0';
+        }
+
+        result->total++;
+        if(result->count < COMPLETE_MAX)
+        {
+            result->is_dir[result->count] = is_dir;
+            result->words[result->count++] = strdup(candidate);
+        }
+    }
+    closedir(stream);
+
+    // A single directory completes with its slash
+    if(result->total == 1 && result->is_dir[0] && result->prefix != NULL)
+    {
+        char *with_slash = malloc(strlen(result->prefix) + 2);
+        if(with_slash != NULL)
+        {
+            sprintf(with_slash, "%s/", result->prefix);
+            free(result->prefix);
+            result->prefix = with_slash;
+        }
+    }
+
+    // Sorted for display, is_dir is only needed for the single match
+    qsort(result->words, result->count, sizeof(char*), compare_names);
+} // complete_file(const char*, struct completion*)
+
+// Builtins stay in the trie for the life of the shell
+void complete_add_builtin(const char *name)
+{
+    trie_insert(name);
+} // complete_add_builtin(const char*)
+
+/*
+ * Candidates for the word ending at pos. Commands are completed from
+ * the trie in command position, everything else from the file system.
+ * Returns the number of matches.
+ */
+int complete_line(const char *line, int pos, struct completion *result)
+{
+    char word[PATH_MAX];
+    int start = pos, i;
+
+    memset(result, 0, sizeof(struct completion));
+
+    while(start > 0 && !isspace((unsigned char)line[start - 1]) && strchr("|;&(<>,", line[start - 1]) == NULL)
+        --start;
+    result->start = start;
+    snprintf(word, sizeof(word), "%.*s", pos - start, line + start);
+
+    // Command position : start of line or after an operator
+    for(i = start - 1; i >= 0 && isspace((unsigned char)line[i]); --i)
+        ;
+    int is_command = (i < 0 || strchr("|;&(,", line[i]) != NULL) && strchr(word, '/') == NULL;
+
+    if(is_command)
+        complete_command(word, result);
+    else
+        complete_file(word, result);
+
+    return result->total;
+} // int complete_line(const char*, int, struct completion*)
+
+void complete_free(struct completion *result)
+{
+    int i;
+
+    for(i = 0; i < result->count; ++i)
+        free(result->words[i]);
+    free(result->prefix);
+    result->count = 0;
+    result->total = 0;
+    result->prefix = NULL;
+} // complete_free(struct completion*)
@@ -0,0 +1,30 @@
+#ifndef DEF_COMPLETE_H
+#define DEF_COMPLETE_H
+
+// Max candidates returned by one completion
+#define COMPLETE_MAX 256
+
+// Max PATH directories followed
+#define COMPLETE_MAX_DIRS 64
+
+/*
+ * ############################################################
+ * #######   COMPLETION
+ * ############################################################
+ */
+
+// Candidates for the word under the cursor
+struct completion {
+    int start;                  /* index of the word in the line */
+    int total;                  /* matches, may be more than count */
+    int count;                  /* candidates stored in words */
+    char *prefix;               /* longest common prefix of all matches */
+    char *words[COMPLETE_MAX];
+    int is_dir[COMPLETE_MAX];   /* file candidates that are directories */
+}; // struct completion
+
+void complete_add_builtin(const char *name);
+int complete_line(const char *line, int pos, struct completion *result);
+void complete_free(struct completion *result);
+
+#endif // DEF_COMPLETE_H
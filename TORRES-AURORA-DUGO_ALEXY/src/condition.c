@@ -0,0 +1,416 @@
+// Needed for O_PATH and AT_EACCESS
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// HEADER
+#include "condition.h"
+#include "vars.h"
+#include "dirs.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STAT CACHE
+ * ############################################################
+ */
+
+// Result of a stat, valid for the command line it was done in
+struct stat_entry {
+    char *path;
+    int follow;                 /* stat, not lstat */
+    int error;                  /* errno of the stat, 0 if it worked */
+    struct stat st;
+    unsigned long line;
+}; // struct stat_entry
+
+static struct stat_entry cache[CONDITION_CACHE_SIZE];
+static int cache_next = 0;
+static unsigned long current_line = 1;
+
+static int cache_enabled(void)
+{
+    const char *value = vars_get(CONDITION_CACHE_VAR);
+    return value != NULL && strcmp(value, "1") == 0;
+} // int cache_enabled()
+
+static int cached_stat(const char *path, int follow, struct stat *st)
+{
+    int use_cache = cache_enabled();
+    int i;
+
+    if(use_cache)
+    {
+        for(i = 0; i < CONDITION_CACHE_SIZE; ++i)
+        {
+            struct stat_entry *entry = &cache[i];
+            if(entry->line != current_line || entry->follow != follow || strcmp(entry->path, path) != 0)
+                continue;
+            *st = entry->st;
+            errno = entry->error;
+            return entry->error ? -1 : 0;
+        }
+    }
+
+    int ret = fstatat(dirs_fd(), path, st, follow ? 0 : AT_SYMLINK_NOFOLLOW);
+    int error = ret == -1 ? errno : 0;
+
+    if(use_cache)
+    {
+        struct stat_entry *entry = &cache[cache_next];
+        char *copy = strdup(path);
+        if(copy != NULL)
+        {
+            free(entry->path);
+            entry->path = copy;
+            entry->follow = follow;
+            entry->error = error;
+            entry->st = *st;
+            entry->line = current_line;
+            cache_next = (cache_next + 1) % CONDITION_CACHE_SIZE;
+        }
+    }
+
+    errno = error;
+    return ret;
+} // int cached_stat(const char*, int, struct stat*)
+
+// Entries of the previous line are stale
+void condition_new_line(void)
+{
+    ++current_line;
+} // condition_new_line()
+
+// Relative paths cached before a cd name other files
+void condition_chdir(void)
+{
+    ++current_line;
+} // condition_chdir()
+
+/*
+ * ############################################################
+ * #######   PRIMARIES
+ * ############################################################
+ */
+
+static const char *unary_ops[] = {
+    "-b", "-c", "-d", "-e", "-f", "-g", "-h", "-k", "-L", "-n", "-p", "-r", "-s",
+    "-S", "-t", "-u", "-w", "-x", "-z", "-G", "-O", NULL
+};
+
+static const char *binary_ops[] = {
+    "=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", "-nt", "-ot", "-ef", NULL
+};
+
+// Parsing state, argv[pos] is the next word and end the last one
+struct test_parser {
+    char **argv;
+    int pos;
+    int end;
+    int error;
+}; // struct test_parser
+
+static int in_list(const char *word, const char **list)
+{
+    for(; *list != NULL; ++list)
+    {
+        if(strcmp(word, *list) == 0)
+            return 1;
+    }
+    return 0;
+} // int in_list(const char*, const char**)
+
+static long long to_integer(struct test_parser *p, const char *word)
+{
+    char *end;
+
+    while(isspace((unsigned char)*word))
+        ++word;
+    errno = 0;
+    long long value = strtoll(word, &end, 10);
+    while(isspace((unsigned char)*end))
+        ++end;
+    if(*word == '\0' || *end != '\0' || errno == ERANGE)
+    {
+        ERROR("test : integer expression expected", word);
+        p->error = 1;
+        return 0;
+    }
+    return value;
+} // long long to_integer(struct test_parser*, const char*)
+
+static int unary(struct test_parser *p, const char *op, const char *arg)
+{
+    struct stat st;
+    int mode = 0;
+
+    switch(op[1])
+    {
+        case 'n': return arg[0] != '\0';
+        case 'z': return arg[0] == '\0';
+        case 't': return isatty(to_integer(p, arg));
+        case 'r': mode = R_OK; break;
+        case 'w': mode = W_OK; break;
+        case 'x': mode = X_OK; break;
+        default: break;
+    }
+
+    // Permissions need the real access check, a missing file is known
+    if(mode)
+    {
+        if(cached_stat(arg, 1, &st) == -1)
+            return 0;
+        return faccessat(dirs_fd(), arg, mode, AT_EACCESS) == 0;
+    }
+
+    if(op[1] == 'h' || op[1] == 'L')
+        return cached_stat(arg, 0, &st) == 0 && S_ISLNK(st.st_mode);
+    if(cached_stat(arg, 1, &st) == -1)
+        return 0;
+
+    switch(op[1])
+    {
+        case 'b': return S_ISBLK(st.st_mode);
+        case 'c': return S_ISCHR(st.st_mode);
+        case 'd': return S_ISDIR(st.st_mode);
+        case 'e': return 1;
+        case 'f': return S_ISREG(st.st_mode);
+        case 'g': return (st.st_mode & S_ISGID) != 0;
+        case 'k': return (st.st_mode & S_ISVTX) != 0;
+        case 'p': return S_ISFIFO(st.st_mode);
+        case 's': return st.st_size > 0;
+        case 'S': return S_ISSOCK(st.st_mode);
+        case 'u': return (st.st_mode & S_ISUID) != 0;
+        case 'G': return st.st_gid == getegid();
+        case 'O': return st.st_uid == geteuid();
+    }
+    return 0;
+} // int unary(struct test_parser*, const char*, const char*)
+
+// -1 if a is older, 1 if newer, a missing file is the oldest
+static int compare_mtime(const struct stat *a, int a_ok, const struct stat *b, int b_ok)
+{
+    if(!a_ok || !b_ok)
+        return a_ok - b_ok;
+    if(a->st_mtim.tv_sec != b->st_mtim.tv_sec)
+        return a->st_mtim.tv_sec < b->st_mtim.tv_sec ? -1 : 1;
+    if(a->st_mtim.tv_nsec != b->st_mtim.tv_nsec)
+        return a->st_mtim.tv_nsec < b->st_mtim.tv_nsec ? -1 : 1;
+    return 0;
+} // int compare_mtime(const struct stat*, int, const struct stat*, int)
+
+static int binary(struct test_parser *p, const char *left, const char *op, const char *right)
+{
+    struct stat left_stat, right_stat;
+
+    if(strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+        return strcmp(left, right) == 0;
+    if(strcmp(op, "!=") == 0)
+        return strcmp(left, right) != 0;
+    if(strcmp(op, "<") == 0)
+        return strcmp(left, right) < 0;
+    if(strcmp(op, ">") == 0)
+        return strcmp(left, right) > 0;
+
+    if(strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0)
+    {
+        int left_ok = cached_stat(left, 1, &left_stat) == 0;
+        int right_ok = cached_stat(right, 1, &right_stat) == 0;
+        if(op[1] == 'e')
+            return left_ok && right_ok && left_stat.st_dev == right_stat.st_dev
+                   && left_stat.st_ino == right_stat.st_ino;
+        int order = compare_mtime(&left_stat, left_ok, &right_stat, right_ok);
+        return op[1] == 'n' ? order > 0 : order < 0;
+    }
+
+    long long a = to_integer(p, left);
+    long long b = to_integer(p, right);
+    if(strcmp(op, "-eq") == 0) return a == b;
+    if(strcmp(op, "-ne") == 0) return a != b;
+    if(strcmp(op, "-lt") == 0) return a < b;
+    if(strcmp(op, "-le") == 0) return a <= b;
+    if(strcmp(op, "-gt") == 0) return a > b;
+    return a >= b;
+} // int binary(struct test_parser*, const char*, const char*, const char*)
+
+/*
+ * ############################################################
+ * #######   EXPRESSIONS
+ * ############################################################
+ */
+
+static int parse_or(struct test_parser *p);
+
+static int parse_primary(struct test_parser *p)
+{
+    char **argv = p->argv;
+    int left = p->end - p->pos;
+
+    if(left <= 0)
+    {
+        ERROR("test : argument expected", "\n");
+        p->error = 1;
+        return 0;
+    }
+
+    if(strcmp(argv[p->pos], "(") == 0 && left > 1)
+    {
+        ++p->pos;
+        int value = parse_or(p);
+        if(p->pos >= p->end || strcmp(argv[p->pos], ")") != 0)
+        {
+            ERROR("test : missing )", "\n");
+            p->error = 1;
+            return 0;
+        }
+        ++p->pos;
+        return value;
+    }
+
+    if(left >= 3 && in_list(argv[p->pos + 1], binary_ops))
+    {
+        p->pos += 3;
+        return binary(p, argv[p->pos - 3], argv[p->pos - 2], argv[p->pos - 1]);
+    }
+    if(left >= 2 && in_list(argv[p->pos], unary_ops))
+    {
+        p->pos += 2;
+        return unary(p, argv[p->pos - 2], argv[p->pos - 1]);
+    }
+
+    // A lone string is true when not empty
+    return argv[p->pos++][0] != '\0';
+} // int parse_primary(struct test_parser*)
+
+static int parse_not(struct test_parser *p)
+{
+    if(p->pos < p->end && strcmp(p->argv[p->pos], "!") == 0 && p->end - p->pos > 1)
+    {
+        ++p->pos;
+        return !parse_not(p);
+    }
+    return parse_primary(p);
+} // int parse_not(struct test_parser*)
+
+static int parse_and(struct test_parser *p)
+{
+    int value = parse_not(p);
+
+    while(p->pos < p->end && strcmp(p->argv[p->pos], "-a") == 0)
+    {
+        ++p->pos;
+        int right = parse_not(p);
+        value = value && right;
+    }
+    return value;
+} // int parse_and(struct test_parser*)
+
+static int parse_or(struct test_parser *p)
+{
+    int value = parse_and(p);
+
+    while(p->pos < p->end && strcmp(p->argv[p->pos], "-o") == 0)
+    {
+        ++p->pos;
+        int right = parse_and(p);
+        value = value || right;
+    }
+    return value;
+} // int parse_or(struct test_parser*)
+
+// POSIX rules by argument count, the grammar is only for more than 4
+static int evaluate(struct test_parser *p)
+{
+    char **argv = p->argv + p->pos;
+    int count = p->end - p->pos;
+
+    switch(count)
+    {
+        case 0:
+            return 0;
+        case 1:
+            return argv[0][0] != '\0';
+        case 2:
+            if(strcmp(argv[0], "!") == 0)
+                return argv[1][0] == '\0';
+            if(in_list(argv[0], unary_ops))
+                return unary(p, argv[0], argv[1]);
+            break;
+        case 3:
+            if(in_list(argv[1], binary_ops))
+                return binary(p, argv[0], argv[1], argv[2]);
+            if(strcmp(argv[1], "-a") == 0)
+                return argv[0][0] != '\0' && argv[2][0] != '\0';
+            if(strcmp(argv[1], "-o") == 0)
+                return argv[0][0] != '\0' || argv[2][0] != '\0';
+            if(strcmp(argv[0], "!") == 0)
+            {
+                ++p->pos;
+                return !evaluate(p);
+            }
+            if(strcmp(argv[0], "(") == 0 && strcmp(argv[2], ")") == 0)
+                return argv[1][0] != '\0';
+            break;
+        case 4:
+            if(strcmp(argv[0], "!") == 0)
+            {
+                ++p->pos;
+                return !evaluate(p);
+            }
+            if(strcmp(argv[0], "(") == 0 && strcmp(argv[3], ")") == 0)
+            {
+                ++p->pos;
+                --p->end;
+                return evaluate(p);
+            }
+            break;
+    }
+
+    int value = parse_or(p);
+    if(!p->error && p->pos != p->end)
+    {
+        ERROR("test : too many arguments", p->argv[p->pos]);
+        p->error = 1;
+    }
+    return value;
+} // int evaluate(struct test_parser*)
+
+/*
+ * test and [ : argv[0] is the command name, [ needs a closing ].
+ * Returns CONDITION_TRUE, CONDITION_FALSE or CONDITION_ERROR.
+ */
+int condition_test(int argc, char **argv)
+{
+    struct test_parser p;
+
+    p.argv = argv;
+    p.pos = 1;
+    p.end = argc;
+    p.error = 0;
+
+    if(strcmp(argv[0], "[") == 0)
+    {
+        if(argc < 2 || strcmp(argv[argc - 1], "]") != 0)
+        {
+            ERROR("[ : missing ]", "\n");
+            return CONDITION_ERROR;
+        }
+        --p.end;
+    }
+
+    int value = evaluate(&p);
+    if(p.error)
+        return CONDITION_ERROR;
+    return value ? CONDITION_TRUE : CONDITION_FALSE;
+} // int condition_test(int, char**)
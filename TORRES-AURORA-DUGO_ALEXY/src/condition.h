@@ -0,0 +1,25 @@
+#ifndef DEF_CONDITION_H
+#define DEF_CONDITION_H
+
+// Paths remembered by the stat cache of one command line
+#define CONDITION_CACHE_SIZE 16
+
+// Shell variable enabling the stat cache when set to 1
+#define CONDITION_CACHE_VAR "TEST_STAT_CACHE"
+
+// Exit status of test
+#define CONDITION_TRUE  0
+#define CONDITION_FALSE 1
+#define CONDITION_ERROR 2
+
+/*
+ * ############################################################
+ * #######   TEST
+ * ############################################################
+ */
+
+int condition_test(int argc, char **argv);
+void condition_new_line(void);
+void condition_chdir(void);
+
+#endif // DEF_CONDITION_H
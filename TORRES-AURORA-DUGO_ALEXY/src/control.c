@@ -0,0 +1,1091 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+
+// SYSTEM INCLUDES
+#include <glob.h>
+
+// HEADER
+#include "control.h"
+#include "function.h"
+#include "vars.h"
+#include "condition.h"
+#include "dirs.h"
+#include "walk.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   PARSER
+ * ############################################################
+ */
+
+// Here-document whose body starts after the current line
+struct heredoc {
+    struct control_node *node;
+    char delimiter[CONTROL_WORD_SIZE];
+    int strip_tabs;             /* <<- */
+}; // struct heredoc
+
+struct parser {
+    const char *text;
+    size_t pos;
+    int status;                 /* CONTROL_COMPLETE until something fails */
+    struct heredoc heredocs[CONTROL_HEREDOC_MAX];
+    int heredoc_count;
+}; // struct parser
+
+static const char *then_words[] = {"then", NULL};
+static const char *else_words[] = {"elif", "else", "fi", NULL};
+static const char *fi_words[] = {"fi", NULL};
+static const char *do_words[] = {"do", NULL};
+static const char *done_words[] = {"done", NULL};
+static const char *brace_words[] = {"}", NULL};
+static const char *closing_words[] = {"then", "elif", "else", "fi", "do", "done", "}", NULL};
+
+static char error_message[CONTROL_WORD_SIZE + 64];
+
+// Here-document the last parse ran out of lines in, for control_heredoc_line
+static struct heredoc waiting;
+static int is_waiting = 0;
+
+static void fail(struct parser *p, int status, const char *message, const char *word)
+{
+    if(p->status != CONTROL_COMPLETE)
+        return;
+    p->status = status;
+    if(word != NULL)
+        snprintf(error_message, sizeof(error_message), "%s '%s'", message, word);
+    else
+        snprintf(error_message, sizeof(error_message), "%s", message);
+} // fail(struct parser*, int, const char*, const char*)
+
+static struct control_node* new_node(struct parser *p, int type)
+{
+    struct control_node *node = calloc(1, sizeof(struct control_node));
+
+    if(node == NULL)
+        fail(p, CONTROL_ERROR, "Out of memory", NULL);
+    else
+        node->type = type;
+    return node;
+} // struct control_node* new_node(struct parser*, int)
+
+static int is_one_of(const char *word, const char **words)
+{
+    for(; *words != NULL; ++words)
+    {
+        if(strcmp(word, *words) == 0)
+            return 1;
+    }
+    return 0;
+} // int is_one_of(const char*, const char**)
+
+// Blanks and comments, a # only starts a comment at the start of a word
+static void skip_blanks(struct parser *p)
+{
+    const char *text = p->text;
+
+    for(;;)
+    {
+        while(text[p->pos] == ' ' || text[p->pos] == '\t' || text[p->pos] == '\r')
+            ++p->pos;
+        if(text[p->pos] != '#')
+            return;
+        while(text[p->pos] != '\0' && text[p->pos] != '\n')
+            ++p->pos;
+    }
+} // skip_blanks(struct parser*)
+
+/*
+ * Body of a here-document, the lines up to its delimiter. Tabs are
+ * stripped at the start of the lines for <<-.
+ */
+static void read_heredoc(struct parser *p, struct heredoc *heredoc)
+{
+    size_t delimiter_len = strlen(heredoc->delimiter);
+    size_t size = 1, len = 0;
+    char *body = malloc(size);
+
+    if(body == NULL)
+    {
+        fail(p, CONTROL_ERROR, "Out of memory", NULL);
+        return;
+    }
+    for(;;)
+    {
+        const char *line = p->text + p->pos;
+        size_t line_len;
+
+        if(heredoc->strip_tabs)
+        {
+            while(*line == '\t')
+                ++line;
+        }
+        line_len = strcspn(line, "\n");
+        if(line_len == delimiter_len && strncmp(line, heredoc->delimiter, line_len) == 0)
+        {
+            p->pos = line + line_len - p->text;
+            if(p->text[p->pos] == '\n')
+                ++p->pos;
+            break;
+        }
+        if(line[line_len] == '\0')
+        {
+            // More lines may come with the delimiter
+            free(body);
+            waiting = *heredoc;
+            is_waiting = 1;
+            p->pos = line + line_len - p->text;
+            fail(p, CONTROL_INCOMPLETE, "Missing here-document end", heredoc->delimiter);
+            return;
+        }
+
+        if(len + line_len + 2 > size)
+        {
+            size_t grown_size = (len + line_len + 2) * 2;
+            char *grown = realloc(body, grown_size);
+            if(grown == NULL)
+            {
+                free(body);
+                fail(p, CONTROL_ERROR, "Out of memory", NULL);
+                return;
+            }
+            body = grown;
+            size = grown_size;
+        }
+        memcpy(body + len, line, line_len + 1);
+        len += line_len + 1;
+        p->pos = line + line_len + 1 - p->text;
+    }
+    body[len] = '\0';
+    heredoc->node->body = body;
+} // read_heredoc(struct parser*, struct heredoc*)
+
+// A newline ends a line, the bodies of its here-documents follow it
+static void skip_newline(struct parser *p)
+{
+    int i;
+
+    ++p->pos;
+    for(i = 0; i < p->heredoc_count && p->status == CONTROL_COMPLETE; ++i)
+        read_heredoc(p, &p->heredocs[i]);
+    p->heredoc_count = 0;
+} // skip_newline(struct parser*)
+
+static void skip_separators(struct parser *p)
+{
+    for(;;)
+    {
+        skip_blanks(p);
+        if(p->text[p->pos] == '\n')
+            skip_newline(p);
+        else if(p->text[p->pos] == ';')
+            ++p->pos;
+        else
+            return;
+    }
+} // skip_separators(struct parser*)
+
+// Word at the current position, not consumed
+static size_t peek_word(struct parser *p, char *word)
+{
+    const char *start = p->text + p->pos;
+    size_t len = strcspn(start, " \t\r\n;&|()");
+
+    if(len >= CONTROL_WORD_SIZE)
+    {
+        // Too long for a keyword anyway
+        word[0] = '\0';
+        return len;
+    }
+    memcpy(word, start, len);
+    word[len] = '\0';
+    return len;
+} // size_t peek_word(struct parser*, char*)
+
+static int expect(struct parser *p, const char *keyword)
+{
+    char word[CONTROL_WORD_SIZE];
+
+    if(p->status != CONTROL_COMPLETE)
+        return -1;
+    skip_separators(p);
+    if(p->text[p->pos] == '\0')
+    {
+        fail(p, CONTROL_INCOMPLETE, "Missing", keyword);
+        return -1;
+    }
+    peek_word(p, word);
+    if(strcmp(word, keyword) != 0)
+    {
+        fail(p, CONTROL_ERROR, "Expected", keyword);
+        return -1;
+    }
+    p->pos += strlen(keyword);
+    return 0;
+} // int expect(struct parser*, const char*)
+
+static struct control_node* parse_list(struct parser *p, const char **ends);
+static struct control_node* parse_command(struct parser *p);
+
+/*
+ * Delimiter of the here-document at i, just after <<. Quotes in it are
+ * removed and keep the body from being expanded. Returns the position
+ * after the delimiter, 0 on error.
+ */
+static size_t parse_delimiter(struct parser *p, size_t i, struct heredoc *heredoc, int *literal)
+{
+    const char *text = p->text;
+    size_t len = 0;
+
+    heredoc->strip_tabs = text[i] == '-';
+    if(heredoc->strip_tabs)
+        ++i;
+    while(text[i] == ' ' || text[i] == '\t')
+        ++i;
+
+    *literal = 0;
+    for(; text[i] != '\0' && strchr(" \t\r\n;&|()<>", text[i]) == NULL; ++i)
+    {
+        if(text[i] == '\'' || text[i] == '"')
+        {
+            *literal = 1;
+            continue;
+        }
+        if(len + 1 >= CONTROL_WORD_SIZE)
+        {
+            fail(p, CONTROL_ERROR, "Here-document delimiter too long", NULL);
+            return 0;
+        }
+        heredoc->delimiter[len++] = text[i];
+    }
+    heredoc->delimiter[len] = '\0';
+    if(len == 0)
+    {
+        fail(p, CONTROL_ERROR, "Missing here-document delimiter", NULL);
+        return 0;
+    }
+    return i;
+} // size_t parse_delimiter(struct parser*, size_t, struct heredoc*, int*)
+
+/*
+ * Text up to ;, &&, || or a newline out of parentheses and quotes.
+ * Pipes, & and redirections stay in it, run_command handles them.
+ * A << here-document gets its body once the line is over.
+ */
+static struct control_node* parse_simple(struct parser *p)
+{
+    const char *text = p->text;
+    size_t i = p->pos, end;
+    int depth = 0, literal = 0;
+    char quote = '\0';
+    struct heredoc *heredoc = NULL;
+
+    for(; text[i] != '\0'; ++i)
+    {
+        char c = text[i];
+        if(quote != '\0')
+        {
+            if(c == quote)
+                quote = '\0';
+        }
+        else if(c == '\'' || c == '"')
+            quote = c;
+        else if(c == '<' && text[i + 1] == '<' && text[i + 2] == '<')
+            // Here-string, run_command reads the word
+            i += 2;
+        else if(c == '<' && text[i + 1] == '<')
+        {
+            if(heredoc != NULL)
+            {
+                fail(p, CONTROL_ERROR, "Only one here-document per command", NULL);
+                return NULL;
+            }
+            if(p->heredoc_count >= CONTROL_HEREDOC_MAX)
+            {
+                fail(p, CONTROL_ERROR, "Too many here-documents on a line", NULL);
+                return NULL;
+            }
+            heredoc = &p->heredocs[p->heredoc_count];
+            i = parse_delimiter(p, i + 2, heredoc, &literal);
+            if(i == 0)
+                return NULL;
+            // Back on the character after the delimiter
+            --i;
+        }
+        else if(c == '$' && text[i + 1] == '{')
+        {
+            while(text[i] != '\0' && text[i] != '}')
+                ++i;
+            if(text[i] == '\0')
+                break;
+        }
+        else if(c == '$' && text[i + 1] == '(' && text[i + 2] == '(')
+        {
+            // Arithmetic, its << is a shift
+            int nested = 0;
+            for(i += 3; text[i] != '\0'; ++i)
+            {
+                if(text[i] == '(')
+                    ++nested;
+                else if(text[i] == ')' && nested > 0)
+                    --nested;
+                else if(text[i] == ')' && text[i + 1] == ')')
+                    break;
+            }
+            if(text[i] == '\0')
+            {
+                depth = 1;
+                break;
+            }
+            ++i;
+        }
+        else if(c == '(')
+            ++depth;
+        else if(c == ')' && depth > 0)
+            --depth;
+        else if(depth == 0 && (c == '\n' || c == ';' || (c == '&' && text[i + 1] == '&')
+                               || (c == '|' && text[i + 1] == '|')))
+            break;
+        else if(c == '#' && (i == p->pos || isspace((unsigned char)text[i - 1])))
+            break;
+    }
+
+    if(quote != '\0' || depth > 0)
+    {
+        fail(p, CONTROL_INCOMPLETE, "Unterminated quote or parenthesis", NULL);
+        return NULL;
+    }
+
+    end = i;
+    while(end > p->pos && isspace((unsigned char)text[end - 1]))
+        --end;
+    if(end == p->pos)
+    {
+        char word[2] = {text[i], '\0'};
+        fail(p, CONTROL_ERROR, "Unexpected", text[i] == '\0' ? "end of input" : word);
+        return NULL;
+    }
+
+    struct control_node *node = new_node(p, CONTROL_SIMPLE);
+    if(node == NULL)
+        return NULL;
+    node->text = strndup(text + p->pos, end - p->pos);
+    if(heredoc != NULL)
+    {
+        heredoc->node = node;
+        node->literal = literal;
+        ++p->heredoc_count;
+    }
+    p->pos = i;
+    // The comment is left to skip_blanks
+    return node;
+} // struct control_node* parse_simple(struct parser*)
+
+// A list up to one of ends which must not be empty
+static struct control_node* parse_body(struct parser *p, const char **ends)
+{
+    char word[CONTROL_WORD_SIZE];
+    struct control_node *list = parse_list(p, ends);
+
+    if(p->status == CONTROL_COMPLETE && list == NULL)
+    {
+        peek_word(p, word);
+        fail(p, CONTROL_ERROR, "Unexpected", word);
+    }
+    return list;
+} // struct control_node* parse_body(struct parser*, const char**)
+
+// if, then elif chains are nested if nodes sharing the last fi
+static struct control_node* parse_if(struct parser *p)
+{
+    char word[CONTROL_WORD_SIZE];
+    struct control_node *node = new_node(p, CONTROL_IF);
+
+    if(node == NULL)
+        return NULL;
+    node->first = parse_body(p, then_words);
+    if(expect(p, "then") == -1)
+        return node;
+    node->second = parse_body(p, else_words);
+    if(p->status != CONTROL_COMPLETE)
+        return node;
+
+    skip_separators(p);
+    peek_word(p, word);
+    if(strcmp(word, "elif") == 0)
+    {
+        p->pos += 4;
+        node->other = parse_if(p);
+    }
+    else if(strcmp(word, "else") == 0)
+    {
+        p->pos += 4;
+        node->other = parse_body(p, fi_words);
+        expect(p, "fi");
+    }
+    else
+        expect(p, "fi");
+    return node;
+} // struct control_node* parse_if(struct parser*)
+
+static struct control_node* parse_loop(struct parser *p, int type)
+{
+    struct control_node *node = new_node(p, type);
+
+    if(node == NULL)
+        return NULL;
+    node->first = parse_body(p, do_words);
+    if(expect(p, "do") == -1)
+        return node;
+    node->second = parse_body(p, done_words);
+    expect(p, "done");
+    return node;
+} // struct control_node* parse_loop(struct parser*, int)
+
+// for name [in words] ; do list done, without in the words are $@
+static struct control_node* parse_for(struct parser *p)
+{
+    char word[CONTROL_WORD_SIZE];
+    struct control_node *node = new_node(p, CONTROL_FOR);
+    size_t len;
+
+    if(node == NULL)
+        return NULL;
+    skip_blanks(p);
+    if(p->text[p->pos] == '\0' || p->text[p->pos] == '\n')
+    {
+        fail(p, p->text[p->pos] == '\0' ? CONTROL_INCOMPLETE : CONTROL_ERROR, "Missing for variable", NULL);
+        return node;
+    }
+    len = peek_word(p, word);
+    if(!vars_is_name(word, strlen(word)))
+    {
+        fail(p, CONTROL_ERROR, "Bad for variable", word);
+        return node;
+    }
+    node->name = strdup(word);
+    p->pos += len;
+
+    skip_blanks(p);
+    len = peek_word(p, word);
+    if(strcmp(word, "in") == 0)
+    {
+        p->pos += len;
+        len = strcspn(p->text + p->pos, ";\n");
+        node->text = strndup(p->text + p->pos, len);
+        p->pos += len;
+    }
+
+    if(expect(p, "do") == -1)
+        return node;
+    node->second = parse_body(p, done_words);
+    expect(p, "done");
+    return node;
+} // struct control_node* parse_for(struct parser*)
+
+// { list; }, the braces are words like in sh
+static struct control_node* parse_group(struct parser *p)
+{
+    struct control_node *node = new_node(p, CONTROL_GROUP);
+
+    if(node == NULL)
+        return NULL;
+    node->first = parse_body(p, brace_words);
+    expect(p, "}");
+    return node;
+} // struct control_node* parse_group(struct parser*)
+
+// Length of "()" with optional blanks at the current position, 0 if none
+static size_t parentheses(struct parser *p)
+{
+    const char *start = p->text + p->pos, *c = start;
+
+    while(*c == ' ' || *c == '\t')
+        ++c;
+    if(*c++ != '(')
+        return 0;
+    while(*c == ' ' || *c == '\t')
+        ++c;
+    if(*c++ != ')')
+        return 0;
+    return c - start;
+} // size_t parentheses(struct parser*)
+
+// name() { list; } or function name [()] { list; }, after the name
+static struct control_node* parse_function(struct parser *p, const char *name)
+{
+    char word[CONTROL_WORD_SIZE];
+    struct control_node *node = new_node(p, CONTROL_FUNCTION);
+
+    if(node == NULL)
+        return NULL;
+    node->name = strdup(name);
+    p->pos += parentheses(p);
+
+    // The body may start on the next line
+    while(skip_blanks(p), p->text[p->pos] == '\n')
+        skip_newline(p);
+    if(p->text[p->pos] == '\0')
+    {
+        fail(p, CONTROL_INCOMPLETE, "Missing function body of", name);
+        return node;
+    }
+    peek_word(p, word);
+    if(strcmp(word, "{") != 0)
+    {
+        fail(p, CONTROL_ERROR, "Expected '{' after", name);
+        return node;
+    }
+    ++p->pos;
+    node->first = parse_group(p);
+    return node;
+} // struct control_node* parse_function(struct parser*, const char*)
+
+static struct control_node* parse_command(struct parser *p)
+{
+    char word[CONTROL_WORD_SIZE];
+    struct control_node *node;
+    size_t len;
+
+    skip_blanks(p);
+    len = peek_word(p, word);
+
+    if(strcmp(word, "!") == 0)
+    {
+        ++p->pos;
+        node = new_node(p, CONTROL_NOT);
+        if(node != NULL)
+            node->first = parse_command(p);
+        return node;
+    }
+    if(strcmp(word, "if") == 0)
+    {
+        p->pos += 2;
+        return parse_if(p);
+    }
+    if(strcmp(word, "while") == 0 || strcmp(word, "until") == 0)
+    {
+        p->pos += 5;
+        return parse_loop(p, word[0] == 'w' ? CONTROL_WHILE : CONTROL_UNTIL);
+    }
+    if(strcmp(word, "for") == 0)
+    {
+        p->pos += 3;
+        return parse_for(p);
+    }
+    if(strcmp(word, "{") == 0)
+    {
+        ++p->pos;
+        return parse_group(p);
+    }
+    if(strcmp(word, "function") == 0)
+    {
+        p->pos += len;
+        skip_blanks(p);
+        len = peek_word(p, word);
+        if(!vars_is_name(word, strlen(word)))
+        {
+            fail(p, CONTROL_ERROR, "Bad function name", word);
+            return NULL;
+        }
+        p->pos += len;
+        return parse_function(p, word);
+    }
+    if(vars_is_name(word, strlen(word)))
+    {
+        // A name directly followed by () defines a function
+        p->pos += len;
+        if(parentheses(p) > 0)
+            return parse_function(p, word);
+        p->pos -= len;
+    }
+    if(is_one_of(word, closing_words))
+    {
+        fail(p, CONTROL_ERROR, "Unexpected", word);
+        return NULL;
+    }
+    return parse_simple(p);
+} // struct control_node* parse_command(struct parser*)
+
+// Commands joined by && and ||, a newline may follow the operator
+static struct control_node* parse_and_or(struct parser *p)
+{
+    struct control_node *left = parse_command(p);
+
+    while(p->status == CONTROL_COMPLETE)
+    {
+        const char *c;
+        int type;
+
+        skip_blanks(p);
+        c = p->text + p->pos;
+        if(c[0] == '&' && c[1] == '&')
+            type = CONTROL_AND;
+        else if(c[0] == '|' && c[1] == '|')
+            type = CONTROL_OR;
+        else
+            break;
+        p->pos += 2;
+
+        while(skip_blanks(p), p->text[p->pos] == '\n')
+            skip_newline(p);
+        if(p->text[p->pos] == '\0')
+        {
+            fail(p, CONTROL_INCOMPLETE, "Missing command after", type == CONTROL_AND ? "&&" : "||");
+            break;
+        }
+
+        struct control_node *node = new_node(p, type);
+        if(node == NULL)
+            break;
+        node->first = left;
+        left = node;
+        node->second = parse_command(p);
+    }
+    return left;
+} // struct control_node* parse_and_or(struct parser*)
+
+/*
+ * Commands separated by ; or newlines up to one of the ends keywords,
+ * left for the caller. ends is NULL for the whole input.
+ */
+static struct control_node* parse_list(struct parser *p, const char **ends)
+{
+    char word[CONTROL_WORD_SIZE];
+    struct control_node *head = NULL, **tail = &head;
+
+    while(p->status == CONTROL_COMPLETE)
+    {
+        skip_separators(p);
+        if(p->text[p->pos] == '\0')
+        {
+            if(ends != NULL)
+                fail(p, CONTROL_INCOMPLETE, "Missing", ends[0]);
+            break;
+        }
+
+        peek_word(p, word);
+        if(ends != NULL && is_one_of(word, ends))
+            break;
+
+        *tail = parse_and_or(p);
+        if(*tail != NULL)
+            tail = &(*tail)->next;
+        if(p->status != CONTROL_COMPLETE)
+            break;
+
+        // fi, done or a command must be followed by a separator
+        skip_blanks(p);
+        char c = p->text[p->pos];
+        if(c != '\0' && c != '\n' && c != ';')
+        {
+            peek_word(p, word);
+            if(word[0] == '\0')
+            {
+                word[0] = c;
+                word[1] = '\0';
+            }
+            fail(p, CONTROL_ERROR, "Unexpected", word);
+        }
+    }
+    return head;
+} // struct control_node* parse_list(struct parser*, const char**)
+
+/*
+ * Parse text once into a tree, expansions are left to the runner so
+ * a loop body is not parsed again on every iteration. Returns
+ * CONTROL_INCOMPLETE when text ends inside a construct.
+ */
+int control_parse(const char *text, struct control_node **tree)
+{
+    struct parser p;
+
+    p.text = text;
+    p.pos = 0;
+    p.status = CONTROL_COMPLETE;
+    p.heredoc_count = 0;
+    is_waiting = 0;
+
+    *tree = parse_list(&p, NULL);
+    if(p.status == CONTROL_COMPLETE && p.heredoc_count > 0)
+        fail(&p, CONTROL_INCOMPLETE, "Missing here-document end", p.heredocs[0].delimiter);
+    if(p.status != CONTROL_COMPLETE)
+    {
+        control_free(*tree);
+        *tree = NULL;
+    }
+    return p.status;
+} // int control_parse(const char*, struct control_node**)
+
+const char* control_error(void)
+{
+    return error_message;
+} // const char* control_error()
+
+/*
+ * 1 if line belongs to the body of the here-document the last parse
+ * waits for, parsing again with it can't complete the text.
+ */
+int control_heredoc_line(const char *line)
+{
+    size_t len;
+
+    if(!is_waiting)
+        return 0;
+    if(waiting.strip_tabs)
+    {
+        while(*line == '\t')
+            ++line;
+    }
+    len = strcspn(line, "\n");
+    return len != strlen(waiting.delimiter) || strncmp(line, waiting.delimiter, len) != 0;
+} // int control_heredoc_line(const char*)
+
+void control_free(struct control_node *tree)
+{
+    while(tree != NULL)
+    {
+        struct control_node *next = tree->next;
+        control_free(tree->first);
+        control_free(tree->second);
+        control_free(tree->other);
+        free(tree->text);
+        free(tree->name);
+        free(tree->body);
+        free(tree);
+        tree = next;
+    }
+} // control_free(struct control_node*)
+
+// Deep copy of a tree, NULL if out of memory
+struct control_node* control_copy(const struct control_node *tree)
+{
+    struct control_node *head = NULL, **tail = &head;
+
+    for(; tree != NULL; tree = tree->next)
+    {
+        struct control_node *node = calloc(1, sizeof(struct control_node));
+        if(node == NULL)
+            break;
+        *tail = node;
+        tail = &node->next;
+
+        node->type = tree->type;
+        node->literal = tree->literal;
+        if((tree->text != NULL && (node->text = strdup(tree->text)) == NULL)
+           || (tree->name != NULL && (node->name = strdup(tree->name)) == NULL)
+           || (tree->body != NULL && (node->body = strdup(tree->body)) == NULL)
+           || (tree->first != NULL && (node->first = control_copy(tree->first)) == NULL)
+           || (tree->second != NULL && (node->second = control_copy(tree->second)) == NULL)
+           || (tree->other != NULL && (node->other = control_copy(tree->other)) == NULL))
+            break;
+    }
+    if(tree != NULL)
+    {
+        control_free(head);
+        return NULL;
+    }
+    return head;
+} // struct control_node* control_copy(const struct control_node*)
+
+/*
+ * ############################################################
+ * #######   EVALUATION
+ * ############################################################
+ */
+
+static volatile sig_atomic_t interrupted = 0;
+static control_runner runner = NULL;
+static int loop_depth = 0;
+static int breaking = 0;        /* loops left by break */
+static int continuing = 0;      /* loops left by continue, the last goes on */
+static int call_depth = 0;
+static int returning = 0;       /* return ran, the call stops */
+static int return_status = 0;
+
+static int run_list(struct control_node *node, int tail);
+
+static int stopped(void)
+{
+    return interrupted || breaking || continuing || returning;
+} // int stopped()
+
+// After a body, 1 if the loop ends. A continue of this loop is consumed.
+static int leave_loop(void)
+{
+    if(interrupted || returning)
+        return 1;
+    if(breaking)
+    {
+        --breaking;
+        return 1;
+    }
+    if(continuing)
+        return --continuing > 0;
+    return 0;
+} // int leave_loop()
+
+/*
+ * break [n], continue [n] and return [n], returns 0 if text is another
+ * command. The return status is expanded, it is often $?.
+ */
+static int jump(const char *text, int *status)
+{
+    char expanded[CONTROL_WORD_SIZE];
+    int *counter;
+    const char *c;
+    char *end;
+    long count = 1;
+
+    if(strncmp(text, "break", 5) == 0)
+    {
+        counter = &breaking;
+        c = text + 5;
+    }
+    else if(strncmp(text, "continue", 8) == 0)
+    {
+        counter = &continuing;
+        c = text + 8;
+    }
+    else if(strncmp(text, "return", 6) == 0)
+    {
+        counter = &returning;
+        c = text + 6;
+    }
+    else
+        return 0;
+    if(*c != '\0' && !isspace((unsigned char)*c))
+        return 0;
+
+    while(isspace((unsigned char)*c))
+        ++c;
+    if(vars_expand(c, expanded, sizeof(expanded)) == -1)
+    {
+        *status = 1;
+        return 1;
+    }
+
+    if(counter == &returning)
+    {
+        if(call_depth == 0)
+        {
+            ERROR("return", "not in a function");
+            *status = 1;
+            return 1;
+        }
+        return_status = expanded[0] != '\0' ? (int)strtol(expanded, NULL, 10) & 0xff : (int)vars_get_int("?");
+        returning = 1;
+        *status = return_status;
+        return 1;
+    }
+
+    if(expanded[0] != '\0')
+    {
+        count = strtol(expanded, &end, 10);
+        while(isspace((unsigned char)*end))
+            ++end;
+        if(count < 1 || *end != '\0')
+        {
+            ERROR("Loop count out of range", text);
+            *status = 1;
+            return 1;
+        }
+    }
+
+    // Out of a loop it does nothing
+    if(count > loop_depth)
+        count = loop_depth;
+    *counter = count;
+    *status = 0;
+    return 1;
+} // int jump(const char*, int*)
+
+static int run_iteration(struct control_node *node, const char *word, int *status)
+{
+    // Stat cache of test lives one iteration
+    condition_new_line();
+    vars_set(node->name, word);
+    *status = run_list(node->second, 0);
+    return leave_loop();
+} // int run_iteration(struct control_node*, const char*, int*)
+
+// The words are expanded once when the loop starts, patterns are globbed
+static int run_for(struct control_node *node)
+{
+    char words[BUFSIZ];
+    char *saved_ptr = NULL, *word;
+    int status = 0, done = 0;
+
+    if(vars_expand(node->text != NULL ? node->text : "$@", words, sizeof(words)) == -1)
+        return 1;
+
+    ++loop_depth;
+    for(word = strtok_r(words, " \t\r\n", &saved_ptr); word != NULL && !done;
+        word = strtok_r(NULL, " \t\r\n", &saved_ptr))
+    {
+        glob_t matches;
+        struct walk_result tree;
+        if(strstr(word, "**") != NULL
+           && walk_glob(dirs_fd(), word, vars_get(WALK_PRUNE_VAR), (int)vars_get_int(WALK_THREADS_VAR), &tree) == 0
+           && tree.count > 0)
+        {
+            size_t i;
+            for(i = 0; i < tree.count && !done; ++i)
+                done = run_iteration(node, tree.paths[i], &status);
+            walk_free(&tree);
+        }
+        else if(strpbrk(word, "*?[") != NULL && dirs_glob(word, 0, &matches) == 0)
+        {
+            size_t i;
+            for(i = 0; i < matches.gl_pathc && !done; ++i)
+                done = run_iteration(node, matches.gl_pathv[i], &status);
+            globfree(&matches);
+        }
+        else
+            done = run_iteration(node, word, &status);
+    }
+    --loop_depth;
+    return status;
+} // int run_for(struct control_node*)
+
+static int run_loop(struct control_node *node)
+{
+    int status = 0;
+
+    ++loop_depth;
+    for(;;)
+    {
+        condition_new_line();
+        int test = run_list(node->first, 0);
+        if(leave_loop() || (test == 0) != (node->type == CONTROL_WHILE))
+            break;
+        status = run_list(node->second, 0);
+        if(leave_loop())
+            break;
+    }
+    --loop_depth;
+    return status;
+} // int run_loop(struct control_node*)
+
+// tail : nothing runs after node, its last command may replace the shell
+static int run_node(struct control_node *node, int tail)
+{
+    int status = 0;
+
+    switch(node->type)
+    {
+        case CONTROL_SIMPLE:
+            if(!jump(node->text, &status))
+                status = runner(node, tail);
+            break;
+        case CONTROL_AND:
+            status = run_node(node->first, 0);
+            if(status == 0 && !stopped())
+                status = run_node(node->second, tail);
+            break;
+        case CONTROL_OR:
+            status = run_node(node->first, 0);
+            if(status != 0 && !stopped())
+                status = run_node(node->second, tail);
+            break;
+        case CONTROL_NOT:
+            status = run_node(node->first, 0) == 0;
+            break;
+        case CONTROL_IF:
+            status = run_list(node->first, 0);
+            if(stopped())
+                break;
+            if(status == 0)
+                status = run_list(node->second, tail);
+            else
+                status = node->other != NULL ? run_list(node->other, tail) : 0;
+            break;
+        case CONTROL_WHILE:
+        case CONTROL_UNTIL:
+            status = run_loop(node);
+            break;
+        case CONTROL_FOR:
+            status = run_for(node);
+            break;
+        case CONTROL_GROUP:
+            status = run_list(node->first, tail);
+            break;
+        case CONTROL_FUNCTION:
+            status = function_define(node->name, node->first) == -1;
+            break;
+    }
+    // $? is seen by the next command, even inside an && list
+    vars_set_int("?", status);
+    return status;
+} // int run_node(struct control_node*)
+
+static int run_list(struct control_node *node, int tail)
+{
+    int status = 0;
+
+    for(; node != NULL && !stopped(); node = node->next)
+        status = run_node(node, tail && node->next == NULL);
+    return status;
+} // int run_list(struct control_node*)
+
+/*
+ * Returns the status of the last command run. tail is 1 when nothing
+ * runs after tree, the runner is told when a command is the last one.
+ */
+int control_run(struct control_node *tree, control_runner run, int tail)
+{
+    int status;
+
+    runner = run;
+    condition_new_line();
+    status = run_list(tree, tail);
+
+    // break out of any loop is dropped with the line
+    if(loop_depth == 0)
+    {
+        breaking = 0;
+        continuing = 0;
+    }
+    return status;
+} // int control_run(struct control_node*, control_runner, int)
+
+// Function body, break and continue don't reach the loops of the caller
+int control_call(struct control_node *body, control_runner run)
+{
+    int saved_depth = loop_depth;
+    int status;
+
+    loop_depth = 0;
+    ++call_depth;
+    runner = run;
+    status = run_list(body, 0);
+    if(returning)
+    {
+        status = return_status;
+        returning = 0;
+    }
+    breaking = 0;
+    continuing = 0;
+    --call_depth;
+    loop_depth = saved_depth;
+    return status;
+} // int control_call(struct control_node*, control_runner)
+
+// Async-signal-safe, stops the loops at the next command
+void control_interrupt(void)
+{
+    interrupted = 1;
+} // control_interrupt()
+
+int control_take_interrupt(void)
+{
+    int was_interrupted = interrupted;
+
+    interrupted = 0;
+    return was_interrupted;
+} // int control_take_interrupt()
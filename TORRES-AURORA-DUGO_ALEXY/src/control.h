@@ -0,0 +1,60 @@
+#ifndef DEF_CONTROL_H
+#define DEF_CONTROL_H
+
+// Results of control_parse
+#define CONTROL_COMPLETE    0
+#define CONTROL_INCOMPLETE  1   /* an open construct waits for more lines */
+#define CONTROL_ERROR       2
+
+// Node types
+#define CONTROL_SIMPLE  0       /* pipeline text, expanded when run */
+#define CONTROL_AND     1
+#define CONTROL_OR      2
+#define CONTROL_NOT     3
+#define CONTROL_IF      4
+#define CONTROL_WHILE   5
+#define CONTROL_UNTIL   6
+#define CONTROL_FOR     7
+#define CONTROL_GROUP   8       /* { list; } */
+#define CONTROL_FUNCTION 9      /* name() { list; }, defined when run */
+
+// Longest keyword, for variable name or here-document delimiter
+#define CONTROL_WORD_SIZE 256
+
+// Here-documents started on a single line
+#define CONTROL_HEREDOC_MAX 16
+
+/*
+ * ############################################################
+ * #######   CONTROL FLOW
+ * ############################################################
+ */
+
+// Commands of a list are chained by next
+struct control_node {
+    int type;
+    char *text;                 /* simple command or for words, not expanded */
+    char *name;                 /* for variable or function name */
+    char *body;                 /* here-document of a simple command */
+    int literal;                /* quoted delimiter, body not expanded */
+    struct control_node *first; /* condition or left operand */
+    struct control_node *second;/* body or right operand */
+    struct control_node *other; /* else or elif branch */
+    struct control_node *next;
+}; // struct control_node
+
+// Runs one simple command and returns its exit status, tail is 1 for
+// the last command before the shell exits
+typedef int (*control_runner)(const struct control_node *node, int tail);
+
+int control_parse(const char *text, struct control_node **tree);
+const char* control_error(void);
+int control_heredoc_line(const char *line);
+void control_free(struct control_node *tree);
+struct control_node* control_copy(const struct control_node *tree);
+int control_run(struct control_node *tree, control_runner run, int tail);
+int control_call(struct control_node *body, control_runner run);
+void control_interrupt(void);
+int control_take_interrupt(void);
+
+#endif // DEF_CONTROL_H
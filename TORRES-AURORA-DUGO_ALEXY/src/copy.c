@@ -0,0 +1,159 @@
+// Needed for copy_file_range and splice
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// HEADER
+#include "copy.h"
+
+/*
+ * ############################################################
+ * #######   HELPERS
+ * ############################################################
+ */
+
+static const char *method_names[] = {"copy_file_range", "sendfile", "splice", "read/write"};
+
+// Errors meaning "this method can't do it", not "the copy failed"
+static int can_fall_back(int error)
+{
+    return error == EINVAL || error == EXDEV || error == ENOSYS || error == EBADF
+           || error == EOPNOTSUPP || error == ENOTSUP || error == EPERM;
+} // int can_fall_back(int)
+
+static ssize_t read_write(int in, int out, size_t max)
+{
+    static char *buffer = NULL;
+
+    if(buffer == NULL)
+    {
+        buffer = malloc(COPY_BUFFER_SIZE);
+        if(buffer == NULL)
+            return -1;
+    }
+
+    ssize_t len = read(in, buffer, max < COPY_BUFFER_SIZE ? max : COPY_BUFFER_SIZE);
+    if(len <= 0)
+        return len;
+
+    ssize_t done = 0;
+    while(done < len)
+    {
+        ssize_t ret = write(out, buffer + done, len - done);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            // Data was consumed from in, it's a real failure
+            if(can_fall_back(errno))
+                errno = EIO;
+            return -1;
+        }
+        done += ret;
+    }
+    return len;
+} // ssize_t read_write(int, int, size_t)
+
+/*
+ * ############################################################
+ * #######   COPY OFFLOAD
+ * ############################################################
+ */
+
+/*
+ * Copy in to out until end of file, or len bytes if len isn't -1, using
+ * file offsets so the methods can be switched in the middle of a copy.
+ * Tries copy_file_range, then sendfile, then splice and finally a
+ * read/write loop.
+ * Returns the number of bytes copied or -1, method gets the last one used.
+ * A signal handler without SA_RESTART stops it with -1 and EINTR, the
+ * bytes copied so far stay copied.
+ */
+long long copy_fd_len(int in, int out, long long len, int *method)
+{
+    struct stat in_stat, out_stat;
+    long long total = 0;
+    int current = COPY_RANGE;
+
+    if(fstat(in, &in_stat) == -1 || fstat(out, &out_stat) == -1)
+        return -1;
+
+    // Skip methods that can't work with these file types
+    if(!S_ISREG(in_stat.st_mode) || !S_ISREG(out_stat.st_mode))
+        current = COPY_SENDFILE;
+    if(current == COPY_SENDFILE && !S_ISREG(in_stat.st_mode))
+        current = COPY_SPLICE;
+    if(current == COPY_SPLICE && !S_ISFIFO(in_stat.st_mode) && !S_ISFIFO(out_stat.st_mode))
+        current = COPY_READWRITE;
+
+    while(len == -1 || total < len)
+    {
+        size_t chunk = COPY_CHUNK_SIZE;
+        ssize_t ret;
+        if(len != -1 && (long long)chunk > len - total)
+            chunk = len - total;
+        switch(current)
+        {
+            case COPY_RANGE:
+                ret = copy_file_range(in, NULL, out, NULL, chunk, 0);
+                break;
+            case COPY_SENDFILE:
+                ret = sendfile(out, in, NULL, chunk);
+                break;
+            case COPY_SPLICE:
+                ret = splice(in, NULL, out, NULL, chunk < COPY_BUFFER_SIZE ? chunk : COPY_BUFFER_SIZE,
+                             SPLICE_F_MOVE | SPLICE_F_MORE);
+                break;
+            default:
+                ret = read_write(in, out, chunk);
+                break;
+        }
+
+        if(ret > 0)
+        {
+            total += ret;
+            continue;
+        }
+        if(ret == 0)
+            break;
+        // SIGCHLD restarts the calls, the signal is for the caller
+        if(errno == EINTR)
+            return -1;
+        if(current < COPY_READWRITE && can_fall_back(errno))
+        {
+            ++current;
+            // splice needs a pipe on one side
+            if(current == COPY_SPLICE && !S_ISFIFO(in_stat.st_mode) && !S_ISFIFO(out_stat.st_mode))
+                current = COPY_READWRITE;
+            continue;
+        }
+        return -1;
+    }
+
+    if(method != NULL)
+        *method = current;
+    return total;
+} // long long copy_fd_len(int, int, long long, int*)
+
+long long copy_fd(int in, int out, int *method)
+{
+    return copy_fd_len(in, out, -1, method);
+} // long long copy_fd(int, int, int*)
+
+const char* copy_method_name(int method)
+{
+    if(method < COPY_RANGE || method > COPY_READWRITE)
+        return "unknown";
+    return method_names[method];
+} // const char* copy_method_name(int)
@@ -0,0 +1,26 @@
+#ifndef DEF_COPY_H
+#define DEF_COPY_H
+
+// Buffer size of the read/write fallback and splice chunk size
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+// Chunk size for copy_file_range and sendfile
+#define COPY_CHUNK_SIZE (1024 * 1024 * 1024)
+
+// Copy methods, in the order they are tried
+#define COPY_RANGE      0
+#define COPY_SENDFILE   1
+#define COPY_SPLICE     2
+#define COPY_READWRITE  3
+
+/*
+ * ############################################################
+ * #######   COPY OFFLOAD
+ * ############################################################
+ */
+
+long long copy_fd(int in, int out, int *method);
+long long copy_fd_len(int in, int out, long long len, int *method);
+const char* copy_method_name(int method);
+
+#endif // DEF_COPY_H
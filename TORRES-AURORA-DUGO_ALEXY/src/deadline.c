@@ -0,0 +1,177 @@
+// Needed for syscall
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/timerfd.h>
+#include <sys/syscall.h>
+#include <sys/prctl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+
+// HEADER
+#include "deadline.h"
+#include "event.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   HELPERS
+ * ############################################################
+ */
+
+struct deadline {
+    int ended;                  /* the pidfd became readable */
+    int expired;                /* timer expirations */
+}; // struct deadline
+
+static void process_ended(int fd, short revents, void *data)
+{
+    ((struct deadline*)data)->ended = 1;
+    event_remove(fd);
+} // process_ended(int, short, void*)
+
+static void timer_expired(int fd, short revents, void *data)
+{
+    uint64_t count;
+
+    if(read(fd, &count, sizeof(count)) == sizeof(count))
+        ++((struct deadline*)data)->expired;
+} // timer_expired(int, short, void*)
+
+static int arm(int timer, long long ms)
+{
+    struct itimerspec spec;
+
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = ms / 1000;
+    spec.it_value.tv_nsec = (ms % 1000) * 1000000;
+    return timerfd_settime(timer, 0, &spec, NULL);
+} // int arm(int, long long)
+
+/*
+ * ############################################################
+ * #######   DEADLINES
+ * ############################################################
+ */
+
+/*
+ * Milliseconds of a duration : a number, maybe decimal, of seconds or
+ * followed by ms, s, m or h. -1 when text is not a duration.
+ */
+long long deadline_parse(const char *text)
+{
+    char *end;
+    double value;
+
+    if(text == NULL || *text == '\0' || *text == '-')
+        return -1;
+    value = strtod(text, &end);
+    if(end == text)
+        return -1;
+    if(strcmp(end, "ms") == 0)
+        return (long long)value;
+    if(*end == '\0' || strcmp(end, "s") == 0)
+        return (long long)(value * 1000);
+    if(strcmp(end, "m") == 0)
+        return (long long)(value * 60 * 1000);
+    if(strcmp(end, "h") == 0)
+        return (long long)(value * 3600 * 1000);
+    return -1;
+} // long long deadline_parse(const char*)
+
+/*
+ * Waits for pid, which the caller keeps away from child_action, while
+ * running the event loop. After limit ms its process group gets
+ * SIGTERM, then SIGKILL after grace ms. Returns 1 when the deadline
+ * hit, 0 when pid ended first and -1 without pidfd or timerfd, the
+ * caller then waits on its own.
+ */
+int deadline_wait(pid_t pid, pid_t group, long long limit, long long grace, int *status)
+{
+    struct deadline deadline = {0, 0};
+    int pidfd, timer;
+
+    pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if(pidfd == -1)
+        return -1;
+    timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if(timer == -1 || arm(timer, limit) == -1)
+    {
+        if(timer != -1)
+            close(timer);
+        close(pidfd);
+        return -1;
+    }
+    if(event_add(pidfd, POLLIN, process_ended, &deadline) == -1)
+    {
+        close(timer);
+        close(pidfd);
+        return -1;
+    }
+    event_add(timer, POLLIN, timer_expired, &deadline);
+
+    // Orphans of the group come to the shell, child_action reaps them
+    // instead of an init which may take its time
+    int subreaper = 0;
+    prctl(PR_GET_CHILD_SUBREAPER, &subreaper);
+    prctl(PR_SET_CHILD_SUBREAPER, 1);
+
+    // A zombie keeps its pidfd readable, the status is still there
+    int signaled = 0;
+    while(!deadline.ended)
+    {
+        if(deadline.expired > signaled)
+        {
+            signaled = deadline.expired;
+            kill(-group, signaled == 1 ? SIGTERM : SIGKILL);
+            if(signaled == 1)
+                arm(timer, grace > 0 ? grace : 1);
+        }
+        if(event_poll(-1) == -1)
+            break;
+    }
+    event_remove(pidfd);
+    close(pidfd);
+
+    int ret = signaled > 0;
+    while(waitpid(pid, status, 0) == -1)
+    {
+        if(errno != EINTR)
+        {
+            ret = -1;
+            break;
+        }
+    }
+
+    // Processes of the group ignoring SIGTERM may outlive pid, they
+    // get the rest of the grace time. Those dead already were handed
+    // to the shell, a zombie would still answer kill
+    int reaped;
+    while(signaled == 1 && deadline.expired == 1)
+    {
+        while(waitpid(-group, &reaped, WNOHANG) > 0);
+        if(kill(-group, 0) == -1)
+            break;
+        if(event_poll(DEADLINE_POLL_MS) == -1)
+            break;
+    }
+    if(signaled == 1 && kill(-group, 0) == 0)
+    {
+        kill(-group, SIGKILL);
+        while(waitpid(-group, &reaped, 0) > 0 || errno == EINTR);
+    }
+    event_remove(timer);
+    close(timer);
+    prctl(PR_SET_CHILD_SUBREAPER, subreaper);
+    return ret;
+} // int deadline_wait(pid_t, pid_t, long long, long long, int*)
@@ -0,0 +1,32 @@
+#ifndef DEF_DEADLINE_H
+#define DEF_DEADLINE_H
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+
+/*
+ * Shell variables : deadline of every front command and the time a
+ * command gets between SIGTERM and SIGKILL, durations like timeout.
+ */
+#define DEADLINE_VAR       "ASR2_TIMEOUT"
+#define DEADLINE_GRACE_VAR "ASR2_TIMEOUT_GRACE"
+
+// Default time between SIGTERM and SIGKILL
+#define DEADLINE_GRACE_MS 2000
+
+// Check of the group left behind by a command ended on SIGTERM
+#define DEADLINE_POLL_MS 10
+
+// Status of a command stopped by its deadline, the one of timeout(1)
+#define DEADLINE_STATUS 124
+
+/*
+ * ############################################################
+ * #######   DEADLINES
+ * ############################################################
+ */
+
+long long deadline_parse(const char *text);
+int deadline_wait(pid_t pid, pid_t group, long long limit, long long grace, int *status);
+
+#endif // DEF_DEADLINE_H
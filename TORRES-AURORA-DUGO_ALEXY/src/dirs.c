@@ -0,0 +1,368 @@
+// Needed for O_PATH and GLOB_ALTDIRFUNC
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+
+// HEADER
+#include "dirs.h"
+#include "vars.h"
+
+/*
+ * ############################################################
+ * #######   WORKING DIRECTORY
+ * ############################################################
+ */
+
+// Logical working directory, symbolic links are kept like in sh
+static char pwd[PATH_MAX];
+
+static struct dirs_entry cache[DIRS_CACHE_SIZE];
+static int current = -1;        /* entry of the working directory */
+static unsigned long tick = 0;
+
+static struct dirs_stacked *stack = NULL;
+
+/*
+ * Absolute path of path from base in one pass, . and .. are removed
+ * as the components come. A .. goes back over the last component only,
+ * so each character is copied and removed once at most.
+ */
+static int resolve(const char *base, const char *path, char *out)
+{
+    size_t len = 0;
+
+    if(path[0] != '/')
+    {
+        len = strlen(base);
+        if(len >= PATH_MAX)
+            return -1;
+        memcpy(out, base, len);
+    }
+    while(len > 0 && out[len - 1] == '/')
+        --len;
+
+    while(*path != '\0')
+    {
+        while(*path == '/')
+            ++path;
+        size_t n = strcspn(path, "/");
+        if(n == 0)
+            break;
+        if(n == 2 && path[0] == '.' && path[1] == '.')
+        {
+            while(len > 0 && out[--len] != '/');
+        }
+        else if(n != 1 || path[0] != '.')
+        {
+            if(len + 1 + n >= PATH_MAX)
+                return -1;
+            out[len++] = '/';
+            memcpy(out + len, path, n);
+            len += n;
+        }
+        path += n;
+    }
+    if(len == 0)
+        out[len++] = '/';
+    out[len] = '\0';
+    return 0;
+} // int resolve(const char*, const char*, char*)
+
+static void drop(int slot)
+{
+    close(cache[slot].fd);
+    free(cache[slot].path);
+    cache[slot].fd = -1;
+    cache[slot].path = NULL;
+    if(current == slot)
+        current = -1;
+} // drop(int)
+
+// Cached entry of path if it is still the same directory, -1 otherwise
+static int find_cached(const char *path)
+{
+    struct stat st;
+    int i;
+
+    for(i = 0; i < DIRS_CACHE_SIZE; ++i)
+    {
+        if(cache[i].fd == -1 || strcmp(cache[i].path, path) != 0)
+            continue;
+        // A directory removed or replaced since is opened again
+        if(stat(path, &st) == 0 && st.st_dev == cache[i].dev && st.st_ino == cache[i].ino)
+        {
+            cache[i].used = ++tick;
+            return i;
+        }
+        drop(i);
+        return -1;
+    }
+    return -1;
+} // int find_cached(const char*)
+
+// Keeps fd open for path, in a free entry or the least recently used
+static int insert(const char *path, int fd)
+{
+    struct stat st;
+    int i, slot = 0;
+
+    for(i = 0; i < DIRS_CACHE_SIZE; ++i)
+    {
+        if(cache[i].fd == -1)
+        {
+            slot = i;
+            break;
+        }
+        if(cache[i].used < cache[slot].used)
+            slot = i;
+    }
+    if(cache[slot].fd != -1)
+        drop(slot);
+
+    char *copy = strdup(path);
+    if(copy == NULL || fstat(fd, &st) == -1)
+    {
+        free(copy);
+        close(fd);
+        return -1;
+    }
+    cache[slot].path = copy;
+    cache[slot].fd = fd;
+    cache[slot].dev = st.st_dev;
+    cache[slot].ino = st.st_ino;
+    cache[slot].used = ++tick;
+    return slot;
+} // int insert(const char*, int)
+
+static void set_pwd(const char *path, int slot)
+{
+    vars_set("OLDPWD", pwd);
+    snprintf(pwd, sizeof(pwd), "%s", path);
+    vars_set("PWD", pwd);
+    current = slot;
+} // set_pwd(const char*, int)
+
+// PWD when it names the working directory, getcwd otherwise
+int dirs_init(void)
+{
+    const char *env = getenv("PWD");
+    struct stat env_stat, dot_stat;
+    int i;
+
+    for(i = 0; i < DIRS_CACHE_SIZE; ++i)
+        cache[i].fd = -1;
+
+    if(env != NULL && env[0] == '/' && strlen(env) < PATH_MAX && stat(env, &env_stat) == 0
+       && stat(".", &dot_stat) == 0 && env_stat.st_dev == dot_stat.st_dev && env_stat.st_ino == dot_stat.st_ino)
+        resolve("/", env, pwd);
+    else if(getcwd(pwd, sizeof(pwd)) == NULL)
+        return -1;
+
+    int fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if(fd != -1)
+        current = insert(pwd, fd);
+    vars_set("PWD", pwd);
+    return 0;
+} // int dirs_init()
+
+const char* dirs_pwd(void)
+{
+    return pwd;
+} // const char* dirs_pwd()
+
+// Descriptor of the working directory for the *at() calls
+int dirs_fd(void)
+{
+    return current != -1 ? cache[current].fd : AT_FDCWD;
+} // int dirs_fd()
+
+/*
+ * cd to path resolved from the logical PWD. A directory of the cache
+ * is entered with fchdir, once its path checked to still lead to it.
+ * When the logical path does not exist the physical one is tried.
+ */
+int dirs_cd(const char *path)
+{
+    char logical[PATH_MAX];
+    int slot, fd;
+
+    if(resolve(pwd, path, logical) == -1)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    slot = find_cached(logical);
+    if(slot != -1)
+    {
+        if(fchdir(cache[slot].fd) == -1)
+            return -1;
+        set_pwd(logical, slot);
+        return 0;
+    }
+
+    fd = open(logical, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1)
+    {
+        if(chdir(path) == -1 || getcwd(logical, sizeof(logical)) == NULL)
+            return -1;
+        fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    }
+    else if(fchdir(fd) == -1)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    set_pwd(logical, fd != -1 ? insert(logical, fd) : -1);
+    return 0;
+} // int dirs_cd(const char*)
+
+/*
+ * ############################################################
+ * #######   GLOBBING
+ * ############################################################
+ */
+
+static void* glob_opendir(const char *path)
+{
+    int fd = openat(dirs_fd(), path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir;
+
+    if(fd == -1)
+        return NULL;
+    dir = fdopendir(fd);
+    if(dir == NULL)
+        close(fd);
+    return dir;
+} // void* glob_opendir(const char*)
+
+static struct dirent* glob_readdir(void *dir)
+{
+    return readdir(dir);
+} // struct dirent* glob_readdir(void*)
+
+static void glob_closedir(void *dir)
+{
+    closedir(dir);
+} // glob_closedir(void*)
+
+static int glob_stat(const char *path, struct stat *st)
+{
+    return fstatat(dirs_fd(), path, st, 0);
+} // int glob_stat(const char*, struct stat*)
+
+static int glob_lstat(const char *path, struct stat *st)
+{
+    return fstatat(dirs_fd(), path, st, AT_SYMLINK_NOFOLLOW);
+} // int glob_lstat(const char*, struct stat*)
+
+// glob with relative paths looked up from the cached directory
+int dirs_glob(const char *pattern, int flags, glob_t *matches)
+{
+    matches->gl_opendir = glob_opendir;
+    matches->gl_readdir = glob_readdir;
+    matches->gl_closedir = glob_closedir;
+    matches->gl_stat = glob_stat;
+    matches->gl_lstat = glob_lstat;
+    return glob(pattern, flags | GLOB_ALTDIRFUNC, NULL, matches);
+} // int dirs_glob(const char*, int, glob_t*)
+
+/*
+ * ############################################################
+ * #######   DIRECTORY STACK
+ * ############################################################
+ */
+
+// pushd path, or swaps the working directory and the top without path
+int dirs_push(const char *path)
+{
+    char *saved = strdup(pwd);
+
+    if(saved == NULL)
+        return -1;
+    if(path == NULL)
+    {
+        if(stack == NULL)
+        {
+            free(saved);
+            errno = ENOENT;
+            return -1;
+        }
+        if(dirs_cd(stack->path) == -1)
+        {
+            free(saved);
+            return -1;
+        }
+        free(stack->path);
+        stack->path = saved;
+        return 0;
+    }
+
+    struct dirs_stacked *entry = malloc(sizeof(struct dirs_stacked));
+    if(entry == NULL || dirs_cd(path) == -1)
+    {
+        int error = errno;
+        free(entry);
+        free(saved);
+        errno = error;
+        return -1;
+    }
+    entry->path = saved;
+    entry->next = stack;
+    stack = entry;
+    return 0;
+} // int dirs_push(const char*)
+
+// cd to the top of the stack and removes it
+int dirs_pop(void)
+{
+    struct dirs_stacked *top = stack;
+
+    if(top == NULL)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    if(dirs_cd(top->path) == -1)
+        return -1;
+    stack = top->next;
+    free(top->path);
+    free(top);
+    return 0;
+} // int dirs_pop()
+
+void dirs_clear(void)
+{
+    while(stack != NULL)
+    {
+        struct dirs_stacked *next = stack->next;
+        free(stack->path);
+        free(stack);
+        stack = next;
+    }
+} // dirs_clear()
+
+// 0 is the working directory, then the stack from its top, NULL past it
+const char* dirs_get(size_t index)
+{
+    struct dirs_stacked *entry = stack;
+
+    if(index == 0)
+        return pwd;
+    for(; entry != NULL && index > 1; --index)
+        entry = entry->next;
+    return entry != NULL ? entry->path : NULL;
+} // const char* dirs_get(size_t)
@@ -0,0 +1,53 @@
+#ifndef DEF_DIRS_H
+#define DEF_DIRS_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <limits.h>
+#include <glob.h>
+
+// Directories kept open to go back to them with fchdir
+#define DIRS_CACHE_SIZE 8
+
+/*
+ * ############################################################
+ * #######   WORKING DIRECTORY
+ * ############################################################
+ */
+
+// Open directory of the cache, the least recently used is closed first
+struct dirs_entry {
+    char *path;                 /* logical path */
+    int fd;                     /* O_PATH descriptor, -1 if free */
+    dev_t dev;
+    ino_t ino;
+    unsigned long used;         /* last use, for the LRU */
+}; // struct dirs_entry
+
+int dirs_init(void);
+const char* dirs_pwd(void);
+int dirs_cd(const char *path);
+int dirs_fd(void);
+int dirs_glob(const char *pattern, int flags, glob_t *matches);
+
+/*
+ * ############################################################
+ * #######   DIRECTORY STACK
+ * ############################################################
+ */
+
+// pushd stack, top first
+struct dirs_stacked {
+    char *path;
+    struct dirs_stacked *next;
+}; // struct dirs_stacked
+
+int dirs_push(const char *path);
+int dirs_pop(void);
+void dirs_clear(void);
+const char* dirs_get(size_t index);
+
+#endif // DEF_DIRS_H
@@ -0,0 +1,516 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <signal.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+
+// HEADER
+#include "editor.h"
+#include "complete.h"
+#include "history.h"
+
+// Control keys
+#define KEY_CTRL(X) ((X) & 0x1f)
+#define KEY_ESC 27
+#define KEY_BACKSPACE 127
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+// Line being edited
+struct line_state {
+    const char *prompt;
+    char *buffer;
+    int size;
+    int len;
+    int pos;
+    long history_index;         /* entry shown, history count for the new line */
+    char *scratch;              /* new line saved while browsing history */
+    int last_tab;               /* previous key was a Tab */
+}; // struct line_state
+
+static struct termios saved_termios;
+static volatile sig_atomic_t reading = 0;
+static volatile sig_atomic_t cancelled = 0;
+
+/*
+ * ############################################################
+ * #######   TERMINAL
+ * ############################################################
+ */
+
+// No echo, no line buffering, signals still generated by the terminal
+static int enable_raw(void)
+{
+    struct termios raw;
+
+    if(tcgetattr(STDIN_FILENO, &saved_termios) == -1)
+        return -1;
+
+    raw = saved_termios;
+    raw.c_iflag &= ~(ICRNL | IXON);
+    raw.c_lflag &= ~(ICANON | ECHO | IEXTEN);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    return tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+} // int enable_raw()
+
+static void disable_raw(void)
+{
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &saved_termios);
+} // disable_raw()
+
+static void write_all(const char *buffer, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t ret = write(STDOUT_FILENO, buffer, len);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            return;
+        }
+        buffer += ret;
+        len -= ret;
+    }
+} // write_all(const char*, size_t)
+
+static int terminal_columns(void)
+{
+    struct winsize size;
+
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == -1 || size.ws_col == 0)
+        return 80;
+    return size.ws_col;
+} // int terminal_columns()
+
+// Redraw the whole line in a single write
+static void refresh(struct line_state *state)
+{
+    char output[EDITOR_OUTPUT_SIZE];
+
+    int len = snprintf(output, sizeof(output), "\r%s%.*s\033[K", state->prompt, state->len, state->buffer);
+    if(len < (int)sizeof(output) && state->pos < state->len)
+        len += snprintf(output + len, sizeof(output) - len, "\033[%dD", state->len - state->pos);
+    if(len >= (int)sizeof(output))
+        len = sizeof(output) - 1;
+    write_all(output, len);
+} // refresh(struct line_state*)
+
+static void bell(void)
+{
+    write_all("\a", 1);
+} // bell()
+
+static int read_key(void)
+{
+    unsigned char c;
+
+    for(;;)
+    {
+        ssize_t ret = read(STDIN_FILENO, &c, 1);
+        if(ret == 1)
+            return c;
+        if(ret == 0)
+            return -1;
+        if(errno != EINTR)
+            return -1;
+        // Ctrl-C, the caller drops the line
+        if(cancelled)
+            return KEY_CTRL('c');
+    }
+} // int read_key()
+
+/*
+ * ############################################################
+ * #######   EDITING
+ * ############################################################
+ */
+
+static void set_line(struct line_state *state, const char *text)
+{
+    snprintf(state->buffer, state->size, "%s", text);
+    state->len = strlen(state->buffer);
+    state->pos = state->len;
+} // set_line(struct line_state*, const char*)
+
+static void insert(struct line_state *state, const char *text, int count)
+{
+    if(state->len + count >= state->size)
+    {
+        bell();
+        return;
+    }
+    memmove(state->buffer + state->pos + count, state->buffer + state->pos, state->len - state->pos);
+    memcpy(state->buffer + state->pos, text, count);
+    state->len += count;
+    state->pos += count;
+} // insert(struct line_state*, const char*, int)
+
+// Remove count bytes before pos
+static void erase(struct line_state *state, int count)
+{
+    if(count > state->pos)
+        count = state->pos;
+    memmove(state->buffer + state->pos - count, state->buffer + state->pos, state->len - state->pos);
+    state->len -= count;
+    state->pos -= count;
+} // erase(struct line_state*, int)
+
+static void history_move(struct line_state *state, int direction)
+{
+    long count = history_count();
+    long index = state->history_index + direction;
+
+    if(index < 0 || index > count)
+    {
+        bell();
+        return;
+    }
+
+    // Keep the line being typed when leaving it
+    if(state->history_index == count)
+    {
+        free(state->scratch);
+        state->buffer[state->len] = '\0';
+        state->scratch = strdup(state->buffer);
+    }
+
+    state->history_index = index;
+    if(index == count)
+        set_line(state, state->scratch ? state->scratch : "");
+    else
+        set_line(state, history_get(index));
+} // history_move(struct line_state*, int)
+
+static void list_candidates(struct line_state *state, struct completion *result)
+{
+    int columns = terminal_columns();
+    int width = 0, i, column = 0;
+
+    for(i = 0; i < result->count; ++i)
+    {
+        int len = strlen(result->words[i]);
+        if(len > width)
+            width = len;
+    }
+    width += 2;
+    int per_line = columns / width > 0 ? columns / width : 1;
+
+    write_all("\r\n", 2);
+    for(i = 0; i < result->count; ++i)
+    {
+        char cell[PATH_MAX + 8];
+        int len = snprintf(cell, sizeof(cell), "%-*s", width, result->words[i]);
+        if(len >= (int)sizeof(cell))
+            len = sizeof(cell) - 1;
+        write_all(cell, len);
+        if(++column == per_line)
+        {
+            write_all("\r\n", 2);
+            column = 0;
+        }
+    }
+    if(column != 0)
+        write_all("\r\n", 2);
+    if(result->total > result->count)
+    {
+        char more[64];
+        int len = snprintf(more, sizeof(more), "... %d more\r\n", result->total - result->count);
+        write_all(more, len);
+    }
+    refresh(state);
+} // list_candidates(struct line_state*, struct completion*)
+
+static void complete(struct line_state *state)
+{
+    struct completion result;
+
+    state->buffer[state->len] = '\0';
+    if(complete_line(state->buffer, state->pos, &result) == 0)
+    {
+        bell();
+        complete_free(&result);
+        return;
+    }
+
+    int word_len = state->pos - result.start;
+    int prefix_len = result.prefix ? strlen(result.prefix) : 0;
+
+    if(prefix_len > word_len)
+    {
+        insert(state, result.prefix + word_len, prefix_len - word_len);
+        // A single file or command is finished, a directory goes on
+        if(result.total == 1 && !(result.count == 1 && result.is_dir[0]))
+            insert(state, " ", 1);
+        refresh(state);
+    }
+    else if(result.total == 1)
+    {
+        insert(state, " ", 1);
+        refresh(state);
+    }
+    else if(state->last_tab)
+        list_candidates(state, &result);
+    else
+        bell();
+
+    complete_free(&result);
+} // complete(struct line_state*)
+
+/*
+ * Ctrl-R : each key refines the query, Ctrl-R again goes to an older
+ * match. Enter runs the match, Ctrl-G or Escape restore the line, any
+ * other key keeps the match and is handled by the editor.
+ */
+static int reverse_search(struct line_state *state)
+{
+    char query[EDITOR_QUERY_SIZE];
+    char output[EDITOR_OUTPUT_SIZE];
+    int query_len = 0;
+    long match = -1;
+    int key;
+
+    query[0] = '\0';
+    state->buffer[state->len] = '\0';
+    char *original = strdup(state->buffer);
+
+    for(;;)
+    {
+        const char *text = match >= 0 ? history_get(match) : "";
+        int len = snprintf(output, sizeof(output), "\r(reverse-i-search)`%s': %s\033[K", query, text);
+        if(len >= (int)sizeof(output))
+            len = sizeof(output) - 1;
+        write_all(output, len);
+
+        key = read_key();
+        if(key == KEY_CTRL('r'))
+        {
+            long older = match > 0 ? history_search(query, match) : -1;
+            if(older == -1)
+                bell();
+            else
+                match = older;
+            continue;
+        }
+        if(key == KEY_BACKSPACE || key == KEY_CTRL('h'))
+        {
+            if(query_len > 0)
+                query[--query_len] = '\0';
+            match = query_len ? history_search(query, -1) : -1;
+            continue;
+        }
+        if(key >= 32 && key < KEY_BACKSPACE && query_len + 1 < EDITOR_QUERY_SIZE)
+        {
+            query[query_len++] = key;
+            query[query_len] = '\0';
+            // The current match may still contain the longer query
+            long found = history_search(query, match >= 0 ? match + 1 : -1);
+            if(found == -1)
+                bell();
+            else
+                match = found;
+            continue;
+        }
+        break;
+    }
+
+    if(key == KEY_CTRL('g') || key == KEY_ESC || key == KEY_CTRL('c'))
+    {
+        set_line(state, original ? original : "");
+        key = key == KEY_CTRL('c') ? key : 0;
+    }
+    else if(match >= 0)
+    {
+        set_line(state, history_get(match));
+        state->history_index = match;
+    }
+    free(original);
+    refresh(state);
+    return key;
+} // int reverse_search(struct line_state*)
+
+/*
+ * ############################################################
+ * #######   LINE EDITOR
+ * ############################################################
+ */
+
+/*
+ * Read a line from the terminal with editing, history and completion.
+ * Returns the line length (without newline) or -1 on end of file.
+ */
+int editor_read_line(const char *prompt, char *line, int size)
+{
+    struct line_state state;
+    int key, done = 0;
+
+    if(enable_raw() == -1)
+        return -1;
+
+    memset(&state, 0, sizeof(state));
+    state.prompt = prompt;
+    state.buffer = line;
+    state.size = size;
+    state.history_index = history_count();
+
+    cancelled = 0;
+    reading = 1;
+    refresh(&state);
+
+    while(!done)
+    {
+        key = read_key();
+        if(key == KEY_CTRL('r'))
+            key = reverse_search(&state);
+
+        int is_tab = key == '\t';
+        switch(key)
+        {
+            case 0:
+                break;
+            case -1:
+                done = -1;
+                break;
+            case '\r':
+            case '\n':
+                done = 1;
+                break;
+            case KEY_CTRL('c'):
+                // Drop the line, a new prompt on the next line
+                cancelled = 0;
+                write_all("^C\r\n", 4);
+                state.len = state.pos = 0;
+                state.history_index = history_count();
+                refresh(&state);
+                break;
+            case KEY_CTRL('d'):
+                if(state.len == 0)
+                    done = -1;
+                else if(state.pos < state.len)
+                {
+                    ++state.pos;
+                    erase(&state, 1);
+                }
+                break;
+            case '\t':
+                complete(&state);
+                break;
+            case KEY_BACKSPACE:
+            case KEY_CTRL('h'):
+                erase(&state, 1);
+                break;
+            case KEY_CTRL('a'):
+                state.pos = 0;
+                break;
+            case KEY_CTRL('e'):
+                state.pos = state.len;
+                break;
+            case KEY_CTRL('b'):
+                if(state.pos > 0)
+                    --state.pos;
+                break;
+            case KEY_CTRL('f'):
+                if(state.pos < state.len)
+                    ++state.pos;
+                break;
+            case KEY_CTRL('k'):
+                state.len = state.pos;
+                break;
+            case KEY_CTRL('u'):
+                erase(&state, state.pos);
+                break;
+            case KEY_CTRL('w'):
+            {
+                int start = state.pos;
+                while(start > 0 && state.buffer[start - 1] == ' ')
+                    --start;
+                while(start > 0 && state.buffer[start - 1] != ' ')
+                    --start;
+                erase(&state, state.pos - start);
+                break;
+            }
+            case KEY_CTRL('l'):
+                write_all("\033[H\033[2J", 7);
+                break;
+            case KEY_CTRL('p'):
+                history_move(&state, -1);
+                break;
+            case KEY_CTRL('n'):
+                history_move(&state, 1);
+                break;
+            case KEY_ESC:
+            {
+                // Arrows, Home, End and Delete sequences
+                int first = read_key();
+                int second = read_key();
+                if(first != '[' && first != 'O')
+                    break;
+                if(second >= '0' && second <= '9')
+                {
+                    if(read_key() == '~' && second == '3' && state.pos < state.len)
+                    {
+                        ++state.pos;
+                        erase(&state, 1);
+                    }
+                    break;
+                }
+                if(second == 'A')
+                    history_move(&state, -1);
+                else if(second == 'B')
+                    history_move(&state, 1);
+                else if(second == 'C' && state.pos < state.len)
+                    ++state.pos;
+                else if(second == 'D' && state.pos > 0)
+                    --state.pos;
+                else if(second == 'H')
+                    state.pos = 0;
+                else if(second == 'F')
+                    state.pos = state.len;
+                break;
+            }
+            default:
+                if(key >= 32)
+                {
+                    char c = key;
+                    insert(&state, &c, 1);
+                }
+                break;
+        }
+        state.last_tab = is_tab;
+        if(!done && !is_tab)
+            refresh(&state);
+    }
+
+    reading = 0;
+    write_all("\r\n", 2);
+    disable_raw();
+    free(state.scratch);
+
+    if(done == -1)
+        return -1;
+    line[state.len] = '\0';
+    return state.len;
+} // int editor_read_line(const char*, char*, int)
+
+// Called by the SIGINT handler, returns 1 if the editor handles it
+int editor_cancel(void)
+{
+    if(!reading)
+        return 0;
+    cancelled = 1;
+    return 1;
+} // int editor_cancel()
@@ -0,0 +1,19 @@
+#ifndef DEF_EDITOR_H
+#define DEF_EDITOR_H
+
+// Max bytes written by one screen refresh
+#define EDITOR_OUTPUT_SIZE 8192
+
+// Max length of a reverse search query
+#define EDITOR_QUERY_SIZE 256
+
+/*
+ * ############################################################
+ * #######   LINE EDITOR
+ * ############################################################
+ */
+
+int editor_read_line(const char *prompt, char *line, int size);
+int editor_cancel(void);
+
+#endif // DEF_EDITOR_H
@@ -0,0 +1,194 @@
+// Needed for pipe2
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+
+// HEADER
+#include "event.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+static struct event_source sources[EVENT_MAX];
+static int source_count = 0;
+
+// Self pipe, written from signal handlers to wake up poll
+static int wakeup_pipe[2] = {-1, -1};
+
+static void drain_wakeup(int fd, short revents, void *data)
+{
+    char buffer[64];
+    while(read(fd, buffer, sizeof(buffer)) > 0);
+} // drain_wakeup(int, short, void*)
+
+/*
+ * ############################################################
+ * #######   EVENT LOOP
+ * ############################################################
+ */
+
+int event_init(void)
+{
+    if(wakeup_pipe[0] != -1)
+        return 0;
+
+    if(pipe2(wakeup_pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+    {
+        ERROR("Can't create event loop wakeup pipe.", strerror(errno));
+        return -1;
+    }
+    return event_add(wakeup_pipe[0], POLLIN, drain_wakeup, NULL);
+} // int event_init()
+
+// Forked child running shell code : its own wakeup pipe, no inherited source
+int event_reset(void)
+{
+    if(wakeup_pipe[0] != -1)
+    {
+        close(wakeup_pipe[0]);
+        close(wakeup_pipe[1]);
+        wakeup_pipe[0] = -1;
+        wakeup_pipe[1] = -1;
+    }
+    source_count = 0;
+    return event_init();
+} // int event_reset()
+
+int event_add(int fd, short events, event_callback callback, void *data)
+{
+    if(source_count == EVENT_MAX)
+    {
+        ERROR("Too many event sources.", "\n");
+        return -1;
+    }
+    sources[source_count].fd = fd;
+    sources[source_count].events = events;
+    sources[source_count].callback = callback;
+    sources[source_count].data = data;
+    ++source_count;
+    return 0;
+} // int event_add(int, short, event_callback, void*)
+
+int event_modify(int fd, short events)
+{
+    int i;
+    for(i = 0; i < source_count; ++i)
+    {
+        if(sources[i].fd == fd)
+        {
+            sources[i].events = events;
+            return 0;
+        }
+    }
+    return -1;
+} // int event_modify(int, short)
+
+void event_remove(int fd)
+{
+    int i;
+    for(i = 0; i < source_count; ++i)
+    {
+        if(sources[i].fd == fd)
+        {
+            sources[i] = sources[--source_count];
+            return;
+        }
+    }
+} // event_remove(int)
+
+/*
+ * Wait for events during at most timeout ms (-1 for ever) and run
+ * the callbacks. Returns the number of ready sources, 0 on timeout
+ * or signal interruption.
+ */
+int event_poll(int timeout)
+{
+    struct pollfd fds[EVENT_MAX];
+    struct event_source ready[EVENT_MAX];
+    int i, count = 0;
+
+    for(i = 0; i < source_count; ++i)
+    {
+        fds[i].fd = sources[i].fd;
+        fds[i].events = sources[i].events;
+        fds[i].revents = 0;
+    }
+
+    int ret = poll(fds, source_count, timeout);
+    if(ret == -1)
+    {
+        if(errno == EINTR)
+            return 0;
+        ERROR("Event loop poll.", strerror(errno));
+        return -1;
+    }
+
+    // Callbacks may add or remove sources, work on a copy
+    for(i = 0; i < source_count; ++i)
+    {
+        if(fds[i].revents)
+        {
+            ready[count] = sources[i];
+            ready[count].events = fds[i].revents;
+            ++count;
+        }
+    }
+    for(i = 0; i < count; ++i)
+    {
+        int j;
+        for(j = 0; j < source_count; ++j)
+        {
+            if(sources[j].fd == ready[i].fd && sources[j].callback == ready[i].callback)
+                break;
+        }
+        if(j < source_count)
+            ready[i].callback(ready[i].fd, ready[i].events, ready[i].data);
+    }
+    return count;
+} // int event_poll(int)
+
+// Async signal safe
+void event_wakeup(void)
+{
+    int saved_errno = errno;
+    if(wakeup_pipe[1] != -1)
+    {
+        if(write(wakeup_pipe[1], "", 1) == -1)
+        {
+            // Pipe full, poll will wake up anyway
+        }
+    }
+    errno = saved_errno;
+} // event_wakeup()
+
+// Wait for a child to end while running the event loop
+pid_t event_wait_pid(pid_t pid, int *status)
+{
+    for(;;)
+    {
+        pid_t ret = waitpid(pid, status, WNOHANG);
+        if(ret == pid && (WIFEXITED(*status) || WIFSIGNALED(*status)))
+            return pid;
+        if(ret == -1 && errno != EINTR)
+            return -1;
+
+        // SIGCHLD wakes us up through the self pipe
+        if(event_poll(-1) == -1)
+            return waitpid(pid, status, 0);
+    }
+} // pid_t event_wait_pid(pid_t, int*)
@@ -0,0 +1,36 @@
+#ifndef DEF_EVENT_H
+#define DEF_EVENT_H
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <poll.h>
+
+// Max file descriptors watched at the same time
+#define EVENT_MAX 64
+
+/*
+ * ############################################################
+ * #######   EVENT LOOP
+ * ############################################################
+ */
+
+// Called with the fd and the poll revents
+typedef void (*event_callback)(int fd, short revents, void *data);
+
+struct event_source {
+    int fd;
+    short events;               /* poll events */
+    event_callback callback;
+    void *data;
+}; // struct event_source
+
+int event_init(void);
+int event_reset(void);
+int event_add(int fd, short events, event_callback callback, void *data);
+int event_modify(int fd, short events);
+void event_remove(int fd);
+int event_poll(int timeout);
+void event_wakeup(void);
+pid_t event_wait_pid(pid_t pid, int *status);
+
+#endif // DEF_EVENT_H
@@ -0,0 +1,362 @@
+// Needed for tee, splice and F_SETPIPE_SZ
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+
+// HEADER
+#include "fanout.h"
+#include "event.h"
+#include "log.h"
+
+static void fanout_pump(int fd, short revents, void *data);
+static void fanout_drain(int fd, short revents, void *data);
+
+/*
+ * ############################################################
+ * #######   HELPERS
+ * ############################################################
+ */
+
+static void drop_pending(struct fanout *fan, int i)
+{
+    if(fan->pending_len[i] > 0)
+    {
+        event_remove(fan->outputs[i]);
+        fan->pending_len[i] = 0;
+        fan->pending_sent[i] = 0;
+        --fan->waiting;
+    }
+} // drop_pending(struct fanout*, int)
+
+static void close_output(struct fanout *fan, int i)
+{
+    if(fan->outputs[i] != -1)
+    {
+        drop_pending(fan, i);
+        close(fan->outputs[i]);
+        fan->outputs[i] = -1;
+    }
+} // close_output(struct fanout*, int)
+
+// Bytes a non blocking fd took before it was full, -1 on error
+static ssize_t write_some(int fd, const char *buffer, size_t len)
+{
+    size_t done = 0;
+
+    while(done < len)
+    {
+        ssize_t ret = write(fd, buffer + done, len - done);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN)
+                break;
+            return -1;
+        }
+        done += ret;
+    }
+    return done;
+} // ssize_t write_some(int, const char*, size_t)
+
+static int read_all(int fd, char *buffer, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t ret = read(fd, buffer, len);
+        if(ret == -1 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return -1;
+        buffer += ret;
+        len -= ret;
+    }
+    return 0;
+} // int read_all(int, char*, size_t)
+
+static void stop(struct fanout *fan)
+{
+    int i;
+
+    if(fan->input != -1)
+    {
+        event_remove(fan->input);
+        close(fan->input);
+        fan->input = -1;
+    }
+    for(i = 0; i < fan->count; ++i)
+        close_output(fan, i);
+    fan->done = 1;
+} // stop(struct fanout*)
+
+// Keeps what consumer i did not take, its pipe is watched until it does
+static int keep_pending(struct fanout *fan, int i, const char *data, size_t len)
+{
+    if(fan->pending[i] == NULL)
+    {
+        fan->pending[i] = malloc(FANOUT_PIPE_SIZE);
+        if(fan->pending[i] == NULL)
+            return -1;
+    }
+    if(event_add(fan->outputs[i], POLLOUT, fanout_drain, fan) == -1)
+        return -1;
+    memcpy(fan->pending[i], data, len);
+    fan->pending_len[i] = len;
+    fan->pending_sent[i] = 0;
+    ++fan->waiting;
+    return 0;
+} // int keep_pending(struct fanout*, int, const char*, size_t)
+
+// Once every consumer took its data, the producer is read again
+static void resume(struct fanout *fan)
+{
+    if(fan->waiting > 0 || fan->done)
+        return;
+    if(fan->input == -1)
+        stop(fan);
+    else if(event_add(fan->input, POLLIN, fanout_pump, fan) == -1)
+        stop(fan);
+} // resume(struct fanout*)
+
+/*
+ * ############################################################
+ * #######   PUMP
+ * ############################################################
+ */
+
+// A consumer pipe with pending data became writable or was closed
+static void fanout_drain(int fd, short revents, void *data)
+{
+    struct fanout *fan = data;
+    int i;
+
+    for(i = 0; i < fan->count && fan->outputs[i] != fd; ++i)
+        ;
+    if(i == fan->count)
+        return;
+
+    if(revents & (POLLERR | POLLHUP | POLLNVAL))
+        close_output(fan, i);
+    else
+    {
+        ssize_t ret = write_some(fd, fan->pending[i] + fan->pending_sent[i],
+                                 fan->pending_len[i] - fan->pending_sent[i]);
+        if(ret == -1)
+            close_output(fan, i);
+        else
+        {
+            fan->pending_sent[i] += ret;
+            if(fan->pending_sent[i] == fan->pending_len[i])
+                drop_pending(fan, i);
+        }
+    }
+    resume(fan);
+} // fanout_drain(int, short, void*)
+
+/*
+ * Every consumer but the last gets a tee(2) of the available data,
+ * the last one gets it moved with splice(2) which consumes it.
+ * If a tee is partial we fall back to one read for that round, a
+ * consumer which can't take its part keeps it pending and the
+ * producer is left alone until every consumer took its data.
+ */
+static void fanout_pump(int fd, short revents, void *data)
+{
+    struct fanout *fan = data;
+    ssize_t copied[FANOUT_MAX];
+    int live[FANOUT_MAX];
+    int live_count = 0, lagging = 0, available = 0, i;
+
+    if(ioctl(fan->input, FIONREAD, &available) == -1 || available <= 0)
+    {
+        // Producer is done, the consumers get what is pending first
+        if(revents & (POLLHUP | POLLERR))
+        {
+            event_remove(fan->input);
+            close(fan->input);
+            fan->input = -1;
+            resume(fan);
+        }
+        return;
+    }
+
+    for(i = 0; i < fan->count; ++i)
+    {
+        if(fan->outputs[i] != -1)
+            live[live_count++] = i;
+    }
+
+    // No consumer left, the producer will get EPIPE
+    if(live_count == 0)
+    {
+        stop(fan);
+        return;
+    }
+
+    size_t len = available;
+    if(len > FANOUT_PIPE_SIZE)
+        len = FANOUT_PIPE_SIZE;
+    int last = live[live_count - 1];
+
+    for(i = 0; i < live_count - 1; ++i)
+    {
+        int out = live[i];
+        ssize_t ret;
+        do
+        {
+            ret = tee(fan->input, fan->outputs[out], len, SPLICE_F_NONBLOCK);
+        } while(ret == -1 && errno == EINTR);
+
+        if(ret == -1 && errno == EAGAIN)
+            ret = 0;
+        if(ret == -1)
+        {
+            // Consumer exited (EPIPE) or not a pipe, forget it
+            close_output(fan, out);
+            copied[out] = len;
+            continue;
+        }
+        copied[out] = ret;
+        if((size_t)ret < len)
+            lagging = 1;
+    }
+
+    if(!lagging)
+    {
+        size_t moved = 0;
+        while(moved < len)
+        {
+            ssize_t ret = splice(fan->input, NULL, fan->outputs[last], NULL, len - moved,
+                                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(ret == -1 && errno == EINTR)
+                continue;
+            if(ret == -1 && errno == EAGAIN)
+                break;
+            if(ret <= 0)
+            {
+                close_output(fan, last);
+                break;
+            }
+            moved += ret;
+        }
+
+        // The others have it all, the last one gets the rest below
+        if(moved < len)
+        {
+            len -= moved;
+            for(i = 0; i < live_count - 1; ++i)
+                copied[live[i]] = len;
+        }
+        else
+        {
+            fan->bytes += len;
+            return;
+        }
+    }
+
+    // Slow path, one copy through user space for this round
+    if(fan->buffer == NULL)
+    {
+        fan->buffer = malloc(FANOUT_PIPE_SIZE);
+        if(fan->buffer == NULL)
+        {
+            ERROR("Fan-out buffer allocation.", strerror(errno));
+            stop(fan);
+            return;
+        }
+    }
+    if(read_all(fan->input, fan->buffer, len) == -1)
+    {
+        stop(fan);
+        return;
+    }
+    for(i = 0; i < live_count; ++i)
+    {
+        int out = live[i];
+        size_t skip = (out == last) ? 0 : (size_t)copied[out];
+        if(fan->outputs[out] == -1 || skip >= len)
+            continue;
+        ssize_t ret = write_some(fan->outputs[out], fan->buffer + skip, len - skip);
+        if(ret == -1)
+            close_output(fan, out);
+        else if(skip + ret < len && keep_pending(fan, out, fan->buffer + skip + ret, len - skip - ret) == -1)
+        {
+            ERROR("Fan-out pending data.", strerror(errno));
+            close_output(fan, out);
+        }
+    }
+    fan->bytes += len;
+
+    // A full consumer holds the producer back, the shell does not wait
+    if(fan->waiting > 0)
+        event_remove(fan->input);
+} // fanout_pump(int, short, void*)
+
+/*
+ * ############################################################
+ * #######   FAN-OUT
+ * ############################################################
+ */
+
+int fanout_start(struct fanout *fan, int input, int *outputs, int count)
+{
+    int i;
+
+    fan->input = input;
+    fan->count = 0;
+    fan->done = 0;
+    fan->bytes = 0;
+    fan->buffer = NULL;
+    fan->waiting = 0;
+    for(i = 0; i < FANOUT_MAX; ++i)
+    {
+        fan->pending[i] = NULL;
+        fan->pending_len[i] = 0;
+        fan->pending_sent[i] = 0;
+    }
+
+    if(count < 1 || count > FANOUT_MAX)
+        return -1;
+    fan->count = count;
+
+    // Bigger pipes means less wake ups, failure is harmless
+    fcntl(input, F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+    for(i = 0; i < count; ++i)
+    {
+        fan->outputs[i] = outputs[i];
+        fcntl(outputs[i], F_SETPIPE_SZ, FANOUT_PIPE_SIZE);
+
+        // A slow consumer must not block the event loop
+        int flags = fcntl(outputs[i], F_GETFL);
+        if(flags == -1 || fcntl(outputs[i], F_SETFL, flags | O_NONBLOCK) == -1)
+            return -1;
+    }
+
+    return event_add(input, POLLIN, fanout_pump, fan);
+} // int fanout_start(struct fanout*, int, int*, int)
+
+void fanout_finish(struct fanout *fan)
+{
+    int i;
+
+    if(!fan->done)
+        stop(fan);
+    free(fan->buffer);
+    fan->buffer = NULL;
+    for(i = 0; i < FANOUT_MAX; ++i)
+    {
+        free(fan->pending[i]);
+        fan->pending[i] = NULL;
+    }
+} // fanout_finish(struct fanout*)
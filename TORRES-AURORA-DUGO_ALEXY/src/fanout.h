@@ -0,0 +1,40 @@
+#ifndef DEF_FANOUT_H
+#define DEF_FANOUT_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+// Max consumers of a fan-out
+#define FANOUT_MAX 16
+
+// Pipe size requested for the producer and consumers pipes
+#define FANOUT_PIPE_SIZE (1024 * 1024)
+
+/*
+ * ############################################################
+ * #######   FAN-OUT
+ * ############################################################
+ */
+
+/*
+ * Duplicates a producer pipe into several consumer pipes in kernel.
+ * The consumer pipes are non blocking, what a full one does not take is
+ * kept until it is writable and the producer is not read meanwhile.
+ */
+struct fanout {
+    int input;                      /* producer pipe read end, -1 once drained */
+    int outputs[FANOUT_MAX];        /* consumers pipes write ends, -1 once closed */
+    int count;
+    int done;                       /* set when every consumer got everything */
+    unsigned long long bytes;       /* bytes delivered to each consumer */
+    char *buffer;                   /* used only when tee(2) copies partially */
+    char *pending[FANOUT_MAX];      /* data a full consumer pipe did not take */
+    size_t pending_len[FANOUT_MAX];
+    size_t pending_sent[FANOUT_MAX];
+    int waiting;                    /* consumers with pending data */
+}; // struct fanout
+
+int fanout_start(struct fanout *fan, int input, int *outputs, int count);
+void fanout_finish(struct fanout *fan);
+
+#endif // DEF_FANOUT_H
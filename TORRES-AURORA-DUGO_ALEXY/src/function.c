@@ -0,0 +1,142 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// HEADER
+#include "function.h"
+#include "vars.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   TABLE
+ * ############################################################
+ */
+
+static struct function **table = NULL;
+static size_t bucket_count = 0;
+static size_t function_count = 0;
+
+// Bodies replaced while a call runs, freed when the last call returns
+static struct control_node *retired = NULL;
+static int depth = 0;
+
+static size_t hash_name(const char *name)
+{
+    size_t hash = 2166136261u;
+
+    for(; *name != '\0'; ++name)
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+} // size_t hash_name(const char*)
+
+static int grow(void)
+{
+    size_t count = bucket_count ? bucket_count * 2 : FUNCTION_BUCKETS;
+    struct function **grown = calloc(count, sizeof(struct function*));
+    size_t i;
+
+    if(grown == NULL)
+        return -1;
+    for(i = 0; i < bucket_count; ++i)
+    {
+        while(table[i] != NULL)
+        {
+            struct function *function = table[i];
+            table[i] = function->next;
+            size_t bucket = hash_name(function->name) & (count - 1);
+            function->next = grown[bucket];
+            grown[bucket] = function;
+        }
+    }
+    free(table);
+    table = grown;
+    bucket_count = count;
+    return 0;
+} // int grow()
+
+struct function* function_find(const char *name)
+{
+    struct function *function;
+
+    if(table == NULL)
+        return NULL;
+    for(function = table[hash_name(name) & (bucket_count - 1)]; function != NULL; function = function->next)
+    {
+        if(strcmp(function->name, name) == 0)
+            return function;
+    }
+    return NULL;
+} // struct function* function_find(const char*)
+
+/*
+ * The body is copied, the tree it comes from is freed with its line.
+ * A function may define itself again while it runs, so the old body
+ * is only freed once no call is running.
+ */
+int function_define(const char *name, const struct control_node *body)
+{
+    struct function *function = function_find(name);
+    struct control_node *copy = control_copy(body);
+
+    if(copy == NULL)
+        return -1;
+
+    if(function == NULL)
+    {
+        if((function_count >= bucket_count && grow() == -1)
+           || (function = calloc(1, sizeof(struct function))) == NULL)
+        {
+            control_free(copy);
+            return -1;
+        }
+        function->name = strdup(name);
+        size_t bucket = hash_name(name) & (bucket_count - 1);
+        function->next = table[bucket];
+        table[bucket] = function;
+        ++function_count;
+    }
+    else if(depth > 0)
+    {
+        function->body->next = retired;
+        retired = function->body;
+    }
+    else
+        control_free(function->body);
+
+    function->body = copy;
+    return 0;
+} // int function_define(const char*, const struct control_node*)
+
+/*
+ * ############################################################
+ * #######   CALLS
+ * ############################################################
+ */
+
+// Runs in the shell with argv as $0..$N, returns the status of the body
+int function_call(struct function *function, int argc, char **argv, control_runner run)
+{
+    int status;
+
+    if(depth >= FUNCTION_MAX_DEPTH)
+    {
+        ERROR("Function nesting too deep", function->name);
+        return EXIT_FAILURE;
+    }
+    if(vars_push_args(argc, argv) == -1)
+        return EXIT_FAILURE;
+
+    ++depth;
+    status = control_call(function->body, run);
+    --depth;
+
+    vars_pop_args();
+    if(depth == 0 && retired != NULL)
+    {
+        control_free(retired);
+        retired = NULL;
+    }
+    return status;
+} // int function_call(struct function*, int, char**, control_runner)
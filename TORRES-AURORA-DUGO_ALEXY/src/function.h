@@ -0,0 +1,30 @@
+#ifndef DEF_FUNCTION_H
+#define DEF_FUNCTION_H
+
+// MODULES INCLUDES
+#include "control.h"
+
+// Initial buckets of the function table, doubled when full
+#define FUNCTION_BUCKETS 64
+
+// Nested calls allowed, each one takes some stack for the line buffers
+#define FUNCTION_MAX_DEPTH 200
+
+/*
+ * ############################################################
+ * #######   FUNCTIONS
+ * ############################################################
+ */
+
+// Shell function, its body is kept parsed
+struct function {
+    char *name;
+    struct control_node *body;
+    struct function *next;
+}; // struct function
+
+int function_define(const char *name, const struct control_node *body);
+struct function* function_find(const char *name);
+int function_call(struct function *function, int argc, char **argv, control_runner run);
+
+#endif // DEF_FUNCTION_H
@@ -0,0 +1,105 @@
+// Needed for memfd_create, F_GETPIPE_SZ and the seals
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// HEADER
+#include "heredoc.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   DESCRIPTORS
+ * ############################################################
+ */
+
+static int write_all(int fd, const char *data, size_t len)
+{
+    while(len > 0)
+    {
+        ssize_t ret = write(fd, data, len);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += ret;
+        len -= ret;
+    }
+    return 0;
+} // int write_all(int, const char*, size_t)
+
+/*
+ * A body the pipe can hold is written at once before the reader
+ * starts, so nobody has to feed it and the write never blocks.
+ * Returns -1 when the pipe is too small for it.
+ */
+static int open_pipe(const char *data, size_t len)
+{
+    int fds[2];
+
+    if(pipe2(fds, O_CLOEXEC) == -1)
+        return -1;
+
+    int capacity = fcntl(fds[1], F_GETPIPE_SZ);
+    if(capacity != -1 && len > (size_t)capacity)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if(write_all(fds[1], data, len) == -1)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    close(fds[1]);
+    return fds[0];
+} // int open_pipe(const char*, size_t)
+
+/*
+ * Larger bodies live in an anonymous memory file, sealed so the
+ * reader can't change it, with no temporary file to clean up.
+ */
+static int open_memfd(const char *data, size_t len)
+{
+    int fd = memfd_create("heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+    if(fd == -1)
+        return -1;
+    if(write_all(fd, data, len) == -1
+       || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1
+       || lseek(fd, 0, SEEK_SET) == -1)
+    {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+} // int open_memfd(const char*, size_t)
+
+// Readable descriptor holding data, -1 on failure
+int heredoc_open(const char *data, size_t len)
+{
+    int fd = -1;
+
+    if(len <= HEREDOC_PIPE_MAX)
+        fd = open_pipe(data, len);
+    if(fd == -1)
+        fd = open_memfd(data, len);
+    if(fd == -1)
+        ERROR("Can't open here-document.", strerror(errno));
+    return fd;
+} // int heredoc_open(const char*, size_t)
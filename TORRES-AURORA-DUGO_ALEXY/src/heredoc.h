@@ -0,0 +1,18 @@
+#ifndef DEF_HEREDOC_H
+#define DEF_HEREDOC_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+// Bodies up to this size go through a pipe, larger ones through a memfd
+#define HEREDOC_PIPE_MAX (64 * 1024)
+
+/*
+ * ############################################################
+ * #######   HERE-DOCUMENTS
+ * ############################################################
+ */
+
+int heredoc_open(const char *data, size_t len);
+
+#endif // DEF_HEREDOC_H
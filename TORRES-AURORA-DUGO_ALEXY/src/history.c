@@ -0,0 +1,545 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+
+// HEADER
+#include "history.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+// Records are aligned on 8 bytes
+#define ALIGN8(X) (((X) + 7) & ~((uint64_t)7))
+#define DATA_START ALIGN8(sizeof(struct history_header))
+
+// Shared file and its mapping
+static char history_path[PATH_MAX];
+static int history_fd = -1;
+static char *history_map = NULL;
+static size_t history_map_size = 0;
+
+// Offset of every entry, built incrementally from the file
+static uint64_t *offsets = NULL;
+static long offsets_count = 0;
+static long offsets_capacity = 0;
+static uint64_t indexed_end = DATA_START;
+static uint64_t indexed_generation = 0;
+
+// Trigram index, built on the first search that needs it
+struct posting {
+    uint32_t *ids;
+    uint32_t count;
+    uint32_t capacity;
+}; // struct posting
+
+static struct posting *buckets = NULL;
+static long trigram_count = 0;
+
+#define HEADER ((struct history_header*)history_map)
+
+/*
+ * ############################################################
+ * #######   INDEX
+ * ############################################################
+ */
+
+static void reset_index(void)
+{
+    long i;
+
+    offsets_count = 0;
+    indexed_end = DATA_START;
+    trigram_count = 0;
+    if(buckets != NULL)
+    {
+        for(i = 0; i < HISTORY_BUCKETS; ++i)
+            buckets[i].count = 0;
+    }
+} // reset_index()
+
+static uint32_t trigram_hash(const unsigned char *str)
+{
+    uint32_t trigram = ((uint32_t)str[0] << 16) | ((uint32_t)str[1] << 8) | str[2];
+    return (trigram * 2654435761u) >> 16;
+} // uint32_t trigram_hash(const unsigned char*)
+
+static int posting_push(struct posting *list, uint32_t id)
+{
+    // Ids are pushed in order, a repeated trigram gives the same id
+    if(list->count > 0 && list->ids[list->count - 1] == id)
+        return 0;
+
+    if(list->count == list->capacity)
+    {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 8;
+        uint32_t *ids = realloc(list->ids, sizeof(uint32_t) * capacity);
+        if(ids == NULL)
+            return -1;
+        list->ids = ids;
+        list->capacity = capacity;
+    }
+    list->ids[list->count++] = id;
+    return 0;
+} // int posting_push(struct posting*, uint32_t)
+
+// Number of ids lower than limit among the first high ones
+static uint32_t count_below(const struct posting *list, long limit, uint32_t high)
+{
+    uint32_t low = 0;
+
+    while(low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        if((long)list->ids[middle] < limit)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+} // uint32_t count_below(const struct posting*, long, uint32_t)
+
+static void index_trigrams(void)
+{
+    if(buckets == NULL)
+        return;
+
+    for(; trigram_count < offsets_count; ++trigram_count)
+    {
+        const unsigned char *line = (const unsigned char*)history_get(trigram_count);
+        size_t len = strlen((const char*)line);
+        size_t i;
+        for(i = 0; i + 2 < len; ++i)
+        {
+            if(posting_push(&buckets[trigram_hash(line + i)], trigram_count) == -1)
+                return;
+        }
+    }
+} // index_trigrams()
+
+// Record the offsets of the entries appended since the last call
+static int index_offsets(void)
+{
+    uint64_t end = HEADER->end;
+
+    // The file was cleared or compacted, the offsets are stale
+    if(HEADER->generation != indexed_generation)
+    {
+        reset_index();
+        indexed_generation = HEADER->generation;
+    }
+
+    while(indexed_end < end)
+    {
+        struct history_record *record = (struct history_record*)(history_map + indexed_end);
+
+        if(offsets_count == offsets_capacity)
+        {
+            long capacity = offsets_capacity ? offsets_capacity * 2 : 1024;
+            uint64_t *grown = realloc(offsets, sizeof(uint64_t) * capacity);
+            if(grown == NULL)
+                return -1;
+            offsets = grown;
+            offsets_capacity = capacity;
+        }
+        offsets[offsets_count++] = indexed_end;
+        indexed_end += ALIGN8(sizeof(struct history_record) + record->len + 1);
+    }
+    return 0;
+} // int index_offsets()
+
+/*
+ * ############################################################
+ * #######   FILE
+ * ############################################################
+ */
+
+static int map_file(void)
+{
+    struct stat file_stat;
+
+    if(fstat(history_fd, &file_stat) == -1)
+        return -1;
+    if((size_t)file_stat.st_size == history_map_size)
+        return 0;
+
+    if(history_map != NULL)
+        munmap(history_map, history_map_size);
+    history_map = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, history_fd, 0);
+    if(history_map == MAP_FAILED)
+    {
+        history_map = NULL;
+        history_map_size = 0;
+        return -1;
+    }
+    history_map_size = file_stat.st_size;
+    return 0;
+} // int map_file()
+
+static void unmap_file(void)
+{
+    if(history_map != NULL)
+        munmap(history_map, history_map_size);
+    history_map = NULL;
+    history_map_size = 0;
+    if(history_fd != -1)
+        close(history_fd);
+    history_fd = -1;
+} // unmap_file()
+
+// Open and map the file, creating it if needed
+static int open_file(void)
+{
+    struct stat file_stat;
+
+    history_fd = open(history_path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if(history_fd == -1)
+        return -1;
+
+    flock(history_fd, LOCK_EX);
+    if(fstat(history_fd, &file_stat) == -1)
+        goto error;
+
+    if(file_stat.st_size < (off_t)DATA_START)
+    {
+        struct history_header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, HISTORY_MAGIC, sizeof(header.magic));
+        header.version = HISTORY_VERSION;
+        header.end = DATA_START;
+        header.max = HISTORY_DEFAULT_MAX;
+        if(ftruncate(history_fd, HISTORY_GROW_SIZE) == -1
+           || pwrite(history_fd, &header, sizeof(header), 0) != sizeof(header))
+            goto error;
+    }
+
+    if(map_file() == -1)
+        goto error;
+    if(memcmp(HEADER->magic, HISTORY_MAGIC, sizeof(HEADER->magic)) != 0
+       || HEADER->version != HISTORY_VERSION)
+    {
+        errno = EINVAL;
+        goto error;
+    }
+
+    flock(history_fd, LOCK_UN);
+    reset_index();
+    return 0;
+
+error:
+    unmap_file();
+    return -1;
+} // int open_file()
+
+// Follow appends, growth and compaction done by other shells
+static int sync_file(void)
+{
+    if(history_fd == -1)
+    {
+        if(history_path[0] == '\0' && history_open(NULL) == -1)
+            return -1;
+        if(history_fd == -1 && open_file() == -1)
+            return -1;
+    }
+
+    if(HEADER->replaced)
+    {
+        unmap_file();
+        if(open_file() == -1)
+            return -1;
+    }
+    if(HEADER->end > history_map_size && map_file() == -1)
+        return -1;
+
+    return index_offsets();
+} // int sync_file()
+
+/*
+ * Takes the lock on the current file, then follows what other shells did
+ * before it was taken. The index and mapping match the header until
+ * the lock is released.
+ */
+static int lock_file(void)
+{
+    if(sync_file() == -1)
+        return -1;
+
+    flock(history_fd, LOCK_EX);
+
+    // Compacted while we were waiting for the lock
+    while(HEADER->replaced)
+    {
+        flock(history_fd, LOCK_UN);
+        if(sync_file() == -1)
+            return -1;
+        flock(history_fd, LOCK_EX);
+    }
+
+    if(sync_file() == -1)
+    {
+        flock(history_fd, LOCK_UN);
+        return -1;
+    }
+    return 0;
+} // int lock_file()
+
+// Keep the last max entries, called with the lock held
+static void compact(void)
+{
+    char tmp_path[PATH_MAX + 32];
+    long first = offsets_count - HEADER->max;
+    struct history_header header;
+
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%ld", history_path, (long)getpid());
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if(fd == -1)
+        return;
+
+    // The entries kept are contiguous at the end of the file
+    uint64_t start = offsets[first];
+    header = *HEADER;
+    header.replaced = 0;
+    header.count = HEADER->max;
+    header.generation = HEADER->generation + 1;
+    header.end = DATA_START + (HEADER->end - start);
+
+    if(pwrite(fd, &header, sizeof(header), 0) != sizeof(header)
+       || pwrite(fd, history_map + start, HEADER->end - start, DATA_START) != (ssize_t)(HEADER->end - start)
+       || rename(tmp_path, history_path) == -1)
+    {
+        WARNING("Can't compact history file", strerror(errno));
+        close(fd);
+        unlink(tmp_path);
+        return;
+    }
+    close(fd);
+
+    // Shells still on the old file will reopen it
+    HEADER->replaced = 1;
+} // compact()
+
+/*
+ * ############################################################
+ * #######   HISTORY
+ * ############################################################
+ */
+
+// NULL opens $HOME/.asr2_history
+int history_open(const char *path)
+{
+    history_close();
+
+    if(path == NULL)
+    {
+        const char *home = getenv("HOME");
+        if(home == NULL)
+            return -1;
+        snprintf(history_path, sizeof(history_path), "%s/%s", home, HISTORY_FILE);
+    }
+    else
+        snprintf(history_path, sizeof(history_path), "%s", path);
+
+    return open_file();
+} // int history_open(const char*)
+
+void history_close(void)
+{
+    long i;
+
+    unmap_file();
+    reset_index();
+    free(offsets);
+    offsets = NULL;
+    offsets_capacity = 0;
+    if(buckets != NULL)
+    {
+        for(i = 0; i < HISTORY_BUCKETS; ++i)
+            free(buckets[i].ids);
+        free(buckets);
+        buckets = NULL;
+    }
+} // history_close()
+
+int history_add(const char *line)
+{
+    size_t len = strlen(line);
+    int compacted = 0;
+
+    if(len == 0 || lock_file() == -1)
+        return -1;
+
+    uint64_t end = HEADER->end;
+    uint64_t need = end + ALIGN8(sizeof(struct history_record) + len + 1);
+
+    // Another shell may have grown the file, grow it ourselves if still short
+    if(need > history_map_size && map_file() == -1)
+        goto error;
+    if(need > history_map_size)
+    {
+        if(ftruncate(history_fd, ALIGN8(need + HISTORY_GROW_SIZE)) == -1 || map_file() == -1)
+            goto error;
+    }
+
+    // Data first, readers only trust the header end
+    struct history_record *record = (struct history_record*)(history_map + end);
+    record->len = len;
+    record->time = (uint32_t)time(NULL);
+    memcpy(history_map + end + sizeof(struct history_record), line, len + 1);
+    HEADER->count += 1;
+    HEADER->end = need;
+
+    index_offsets();
+    if(HEADER->max > 0 && HEADER->count > HEADER->max + HEADER->max / 4)
+    {
+        compact();
+        compacted = 1;
+    }
+
+    flock(history_fd, LOCK_UN);
+
+    if(compacted)
+        return sync_file();
+    return 0;
+
+error:
+    flock(history_fd, LOCK_UN);
+    return -1;
+} // int history_add(const char*)
+
+long history_count(void)
+{
+    if(sync_file() == -1)
+        return 0;
+    return offsets_count;
+} // long history_count()
+
+// Pointer in the shared mapping, valid until the next history call
+const char* history_get(long index)
+{
+    if(index < 0 || index >= offsets_count)
+        return NULL;
+    return history_map + offsets[index] + sizeof(struct history_record);
+} // const char* history_get(long)
+
+/*
+ * Newest entry older than before containing query, -1 if none.
+ * before < 0 starts from the newest entry.
+ */
+long history_search(const char *query, long before)
+{
+    size_t len = strlen(query);
+    long id;
+
+    if(sync_file() == -1)
+        return -1;
+    if(before < 0 || before > offsets_count)
+        before = offsets_count;
+
+    // Too short for trigrams, recent entries match first anyway
+    if(len < 3)
+    {
+        for(id = before - 1; id >= 0; --id)
+        {
+            if(strstr(history_get(id), query) != NULL)
+                return id;
+        }
+        return -1;
+    }
+
+    if(buckets == NULL)
+    {
+        buckets = calloc(HISTORY_BUCKETS, sizeof(struct posting));
+        if(buckets == NULL)
+            return -1;
+    }
+    index_trigrams();
+
+    // Posting lists of the query trigrams, the shortest one is walked
+    struct posting *lists[HISTORY_QUERY_TRIGRAMS];
+    uint32_t cursors[HISTORY_QUERY_TRIGRAMS];
+    int list_count = 0, j, k;
+    size_t i;
+    for(i = 0; i + 2 < len && list_count < HISTORY_QUERY_TRIGRAMS; ++i)
+    {
+        struct posting *list = &buckets[trigram_hash((const unsigned char*)query + i)];
+        for(j = 0; j < list_count && lists[j] != list; ++j)
+            ;
+        if(j < list_count)
+            continue;
+        lists[list_count] = list;
+        cursors[list_count] = count_below(list, before, list->count);
+        if(list->count < lists[0]->count)
+        {
+            lists[list_count] = lists[0];
+            cursors[list_count] = cursors[0];
+            lists[0] = list;
+            cursors[0] = count_below(list, before, list->count);
+        }
+        ++list_count;
+    }
+
+    // Candidates must be in every list, only those are read from the file
+    while(cursors[0] > 0)
+    {
+        id = lists[0]->ids[--cursors[0]];
+        for(k = 1; k < list_count; ++k)
+        {
+            cursors[k] = count_below(lists[k], id + 1, cursors[k]);
+            if(cursors[k] == 0 || lists[k]->ids[cursors[k] - 1] != id)
+                break;
+        }
+        if(k == list_count && strstr(history_get(id), query) != NULL)
+            return id;
+    }
+    return -1;
+} // long history_search(const char*, long)
+
+int history_clear(void)
+{
+    if(lock_file() == -1)
+        return -1;
+
+    HEADER->count = 0;
+    HEADER->end = DATA_START;
+    HEADER->generation += 1;
+    flock(history_fd, LOCK_UN);
+
+    reset_index();
+    return 0;
+} // int history_clear()
+
+int history_set_max(long max)
+{
+    if(max < 0 || lock_file() == -1)
+        return -1;
+
+    HEADER->max = max;
+    int compacted = max > 0 && offsets_count > max;
+    if(compacted)
+        compact();
+    flock(history_fd, LOCK_UN);
+
+    return compacted ? sync_file() : 0;
+} // int history_set_max(long)
+
+long history_get_max(void)
+{
+    if(sync_file() == -1)
+        return -1;
+    return HEADER->max;
+} // long history_get_max()
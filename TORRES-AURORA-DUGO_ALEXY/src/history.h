@@ -0,0 +1,64 @@
+#ifndef DEF_HISTORY_H
+#define DEF_HISTORY_H
+
+// STD INCLUDES
+#include <stdint.h>
+#include <stddef.h>
+
+// File magic and version
+#define HISTORY_MAGIC "ASR2HST1"
+#define HISTORY_VERSION 2
+
+// Default file name in $HOME and default max entries kept
+#define HISTORY_FILE ".asr2_history"
+#define HISTORY_DEFAULT_MAX 100000
+
+// The file grows by chunks, the mapping follows
+#define HISTORY_GROW_SIZE (1024 * 1024)
+
+// Trigram buckets of the search index
+#define HISTORY_BUCKETS 65536
+
+// Trigrams of a query intersected before reading the entries
+#define HISTORY_QUERY_TRIGRAMS 16
+
+/*
+ * ############################################################
+ * #######   FILE FORMAT
+ * ############################################################
+ */
+
+// Header at the beginning of the shared file
+struct history_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t replaced;          /* set when compaction replaced the file */
+    uint64_t count;             /* entries in the file */
+    uint64_t end;               /* end of the last record */
+    uint64_t max;               /* entries kept by compaction */
+    uint64_t generation;        /* bumped when entries are removed */
+}; // struct history_header
+
+// Each record is followed by the line, a NUL and padding to 8 bytes
+struct history_record {
+    uint32_t len;
+    uint32_t time;
+}; // struct history_record
+
+/*
+ * ############################################################
+ * #######   HISTORY
+ * ############################################################
+ */
+
+int history_open(const char *path);
+void history_close(void);
+int history_add(const char *line);
+long history_count(void);
+const char* history_get(long index);
+long history_search(const char *query, long before);
+int history_clear(void);
+int history_set_max(long max);
+long history_get_max(void);
+
+#endif // DEF_HISTORY_H
@@ -0,0 +1,262 @@
+// Needed for tee and pipe2
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// HEADER
+#include "input.h"
+
+/*
+ * ############################################################
+ * #######   HELPERS
+ * ############################################################
+ */
+
+static const char *method_names[] = {"read/lseek", "tee peek", "recv peek", "byte reads"};
+
+// Lookahead of the next read, follows the length of the lines
+static size_t lookahead = INPUT_LOOKAHEAD_MIN;
+
+// Pipe the input is teed into to look at it without consuming it
+static int scratch[2] = {-1, -1};
+
+static int reserve(struct input_buffer *line, size_t size)
+{
+    if(line->len + size + 1 <= line->capacity)
+        return 0;
+
+    size_t capacity = line->capacity ? line->capacity : 256;
+    while(capacity < line->len + size + 1)
+        capacity *= 2;
+    char *grown = realloc(line->data, capacity);
+    if(grown == NULL)
+        return -1;
+    line->data = grown;
+    line->capacity = capacity;
+    return 0;
+} // int reserve(struct input_buffer*, size_t)
+
+static void adapt_lookahead(size_t len)
+{
+    lookahead = len * 2;
+    if(lookahead < INPUT_LOOKAHEAD_MIN)
+        lookahead = INPUT_LOOKAHEAD_MIN;
+    if(lookahead > INPUT_LOOKAHEAD_MAX)
+        lookahead = INPUT_LOOKAHEAD_MAX;
+} // adapt_lookahead(size_t)
+
+static ssize_t read_retry(int fd, char *buffer, size_t size)
+{
+    ssize_t ret;
+
+    while((ret = read(fd, buffer, size)) == -1 && errno == EINTR);
+    return ret;
+} // ssize_t read_retry(int, char*, size_t)
+
+// Copies at most size bytes waiting in fd without consuming them
+static ssize_t peek(int fd, char *buffer, size_t size, int method)
+{
+    ssize_t ret;
+
+    if(method == INPUT_RECV)
+    {
+        while((ret = recv(fd, buffer, size, MSG_PEEK)) == -1 && errno == EINTR);
+        return ret;
+    }
+
+    if(scratch[0] == -1 && pipe2(scratch, O_CLOEXEC) == -1)
+        return -1;
+    // Waits for data like read, 0 once the writers are gone
+    while((ret = tee(fd, scratch[1], size, 0)) == -1 && errno == EINTR);
+    if(ret <= 0)
+        return ret;
+    return read_retry(scratch[0], buffer, ret);
+} // ssize_t peek(int, char*, size_t, int)
+
+/*
+ * ############################################################
+ * #######   LINE INPUT
+ * ############################################################
+ */
+
+// Best way to read lines from fd and leave the rest of it in place
+int input_method(int fd)
+{
+    struct stat st;
+
+    if(fstat(fd, &st) == -1)
+        return INPUT_BYTE;
+    if(S_ISREG(st.st_mode))
+        return INPUT_SEEK;
+    if(S_ISFIFO(st.st_mode))
+        return INPUT_TEE;
+    if(S_ISSOCK(st.st_mode))
+        return INPUT_RECV;
+    return INPUT_BYTE;
+} // int input_method(int)
+
+const char* input_method_name(int method)
+{
+    return method_names[method];
+} // const char* input_method_name(int)
+
+/*
+ * Reads a line of fd into line, the input after the newline stays for
+ * the next reader. A regular file is read ahead then the offset is set
+ * back after the newline. A pipe or a socket is peeked at, and exactly
+ * the line is read. The lookahead follows the length of the previous
+ * lines, so short lines don't copy a big buffer each. Returns 1 for a
+ * line, 0 at the end of input and -1 on error.
+ */
+int input_line(int fd, struct input_buffer *line, int method)
+{
+    line->len = 0;
+
+    for(;;)
+    {
+        size_t size = method == INPUT_BYTE ? 1 : lookahead;
+        char *start;
+        ssize_t got;
+
+        if(reserve(line, size) == -1)
+            return -1;
+        start = line->data + line->len;
+
+        if(method == INPUT_TEE || method == INPUT_RECV)
+            got = peek(fd, start, size, method);
+        else
+            got = read_retry(fd, start, size);
+        if(got == -1 && method == INPUT_TEE && errno == EINVAL && line->len == 0)
+        {
+            // Not a pipe tee can read after all
+            method = INPUT_BYTE;
+            continue;
+        }
+        if(got == -1)
+            return -1;
+        if(got == 0)
+            break;
+
+        char *newline = memchr(start, '\n', got);
+        size_t used = newline != NULL ? (size_t)(newline - start) + 1 : (size_t)got;
+
+        if(method == INPUT_SEEK && used < (size_t)got)
+        {
+            if(lseek(fd, (off_t)used - got, SEEK_CUR) == -1)
+                return -1;
+        }
+        else if(method == INPUT_TEE || method == INPUT_RECV)
+        {
+            // Consumes what was peeked, the same bytes land in place
+            size_t done = 0;
+            while(done < used)
+            {
+                got = read_retry(fd, start + done, used - done);
+                if(got <= 0)
+                    return -1;
+                done += got;
+            }
+        }
+
+        if(newline != NULL)
+        {
+            line->len += used - 1;
+            line->data[line->len] = '\0';
+            adapt_lookahead(line->len + 1);
+            return 1;
+        }
+        line->len += used;
+        if(method != INPUT_BYTE)
+            adapt_lookahead(lookahead);
+    }
+
+    // Last line without a newline
+    if(line->data != NULL)
+        line->data[line->len] = '\0';
+    return line->len > 0;
+} // int input_line(int, struct input_buffer*, int)
+
+/*
+ * Reads fd to its end by big chunks and calls callback for each line,
+ * for a reader which owns the whole stream. callback gets the line
+ * without its newline and stops the reading when it returns -1.
+ */
+int input_lines(int fd, int (*callback)(const char *line, size_t len, void *data), void *data)
+{
+    struct input_buffer partial = {NULL, 0, 0};
+    char *chunk = malloc(INPUT_CHUNK_SIZE);
+    int ret = 0;
+
+    if(chunk == NULL)
+        return -1;
+
+    for(;;)
+    {
+        ssize_t got = read_retry(fd, chunk, INPUT_CHUNK_SIZE);
+        if(got <= 0)
+        {
+            ret = (int)got;
+            break;
+        }
+
+        const char *c = chunk, *end = chunk + got;
+        const char *newline;
+        while(ret == 0 && (newline = memchr(c, '\n', end - c)) != NULL)
+        {
+            if(partial.len > 0)
+            {
+                // End of a line started in the previous chunk
+                if(reserve(&partial, newline - c) == -1)
+                    ret = -1;
+                else
+                {
+                    memcpy(partial.data + partial.len, c, newline - c);
+                    partial.len += newline - c;
+                    ret = callback(partial.data, partial.len, data);
+                    partial.len = 0;
+                }
+            }
+            else
+                ret = callback(c, newline - c, data);
+            c = newline + 1;
+        }
+        if(ret == -1)
+            break;
+
+        if(c < end)
+        {
+            if(reserve(&partial, end - c) == -1)
+            {
+                ret = -1;
+                break;
+            }
+            memcpy(partial.data + partial.len, c, end - c);
+            partial.len += end - c;
+        }
+    }
+
+    if(ret == 0 && partial.len > 0)
+        ret = callback(partial.data, partial.len, data);
+    free(partial.data);
+    free(chunk);
+    return ret;
+} // int input_lines(int, int (*)(const char*, size_t, void*), void*)
+
+void input_free(struct input_buffer *line)
+{
+    free(line->data);
+    line->data = NULL;
+    line->len = 0;
+    line->capacity = 0;
+} // input_free(struct input_buffer*)
@@ -0,0 +1,41 @@
+#ifndef DEF_INPUT_H
+#define DEF_INPUT_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+// Lookahead of the first read of a line, then twice the last line length
+#define INPUT_LOOKAHEAD_MIN 128
+
+// Largest lookahead, the scratch pipe of the peek holds as much
+#define INPUT_LOOKAHEAD_MAX (64 * 1024)
+
+// Read size when the whole stream is consumed
+#define INPUT_CHUNK_SIZE (1024 * 1024)
+
+// How a line is read without consuming the input after it
+#define INPUT_SEEK      0       /* regular file : read ahead, seek back */
+#define INPUT_TEE       1       /* pipe : peek with tee, read the line */
+#define INPUT_RECV      2       /* socket : peek with MSG_PEEK, read the line */
+#define INPUT_BYTE      3       /* anything else : a byte per read */
+
+/*
+ * ############################################################
+ * #######   LINE INPUT
+ * ############################################################
+ */
+
+// Growing buffer of the line read, without its newline
+struct input_buffer {
+    char *data;
+    size_t len;
+    size_t capacity;
+}; // struct input_buffer
+
+int input_method(int fd);
+const char* input_method_name(int method);
+int input_line(int fd, struct input_buffer *line, int method);
+int input_lines(int fd, int (*callback)(const char *line, size_t len, void *data), void *data);
+void input_free(struct input_buffer *line);
+
+#endif // DEF_INPUT_H
@@ -0,0 +1,434 @@
+// Needed for pipe2
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+
+// HEADER
+#include "jobs.h"
+#include "event.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+struct job {
+    int id;                     /* 0 for a free slot */
+    pid_t pid;
+    int fd;                     /* read end, -1 at end of file */
+    int write_fd;               /* given to the child, closed once forked */
+    int mode;
+    volatile sig_atomic_t reaped;
+    int status;
+    char *ring;                 /* output not flushed yet */
+    size_t start;
+    size_t len;
+    char command[JOBS_LABEL_SIZE];
+}; // struct job
+
+static struct job jobs[JOBS_MAX];
+static int mode = JOBS_OFF;
+
+// Jobs ended with a non zero status since jobs_failed
+static int failed = 0;
+
+// Forked children inherit the table and the exit handler
+static pid_t shell_pid = -1;
+
+static const char *mode_names[] = {"off", "line", "hold"};
+
+// Lines of every job go through here, a line is never split between writes
+static char output[JOBS_BUFFER_SIZE + 32];
+static size_t output_len = 0;
+
+/*
+ * ############################################################
+ * #######   OUTPUT
+ * ############################################################
+ */
+
+static void output_flush(void)
+{
+    size_t done = 0;
+
+    while(done < output_len)
+    {
+        ssize_t ret = write(STDOUT_FILENO, output + done, output_len - done);
+        if(ret == -1 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            break;
+        done += ret;
+    }
+    output_len = 0;
+} // output_flush()
+
+// Copies count bytes of the ring from offset, the ring may wrap
+static void ring_copy(const struct job *job, size_t offset, size_t count, char *dest)
+{
+    size_t pos = (job->start + offset) % JOBS_BUFFER_SIZE;
+    size_t first = JOBS_BUFFER_SIZE - pos;
+
+    if(first > count)
+        first = count;
+    memcpy(dest, job->ring + pos, first);
+    memcpy(dest + first, job->ring, count - first);
+} // ring_copy(const struct job*, size_t, size_t, char*)
+
+// Offset of the next newline from offset, -1 for none
+static long ring_find(const struct job *job, size_t offset)
+{
+    size_t pos = (job->start + offset) % JOBS_BUFFER_SIZE;
+    size_t count = job->len - offset;
+    size_t first = JOBS_BUFFER_SIZE - pos;
+    char *found;
+
+    if(first > count)
+        first = count;
+    found = memchr(job->ring + pos, '\n', first);
+    if(found != NULL)
+        return offset + (found - (job->ring + pos));
+    found = memchr(job->ring, '\n', count - first);
+    if(found != NULL)
+        return offset + first + (found - job->ring);
+    return -1;
+} // long ring_find(const struct job*, size_t)
+
+static void output_line(const struct job *job, size_t offset, size_t count, int newline)
+{
+    char prefix[32];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "[%d] ", job->id);
+
+    if(output_len + prefix_len + count + newline > sizeof(output))
+        output_flush();
+    memcpy(output + output_len, prefix, prefix_len);
+    output_len += prefix_len;
+    ring_copy(job, offset, count, output + output_len);
+    output_len += count;
+    if(newline)
+        output[output_len++] = '\n';
+} // output_line(const struct job*, size_t, size_t, int)
+
+/*
+ * Writes the complete lines of the ring with the job prefix. With
+ * force, the rest is written too as a line of its own.
+ */
+static void flush_lines(struct job *job, int force)
+{
+    size_t done = 0;
+    long newline;
+
+    // The shell output written so far comes first
+    fflush(stdout);
+    while(done < job->len && (newline = ring_find(job, done)) != -1)
+    {
+        output_line(job, done, newline - done + 1, 0);
+        done = newline + 1;
+    }
+    if(force && done < job->len)
+    {
+        output_line(job, done, job->len - done, 1);
+        done = job->len;
+    }
+    output_flush();
+
+    job->len -= done;
+    job->start = job->len == 0 ? 0 : (job->start + done) % JOBS_BUFFER_SIZE;
+} // flush_lines(struct job*, int)
+
+static void release(struct job *job)
+{
+    if(job->fd != -1)
+    {
+        event_remove(job->fd);
+        close(job->fd);
+    }
+    if(job->write_fd != -1)
+        close(job->write_fd);
+    free(job->ring);
+    job->ring = NULL;
+    job->fd = -1;
+    job->write_fd = -1;
+    job->id = 0;
+} // release(struct job*)
+
+// Both the output and the process are over
+static void finish(struct job *job)
+{
+    char line[JOBS_LABEL_SIZE + 64];
+    int status = WIFSIGNALED(job->status) ? 128 + WTERMSIG(job->status) : WEXITSTATUS(job->status);
+    int len;
+
+    flush_lines(job, 1);
+    if(status == 0)
+        len = snprintf(line, sizeof(line), "[%d] done  %s\n", job->id, job->command);
+    else
+    {
+        len = snprintf(line, sizeof(line), "[%d] exit %d  %s\n", job->id, status, job->command);
+        ++failed;
+    }
+    memcpy(output, line, len);
+    output_len = len;
+    output_flush();
+    release(job);
+} // finish(struct job*)
+
+static int collect(struct job *job)
+{
+    int status;
+
+    if(!job->reaped && waitpid(job->pid, &status, WNOHANG) == job->pid)
+    {
+        job->status = status;
+        job->reaped = 1;
+    }
+    if(!job->reaped || job->fd != -1)
+        return 0;
+    finish(job);
+    return 1;
+} // int collect(struct job*)
+
+static void job_output(int fd, short revents, void *data)
+{
+    struct job *job = data;
+    size_t tail = (job->start + job->len) % JOBS_BUFFER_SIZE;
+    size_t space = JOBS_BUFFER_SIZE - job->len;
+    ssize_t ret;
+
+    // Never more than the free part of the ring
+    if(space > JOBS_BUFFER_SIZE - tail)
+        space = JOBS_BUFFER_SIZE - tail;
+    ret = read(fd, job->ring + tail, space);
+    if(ret > 0)
+    {
+        job->len += ret;
+        if(job->mode == JOBS_LINES || job->len == JOBS_BUFFER_SIZE)
+            flush_lines(job, 0);
+        // A line longer than the ring
+        if(job->len == JOBS_BUFFER_SIZE)
+            flush_lines(job, 1);
+        return;
+    }
+    if(ret == -1 && errno == EINTR)
+        return;
+
+    // End of file, the process may still be running
+    event_remove(fd);
+    close(fd);
+    job->fd = -1;
+    collect(job);
+} // job_output(int, short, void*)
+
+/*
+ * ############################################################
+ * #######   JOBS
+ * ############################################################
+ */
+
+void jobs_init(void)
+{
+    int i;
+
+    for(i = 0; i < JOBS_MAX; ++i)
+    {
+        jobs[i].fd = -1;
+        jobs[i].write_fd = -1;
+    }
+    shell_pid = getpid();
+    atexit(jobs_finish);
+} // jobs_init()
+
+// Forked child running shell code : the jobs of the shell are not its own
+void jobs_reset(void)
+{
+    int i;
+
+    for(i = 0; i < JOBS_MAX; ++i)
+    {
+        // The event loop of the child has been reset already
+        if(jobs[i].id != 0)
+            release(&jobs[i]);
+    }
+    output_len = 0;
+    failed = 0;
+    shell_pid = getpid();
+} // jobs_reset()
+
+int jobs_set_mode(const char *name)
+{
+    int i;
+
+    for(i = JOBS_OFF; i <= JOBS_HOLD; ++i)
+    {
+        if(strcmp(name, mode_names[i]) == 0)
+        {
+            mode = i;
+            return 0;
+        }
+    }
+    return -1;
+} // int jobs_set_mode(const char*)
+
+int jobs_mode(void)
+{
+    return mode;
+} // int jobs_mode()
+
+const char* jobs_mode_name(void)
+{
+    return mode_names[mode];
+} // const char* jobs_mode_name()
+
+/*
+ * Job for a background command about to be forked, fd is the pipe the
+ * child writes its stdout and stderr to. -1 when output isn't captured.
+ */
+int jobs_open(const char *command, int *fd)
+{
+    int pipefd[2];
+    int i, slot = -1, id = 1;
+    size_t len;
+
+    if(mode == JOBS_OFF)
+        return -1;
+    for(i = 0; i < JOBS_MAX; ++i)
+    {
+        if(jobs[i].id == 0 && slot == -1)
+            slot = i;
+        if(jobs[i].id >= id)
+            id = jobs[i].id + 1;
+    }
+    if(slot == -1)
+    {
+        WARNING("Too many jobs, output not captured.", "\n");
+        return -1;
+    }
+
+    struct job *job = &jobs[slot];
+    job->ring = malloc(JOBS_BUFFER_SIZE);
+    if(job->ring == NULL || pipe2(pipefd, O_CLOEXEC) == -1)
+    {
+        ERROR("Can't capture job output.", strerror(errno));
+        free(job->ring);
+        job->ring = NULL;
+        return -1;
+    }
+    job->id = id;
+    job->pid = -1;
+    job->fd = pipefd[0];
+    job->write_fd = pipefd[1];
+    job->mode = mode;
+    job->reaped = 0;
+    job->status = 0;
+    job->start = 0;
+    job->len = 0;
+
+    while(*command == ' ')
+        ++command;
+    snprintf(job->command, sizeof(job->command), "%s", command);
+    len = strlen(job->command);
+    while(len > 0 && (job->command[len - 1] == ' ' || job->command[len - 1] == '\n'))
+        job->command[--len] = '\0';
+
+    *fd = pipefd[1];
+    return slot;
+} // int jobs_open(const char*, int*)
+
+// In the shell after fork, SIGCHLD still blocked. -1 if fork failed.
+void jobs_started(int slot, pid_t pid)
+{
+    struct job *job = &jobs[slot];
+
+    close(job->write_fd);
+    job->write_fd = -1;
+    if(pid == -1)
+    {
+        release(job);
+        return;
+    }
+    job->pid = pid;
+    if(event_add(job->fd, POLLIN, job_output, job) == -1)
+    {
+        // The job gets SIGPIPE rather than blocking for ever
+        close(job->fd);
+        job->fd = -1;
+    }
+} // jobs_started(int, pid_t)
+
+// Status of a job reaped by someone else, async signal safe
+void jobs_reaped(pid_t pid, int status)
+{
+    int i;
+
+    for(i = 0; i < JOBS_MAX; ++i)
+    {
+        if(jobs[i].id != 0 && jobs[i].pid == pid)
+        {
+            jobs[i].status = status;
+            jobs[i].reaped = 1;
+            return;
+        }
+    }
+} // jobs_reaped(pid_t, int)
+
+// Reports the ended jobs and returns the number of jobs still captured
+int jobs_update(void)
+{
+    int i, running = 0;
+
+    for(i = 0; i < JOBS_MAX; ++i)
+    {
+        if(jobs[i].id != 0 && jobs[i].pid != -1 && !collect(&jobs[i]))
+            ++running;
+    }
+    return running;
+} // int jobs_update()
+
+// Number of jobs which failed since the last call
+int jobs_failed(void)
+{
+    int count = failed;
+
+    failed = 0;
+    return count;
+} // int jobs_failed()
+
+void jobs_print(FILE *out)
+{
+    int i;
+
+    for(i = 0; i < JOBS_MAX; ++i)
+    {
+        struct job *job = &jobs[i];
+        if(job->id == 0)
+            continue;
+        fprintf(out, "[%d] %-8ld %-8s %6zu  %s\n", job->id, (long)job->pid,
+                job->reaped ? "done" : "running", job->len, job->command);
+    }
+} // jobs_print(FILE*)
+
+// At exit the output of the captured jobs has nowhere else to go
+void jobs_finish(void)
+{
+    if(getpid() != shell_pid)
+        return;
+    while(jobs_update() > 0)
+    {
+        if(event_poll(-1) == -1)
+            break;
+    }
+} // jobs_finish()
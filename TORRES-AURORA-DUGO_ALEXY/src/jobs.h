@@ -0,0 +1,45 @@
+#ifndef DEF_JOBS_H
+#define DEF_JOBS_H
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <stdio.h>
+
+// Output modes of background jobs
+#define JOBS_OFF    0   /* jobs write to the terminal themselves */
+#define JOBS_LINES  1   /* complete lines flushed as they come */
+#define JOBS_HOLD   2   /* output flushed when the job ends */
+
+// Jobs captured at the same time, the next ones are not captured
+#define JOBS_MAX 32
+
+/*
+ * Ring buffer of each job. A longer line is split and held output
+ * beyond it is flushed early. While the shell doesn't read, the job
+ * blocks on its full pipe.
+ */
+#define JOBS_BUFFER_SIZE 65536
+
+// Command shown with the job id
+#define JOBS_LABEL_SIZE 64
+
+/*
+ * ############################################################
+ * #######   JOB OUTPUT
+ * ############################################################
+ */
+
+void jobs_init(void);
+void jobs_reset(void);
+int jobs_set_mode(const char *name);
+int jobs_mode(void);
+const char* jobs_mode_name(void);
+int jobs_open(const char *command, int *fd);
+void jobs_started(int job, pid_t pid);
+void jobs_reaped(pid_t pid, int status);
+int jobs_update(void);
+int jobs_failed(void);
+void jobs_print(FILE *out);
+void jobs_finish(void);
+
+#endif // DEF_JOBS_H
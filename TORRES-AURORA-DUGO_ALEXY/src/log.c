@@ -0,0 +1,270 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// HEADER
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+static int log_fd = STDERR_FILENO;
+static int log_level = LOG_LVL_INFO;
+static int log_format = LOG_FORMAT_TEXT;
+static int log_prefix = 0;
+static int log_color_mode = LOG_COLOR_AUTO;
+
+// Computed from the log fd, colour is only used on a terminal
+static int log_use_color = -1;
+
+static const char *level_names[] = {"critic", "error", "warning", "info", "debug"};
+static const char *level_tags[] = {"[CRITIC] ", "[ERROR] ", "[WARNING] ", "[INFO] ", "[DEBUG] "};
+static const char *level_colors[] = {"\033[31m", "\033[91m", "\033[93m", "", "\033[90m"};
+
+/*
+ * ############################################################
+ * #######   RECORD BUFFER
+ * ############################################################
+ */
+
+struct log_buffer {
+    char data[LOG_RECORD_MAX];
+    size_t len;
+}; // struct log_buffer
+
+static void buf_puts(struct log_buffer *buf, const char *str)
+{
+    // Keep room for the final newline
+    while(*str && buf->len < LOG_RECORD_MAX - 1)
+        buf->data[buf->len++] = *str++;
+} // buf_puts(struct log_buffer*, const char*)
+
+static void buf_putc(struct log_buffer *buf, char c)
+{
+    if(buf->len < LOG_RECORD_MAX - 1)
+        buf->data[buf->len++] = c;
+} // buf_putc(struct log_buffer*, char)
+
+static void buf_put_json(struct log_buffer *buf, const char *str)
+{
+    char hex[8];
+
+    buf_putc(buf, '"');
+    for(; *str; ++str)
+    {
+        unsigned char c = (unsigned char)*str;
+        if(c == '"' || c == '\\')
+        {
+            buf_putc(buf, '\\');
+            buf_putc(buf, c);
+        }
+        else if(c == '\n')
+            buf_puts(buf, "\\n");
+        else if(c == '\t')
+            buf_puts(buf, "\\t");
+        else if(c < 0x20)
+        {
+            snprintf(hex, sizeof(hex), "\\u%04x", c);
+            buf_puts(buf, hex);
+        }
+        else
+            buf_putc(buf, c);
+    }
+    buf_putc(buf, '"');
+} // buf_put_json(struct log_buffer*, const char*)
+
+// Details such as "\n" were used as filler by the old macros
+static int is_blank(const char *str)
+{
+    if(str == NULL)
+        return 1;
+    for(; *str; ++str)
+    {
+        if(*str != ' ' && *str != '\n' && *str != '\t')
+            return 0;
+    }
+    return 1;
+} // int is_blank(const char*)
+
+static void format_time(char *out, size_t size)
+{
+    struct timespec now;
+    struct tm tm_now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    gmtime_r(&now.tv_sec, &tm_now);
+    size_t len = strftime(out, size, "%Y-%m-%dT%H:%M:%S", &tm_now);
+    snprintf(out + len, size - len, ".%03ldZ", now.tv_nsec / 1000000);
+} // format_time(char*, size_t)
+
+/*
+ * ############################################################
+ * #######   LOGGER
+ * ############################################################
+ */
+
+void log_init(void)
+{
+    log_use_color = -1;
+} // log_init()
+
+void log_record(int level, const char *out, const char *code)
+{
+    struct log_buffer buf;
+    char field[64];
+    int saved_errno = errno;
+
+    if(level > log_level)
+        return;
+    if(level < LOG_LVL_CRITIC)
+        level = LOG_LVL_CRITIC;
+    if(level > LOG_LVL_DEBUG)
+        level = LOG_LVL_DEBUG;
+
+    buf.len = 0;
+
+    if(log_format == LOG_FORMAT_JSON)
+    {
+        // One JSON object per line
+        format_time(field, sizeof(field));
+        buf_puts(&buf, "{\"ts\":\"");
+        buf_puts(&buf, field);
+        snprintf(field, sizeof(field), "\",\"pid\":%ld,\"level\":\"", (long)getpid());
+        buf_puts(&buf, field);
+        buf_puts(&buf, level_names[level]);
+        buf_puts(&buf, "\",\"msg\":");
+        buf_put_json(&buf, out ? out : "");
+        if(!is_blank(code))
+        {
+            buf_puts(&buf, ",\"detail\":");
+            buf_put_json(&buf, code);
+        }
+        buf_puts(&buf, "}");
+    }
+    else
+    {
+        if(log_use_color == -1)
+            log_use_color = (log_color_mode == LOG_COLOR_AUTO && isatty(log_fd));
+        if(log_use_color)
+            buf_puts(&buf, level_colors[level]);
+
+        if(log_prefix & LOG_PREFIX_TIME)
+        {
+            format_time(field, sizeof(field));
+            buf_puts(&buf, field);
+            buf_putc(&buf, ' ');
+        }
+        if(log_prefix & LOG_PREFIX_PID)
+        {
+            snprintf(field, sizeof(field), "[%ld] ", (long)getpid());
+            buf_puts(&buf, field);
+        }
+
+        buf_puts(&buf, level_tags[level]);
+        buf_puts(&buf, out ? out : "");
+        if(!is_blank(code))
+        {
+            buf_puts(&buf, ": ");
+            buf_puts(&buf, code);
+        }
+
+        if(log_use_color)
+            buf_puts(&buf, "\033[0m");
+    }
+    buf.data[buf.len++] = '\n';
+
+    // Single write, retried only if interrupted or partial
+    size_t done = 0;
+    while(done < buf.len)
+    {
+        ssize_t ret = write(log_fd, buf.data + done, buf.len - done);
+        if(ret == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            break;
+        }
+        done += ret;
+    }
+
+    errno = saved_errno;
+} // log_record(int, const char*, const char*)
+
+int log_set_fd(int fd)
+{
+    if(fcntl(fd, F_GETFD) == -1)
+        return -1;
+    log_fd = fd;
+    log_use_color = -1;
+    return 0;
+} // int log_set_fd(int)
+
+int log_get_fd(void)
+{
+    return log_fd;
+} // int log_get_fd()
+
+void log_set_level(int level)
+{
+    log_level = level;
+} // log_set_level(int)
+
+int log_get_level(void)
+{
+    return log_level;
+} // int log_get_level()
+
+void log_set_format(int format)
+{
+    log_format = format;
+} // log_set_format(int)
+
+int log_get_format(void)
+{
+    return log_format;
+} // int log_get_format()
+
+void log_set_prefix(int prefix)
+{
+    log_prefix = prefix;
+} // log_set_prefix(int)
+
+int log_get_prefix(void)
+{
+    return log_prefix;
+} // int log_get_prefix()
+
+void log_set_color(int color)
+{
+    log_color_mode = color;
+    log_use_color = -1;
+} // log_set_color(int)
+
+int log_level_from_name(const char *name)
+{
+    int i;
+    for(i = LOG_LVL_CRITIC; i <= LOG_LVL_DEBUG; ++i)
+    {
+        if(strcmp(name, level_names[i]) == 0)
+            return i;
+    }
+    return -1;
+} // int log_level_from_name(const char*)
+
+const char* log_level_name(int level)
+{
+    if(level < LOG_LVL_CRITIC || level > LOG_LVL_DEBUG)
+        return "unknown";
+    return level_names[level];
+} // const char* log_level_name(int)
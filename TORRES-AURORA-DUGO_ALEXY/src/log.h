@@ -0,0 +1,84 @@
+#ifndef DEF_LOG_H
+#define DEF_LOG_H
+
+// STD INCLUDES
+#include <stdlib.h>
+
+/*
+ * ############################################################
+ * #######   LOG LEVELS AND FORMATS
+ * ############################################################
+ */
+
+// Levels, a record is emitted when its level is <= the current level
+#define LOG_LVL_CRITIC  0
+#define LOG_LVL_ERROR   1
+#define LOG_LVL_WARNING 2
+#define LOG_LVL_INFO    3
+#define LOG_LVL_DEBUG   4
+
+// Output formats
+#define LOG_FORMAT_TEXT 0
+#define LOG_FORMAT_JSON 1
+
+// Optional prefix fields (text format, always present in JSON)
+#define LOG_PREFIX_TIME 0x1
+#define LOG_PREFIX_PID  0x2
+
+// Colour mode
+#define LOG_COLOR_AUTO  0
+#define LOG_COLOR_NEVER 1
+
+// Max size of a formatted record, longer records are truncated
+#define LOG_RECORD_MAX 2048
+
+/*
+ * ############################################################
+ * #######   Output MACRO
+ * ############################################################
+ */
+
+#define CRITIC(OUT, CODE) do { \
+    log_record(LOG_LVL_CRITIC, OUT, CODE); \
+    exit(EXIT_FAILURE); \
+}while(0);
+
+#define ERROR(OUT, CODE) do { \
+    log_record(LOG_LVL_ERROR, OUT, CODE); \
+}while(0);
+
+#define WARNING(OUT, CODE) do { \
+    log_record(LOG_LVL_WARNING, OUT, CODE); \
+}while(0);
+
+#define INFO(OUT) do { \
+    log_record(LOG_LVL_INFO, OUT, NULL); \
+}while(0);
+
+#define DEBUG(OUT) do { \
+    log_record(LOG_LVL_DEBUG, OUT, NULL); \
+}while(0);
+
+/*
+ * ############################################################
+ * #######   LOGGER
+ * ############################################################
+ */
+
+void log_init(void);
+void log_record(int level, const char *out, const char *code);
+
+int log_set_fd(int fd);
+int log_get_fd(void);
+void log_set_level(int level);
+int log_get_level(void);
+void log_set_format(int format);
+int log_get_format(void);
+void log_set_prefix(int prefix);
+int log_get_prefix(void);
+void log_set_color(int color);
+
+int log_level_from_name(const char *name);
+const char* log_level_name(int level);
+
+#endif // DEF_LOG_H
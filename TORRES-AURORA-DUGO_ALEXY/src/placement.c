@@ -0,0 +1,348 @@
+// Needed for CPU affinity and SCHED_BATCH
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+
+// HEADER
+#include "placement.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   PARSING
+ * ############################################################
+ */
+
+struct rlimit_name {
+    char *name;
+    int resource;
+}; // struct rlimit_name
+
+static struct rlimit_name rlimit_names[] = {
+    {"as", RLIMIT_AS},
+    {"core", RLIMIT_CORE},
+    {"cpu", RLIMIT_CPU},
+    {"data", RLIMIT_DATA},
+    {"fsize", RLIMIT_FSIZE},
+    {"memlock", RLIMIT_MEMLOCK},
+    {"nofile", RLIMIT_NOFILE},
+    {"nproc", RLIMIT_NPROC},
+    {"stack", RLIMIT_STACK},
+    {NULL, 0}
+}; // static struct rlimit_name rlimit_names[]
+
+// Parse "0-3,8,10-11" into the placement CPU list
+static int parse_cpu_list(struct placement *place, const char *list)
+{
+    const char *cur = list;
+    place->cpu_count = 0;
+
+    while(*cur)
+    {
+        char *end;
+        long first = strtol(cur, &end, 10);
+        long last = first;
+        if(end == cur || first < 0)
+            return -1;
+        if(*end == '-')
+        {
+            cur = end + 1;
+            last = strtol(cur, &end, 10);
+            if(end == cur || last < first)
+                return -1;
+        }
+        for(; first <= last; ++first)
+        {
+            if(place->cpu_count == PLACEMENT_CPU_MAX || first >= CPU_SETSIZE)
+                return -1;
+            place->cpus[place->cpu_count++] = first;
+        }
+        if(*end == ',')
+            ++end;
+        else if(*end != '\0')
+            return -1;
+        cur = end;
+    }
+    return place->cpu_count > 0 ? 0 : -1;
+} // int parse_cpu_list(struct placement*, const char*)
+
+// Parse "nofile=1024" or "cpu=unlimited"
+static int parse_rlimit(struct placement *place, char *spec)
+{
+    char *value = strchr(spec, '=');
+    int i;
+
+    if(value == NULL || place->rlimit_count == PLACEMENT_RLIMIT_MAX)
+        return -1;
+
+    for(i = 0; rlimit_names[i].name; ++i)
+    {
+        if(strncmp(spec, rlimit_names[i].name, value - spec) == 0
+           && rlimit_names[i].name[value - spec] == '\0')
+            break;
+    }
+    if(rlimit_names[i].name == NULL)
+        return -1;
+
+    ++value;
+    rlim_t limit;
+    if(strcmp(value, "unlimited") == 0)
+        limit = RLIM_INFINITY;
+    else
+    {
+        char *end;
+        limit = strtoull(value, &end, 10);
+        if(end == value || *end != '\0')
+            return -1;
+    }
+
+    place->rlimit_resources[place->rlimit_count] = rlimit_names[i].resource;
+    place->rlimit_values[place->rlimit_count] = limit;
+    ++place->rlimit_count;
+    return 0;
+} // int parse_rlimit(struct placement*, char*)
+
+static const char* rlimit_name(int resource)
+{
+    int i;
+    for(i = 0; rlimit_names[i].name; ++i)
+    {
+        if(rlimit_names[i].resource == resource)
+            return rlimit_names[i].name;
+    }
+    return "?";
+} // const char* rlimit_name(int)
+
+/*
+ * ############################################################
+ * #######   PLACEMENT
+ * ############################################################
+ */
+
+void placement_clear(struct placement *place)
+{
+    place->cpu_count = 0;
+    place->per_stage = 0;
+    place->pipeline = 0;
+    place->has_nice = 0;
+    place->nice = 0;
+    place->batch = 0;
+    place->rlimit_count = 0;
+} // placement_clear(struct placement*)
+
+int placement_is_empty(const struct placement *place)
+{
+    return place->cpu_count == 0 && !place->per_stage && !place->has_nice
+           && !place->batch && place->rlimit_count == 0;
+} // int placement_is_empty(const struct placement*)
+
+/*
+ * Parse placement options, stops at the first non option argument.
+ * Returns the number of arguments consumed or -1 on error.
+ */
+int placement_parse(struct placement *place, int argc, char **argv)
+{
+    int i;
+    for(i = 0; i < argc; ++i)
+    {
+        char *opt = argv[i];
+
+        if(strcmp(opt, "--") == 0)
+            return i + 1;
+        if(opt[0] != '-' || opt[1] == '\0' || opt[2] != '\0')
+            return i;
+
+        switch(opt[1])
+        {
+            case 'r':
+                // Round robin on stages implies the whole pipeline
+                place->per_stage = 1;
+                place->pipeline = 1;
+                break;
+            case 'p':
+                place->pipeline = 1;
+                break;
+            case 'b':
+                place->batch = 1;
+                break;
+            case 'c':
+                if(i + 1 >= argc || parse_cpu_list(place, argv[++i]) == -1)
+                {
+                    ERROR("Invalid CPU list", i < argc ? argv[i] : "\n");
+                    return -1;
+                }
+                break;
+            case 'n':
+                if(i + 1 >= argc)
+                {
+                    ERROR("Missing nice value", "\n");
+                    return -1;
+                }
+                place->has_nice = 1;
+                place->nice = atoi(argv[++i]);
+                break;
+            case 'l':
+                if(i + 1 >= argc || parse_rlimit(place, argv[++i]) == -1)
+                {
+                    ERROR("Invalid resource limit", i < argc ? argv[i] : "\n");
+                    return -1;
+                }
+                break;
+            default:
+                return i;
+        }
+    }
+    return i;
+} // int placement_parse(struct placement*, int, char**)
+
+// Fields set in src override the ones of dest
+void placement_merge(struct placement *dest, const struct placement *src)
+{
+    int i;
+
+    if(src->cpu_count > 0)
+    {
+        memcpy(dest->cpus, src->cpus, sizeof(int) * src->cpu_count);
+        dest->cpu_count = src->cpu_count;
+        dest->per_stage = src->per_stage;
+    }
+    else if(src->per_stage)
+        dest->per_stage = 1;
+    if(src->has_nice)
+    {
+        dest->has_nice = 1;
+        dest->nice = src->nice;
+    }
+    if(src->batch)
+        dest->batch = 1;
+    for(i = 0; i < src->rlimit_count && dest->rlimit_count < PLACEMENT_RLIMIT_MAX; ++i)
+    {
+        dest->rlimit_resources[dest->rlimit_count] = src->rlimit_resources[i];
+        dest->rlimit_values[dest->rlimit_count] = src->rlimit_values[i];
+        ++dest->rlimit_count;
+    }
+} // placement_merge(struct placement*, const struct placement*)
+
+// Called in the child, failures are reported but the exec goes on
+void placement_apply(const struct placement *place, int stage)
+{
+    int i;
+
+    if(place->cpu_count > 0 || place->per_stage)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+
+        if(place->cpu_count > 0 && place->per_stage)
+        {
+            CPU_SET(place->cpus[stage % place->cpu_count], &set);
+        }
+        else if(place->cpu_count > 0)
+        {
+            for(i = 0; i < place->cpu_count; ++i)
+                CPU_SET(place->cpus[i], &set);
+        }
+        else
+        {
+            // Round robin on the CPUs the shell is allowed to use
+            cpu_set_t allowed;
+            int count = 0, target, cpu;
+            if(sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+            {
+                count = CPU_COUNT(&allowed);
+                target = stage % (count ? count : 1);
+                for(cpu = 0; cpu < CPU_SETSIZE && count; ++cpu)
+                {
+                    if(CPU_ISSET(cpu, &allowed) && target-- == 0)
+                    {
+                        CPU_SET(cpu, &set);
+                        break;
+                    }
+                }
+            }
+        }
+
+        if(CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == -1)
+        {
+            WARNING("Can't set CPU affinity", strerror(errno));
+        }
+    }
+
+    if(place->batch)
+    {
+        struct sched_param param;
+        param.sched_priority = 0;
+        if(sched_setscheduler(0, SCHED_BATCH, &param) == -1)
+        {
+            WARNING("Can't set SCHED_BATCH policy", strerror(errno));
+        }
+    }
+
+    if(place->has_nice && setpriority(PRIO_PROCESS, 0, place->nice) == -1)
+    {
+        WARNING("Can't set nice value", strerror(errno));
+    }
+
+    for(i = 0; i < place->rlimit_count; ++i)
+    {
+        struct rlimit limit;
+        if(getrlimit(place->rlimit_resources[i], &limit) == -1)
+            continue;
+
+        // The hard limit is left as is, raising it needs privileges
+        limit.rlim_cur = place->rlimit_values[i];
+        if(limit.rlim_max != RLIM_INFINITY
+           && (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > limit.rlim_max))
+        {
+            limit.rlim_cur = limit.rlim_max;
+            WARNING("Resource limit capped to the hard limit", rlimit_name(place->rlimit_resources[i]));
+        }
+        if(setrlimit(place->rlimit_resources[i], &limit) == -1)
+        {
+            WARNING("Can't set resource limit", strerror(errno));
+        }
+    }
+} // placement_apply(const struct placement*, int)
+
+void placement_print(const char *title, const struct placement *place)
+{
+    int i;
+
+    printf("%s:", title);
+    if(placement_is_empty(place))
+    {
+        printf(" none\n");
+        return;
+    }
+    if(place->cpu_count > 0)
+    {
+        printf(" cpus=");
+        for(i = 0; i < place->cpu_count; ++i)
+            printf("%s%d", i ? "," : "", place->cpus[i]);
+    }
+    if(place->per_stage)
+        printf(" round-robin");
+    if(place->has_nice)
+        printf(" nice=%d", place->nice);
+    if(place->batch)
+        printf(" batch");
+    for(i = 0; i < place->rlimit_count; ++i)
+    {
+        if(place->rlimit_values[i] == RLIM_INFINITY)
+            printf(" %s=unlimited", rlimit_name(place->rlimit_resources[i]));
+        else
+            printf(" %s=%llu", rlimit_name(place->rlimit_resources[i]),
+                   (unsigned long long)place->rlimit_values[i]);
+    }
+    printf("\n");
+} // placement_print(const char*, const struct placement*)
@@ -0,0 +1,38 @@
+#ifndef DEF_PLACEMENT_H
+#define DEF_PLACEMENT_H
+
+// SYSTEM INCLUDES
+#include <sys/resource.h>
+
+// Max CPUs in a placement list and max rlimits per placement
+#define PLACEMENT_CPU_MAX 1024
+#define PLACEMENT_RLIMIT_MAX 8
+
+/*
+ * ############################################################
+ * #######   PLACEMENT
+ * ############################################################
+ */
+
+// Where and how a child runs, applied after fork and before exec
+struct placement {
+    int cpus[PLACEMENT_CPU_MAX];        /* CPU list, empty means unchanged */
+    int cpu_count;
+    int per_stage;                      /* pin stage i to cpus[i % cpu_count] */
+    int pipeline;                       /* applies to the whole pipeline */
+    int has_nice;
+    int nice;
+    int batch;                          /* SCHED_BATCH policy */
+    int rlimit_count;
+    int rlimit_resources[PLACEMENT_RLIMIT_MAX];
+    rlim_t rlimit_values[PLACEMENT_RLIMIT_MAX];
+}; // struct placement
+
+void placement_clear(struct placement *place);
+int placement_is_empty(const struct placement *place);
+int placement_parse(struct placement *place, int argc, char **argv);
+void placement_merge(struct placement *dest, const struct placement *src);
+void placement_apply(const struct placement *place, int stage);
+void placement_print(const char *title, const struct placement *place);
+
+#endif // DEF_PLACEMENT_H
@@ -1,3 +1,6 @@
+// Needed for pipe2, splice and other Linux extensions
+#define _GNU_SOURCE
+
 // STD INCLUDES
 #include <stdlib.h>
 #include <stdio.h>
@@ -8,6 +11,7 @@
 #include <sys/types.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
@@ -28,18 +32,22 @@
 
 static void manage_signals()
 {
-    // Redirect SIGCHLD structure
+    // Redirect SIGCHLD structure, reads of the script restart after it
+    // since a partial line read by fgets would be lost on EINTR
     struct sigaction new_sigchld_action;
+    memset(&new_sigchld_action, 0, sizeof(new_sigchld_action));
     new_sigchld_action.sa_sigaction = &child_action;
-    new_sigchld_action.sa_flags = SA_SIGINFO;
+    new_sigchld_action.sa_flags = SA_SIGINFO | SA_RESTART;
 
     // Redirect SIGINT structure
     struct sigaction new_sigint_action;
+    memset(&new_sigint_action, 0, sizeof(new_sigint_action));
     new_sigint_action.sa_sigaction = &sigint_action;
     new_sigint_action.sa_flags = SA_SIGINFO;
 
     // Redirect SIGQUIT structure
     struct sigaction new_sigquit_action;
+    memset(&new_sigquit_action, 0, sizeof(new_sigquit_action));
     new_sigquit_action.sa_sigaction = &sigquit_action;
     new_sigquit_action.sa_flags = SA_SIGINFO;
 
@@ -61,6 +69,12 @@ static void manage_signals()
 
 static void reset_signals()
 {
+    // SIGCHLD may be blocked while launching commands
+    sigset_t chld_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_UNBLOCK, &chld_mask, NULL);
+
     // Reset the signals to their old action
     if(sigaction(SIGCHLD, &old_sigchld_action, NULL) == -1)
     {
@@ -78,22 +92,52 @@ static void reset_signals()
 
 static void child_action(int signum, siginfo_t *siginfo, void *context)
 {
-    // If the dead child is not the front process
-    // (Since front process death handling is done
-    // in the main loop)
-    if(siginfo->si_pid != wait_process)
+    int saved_errno = errno;
+
+    // Wake up the event loop, the main loop may be waiting in it
+    event_wakeup();
+
+    /*
+     * Children ending together raise a single SIGCHLD, every ended
+     * child is reaped but the front process, whose death handling is
+     * done in the main loop. The children behind it in the kernel list
+     * are left to reap_pending_children.
+     */
+    for(;;)
     {
+        siginfo_t ended;
         int status;
-        // Wait pid of child
-        if(waitpid(siginfo->si_pid, &status, 0) == -1)
+
+        ended.si_pid = 0;
+        if(waitid(P_ALL, 0, &ended, WEXITED | WNOHANG | WNOWAIT) == -1 || ended.si_pid == 0)
+            break;
+        if(ended.si_pid == wait_process)
         {
-            ERROR("Wait on pid.", strerror(errno));
+            reap_pending = TRUE;
+            break;
         }
+        // Already reaped by a caller waiting for its own children
+        if(waitpid(ended.si_pid, &status, WNOHANG) != ended.si_pid)
+            break;
+        jobs_reaped(ended.si_pid, status);
+        tasks_reaped(ended.si_pid, status);
     }
+    errno = saved_errno;
 } // child_action(int, iginfo_t*, void*)
 
 static void sigint_action(int signum, siginfo_t *siginfo, void *context)
 {
+    // Running loops stop, an unfinished construct is dropped
+    control_interrupt();
+
+    // A command with a deadline is not in the group of the terminal
+    if(front_group > 0)
+        kill(-front_group, SIGINT);
+
+    // The line editor drops the line and redraws the prompt itself
+    if(editor_cancel())
+        return;
+
     if(no_prompt)
     {
         fputs("\n", stdout);
@@ -130,101 +174,140 @@ static int builtin_pwd(int argc, char **argv)
         return EXIT_FAILURE;
     }
 
-    // Update wd value (in case it was modified by an other process)
-    if(getcwd(wd, PATH_MAX) == NULL)
-    {
-        ERROR("Getting current directory", strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    // Display current working directory
-    printf("%s\n", wd);
-
-    // Makes wd more "readable"
-    clean_path(wd);
-
+    // The logical path is kept up to date by cd
+    printf("%s\n", dirs_pwd());
     return EXIT_SUCCESS;
 } // int builtin_pwd(int, char**)
 
+// Prompt path and stat cache follow the working directory
+static void update_wd(void)
+{
+    // A script may cd many times without ever showing a prompt
+    wd_stale = TRUE;
+    condition_chdir();
+} // update_wd()
+
 static int builtin_cd(int argc, char **argv)
 {
+    const char *path = argc == 2 ? argv[1] : getenv("HOME");
+
     // If there are more than one argument, can't process that
-    if(argc != 2)
+    if(argc > 2 || path == NULL)
     {
-        ERROR("Usage is : cd <path>", "\n");
+        ERROR("Usage is : cd [path | -]", "\n");
         return EXIT_FAILURE;
     }
 
-    // Moving directory
-    if(chdir(argv[1]) != 0)
+    // cd - goes back and prints where, like sh
+    if(strcmp(path, "-") == 0 && (path = vars_get("OLDPWD")) == NULL)
     {
-        ERROR("Moving directory", strerror(errno));
+        ERROR("cd", "OLDPWD not set");
         return EXIT_FAILURE;
     }
-    
-    // Getting current directory
-    if(getcwd(wd, PATH_MAX) == NULL)
+
+    // Moving directory
+    if(dirs_cd(path) != 0)
     {
-        ERROR("Getting current directory", strerror(errno));
+        ERROR("Moving directory", strerror(errno));
         return EXIT_FAILURE;
     }
-
-    // Makes wd more "readable"
-    clean_path(wd);
+    update_wd();
+    if(argc == 2 && strcmp(argv[1], "-") == 0)
+        printf("%s\n", dirs_pwd());
 
     return EXIT_SUCCESS;
 } // int builtin_cd(int, char**)
 
-static int builtin_exec(int argc, char **argv)
+// Working directory then the stack, the home directory as ~
+static void print_dirs(void)
 {
-    // Used to redirect output
-    char file[PATH_MAX];
-    int redir = 0;
+    char path[PATH_MAX];
+    const char *dir;
+    size_t i;
 
-    // Get the right array of arguments to send
-    char *args[argc];
-    int i;    
-    for(i = 1; i < argc; ++i)
+    for(i = 0; (dir = dirs_get(i)) != NULL; ++i)
     {
-        // Search for the redirection sign
-        if(strcmp(argv[i], ">") == 0 && i < argc + 1)
-        {
-            strcpy(file, argv[i + 1]);
-            redir = 1;
-            break;
-        }
+        snprintf(path, PATH_MAX, "%s", dir);
+        clean_path(path);
+        printf(i == 0 ? "%s" : " %s", path);
+    }
+    printf("\n");
+} // print_dirs()
 
-        // Add arguments
-        args[i - 1] = malloc(sizeof(char) * strlen(argv[i]));
-        strcpy(args[i - 1], argv[i]);
-    }  
- 
-    args[argc - 1] = NULL;
+static int builtin_pushd(int argc, char **argv)
+{
+    if(argc > 2)
+    {
+        ERROR("Usage is : pushd [path]", "\n");
+        return EXIT_FAILURE;
+    }
+    if(argc == 1 && dirs_get(1) == NULL)
+    {
+        ERROR("pushd", "no other directory");
+        return EXIT_FAILURE;
+    }
+    if(dirs_push(argc == 2 ? argv[1] : NULL) == -1)
+    {
+        ERROR("pushd", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    update_wd();
+    print_dirs();
+    return EXIT_SUCCESS;
+} // int builtin_pushd(int, char**)
 
-    if(redir == 1)
+static int builtin_popd(int argc, char **argv)
+{
+    if(argc != 1)
     {
-        // Flush before redir
-        fflush(stdout);
+        ERROR("Usage is : popd", "\n");
+        return EXIT_FAILURE;
+    }
+    if(dirs_get(1) == NULL)
+    {
+        ERROR("popd", "directory stack empty");
+        return EXIT_FAILURE;
+    }
+    if(dirs_pop() == -1)
+    {
+        ERROR("popd", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    update_wd();
+    print_dirs();
+    return EXIT_SUCCESS;
+} // int builtin_popd(int, char**)
 
-        // File will be written atthe exit of the programm
-        int fd_out = open(file, O_RDWR|O_CREAT|O_APPEND, 0660);
-        if(fd_out == -1)
-        {
-            ERROR("Can't open redirection file.", strerror(errno));
-            return EXIT_FAILURE;
-        }
-        if(dup2(fd_out, fileno(stdout)) == -1)
-        {
-            ERROR("dup2 : can't redirect stdout to file.", strerror(errno));
-            return EXIT_FAILURE;
-        }
+static int builtin_dirs(int argc, char **argv)
+{
+    if(argc == 2 && strcmp(argv[1], "-c") == 0)
+    {
+        dirs_clear();
+        return EXIT_SUCCESS;
     }
-    
+    if(argc > 1)
+    {
+        ERROR("Usage is : dirs [-c]", "\n");
+        return EXIT_FAILURE;
+    }
+    print_dirs();
+    return EXIT_SUCCESS;
+} // int builtin_dirs(int, char**)
+
+static int builtin_exec(int argc, char **argv)
+{
+    // Redirections were already applied by run_command
+    if(argc < 2)
+    {
+        ERROR("Usage is : exec <command> [args]", "\n");
+        return EXIT_FAILURE;
+    }
+
     // Reset signals to default
     reset_signals();
 
     // Execute process
-    execvp(args[0], args);
+    execvp(argv[1], argv + 1);
 
     WARNING("Wrong command", strerror(errno));
 
@@ -249,238 +332,1318 @@ static int builtin_help(int argc, char **argv)
     return EXIT_SUCCESS;
 } // int builtin_help(int, char**)
 
-
-/*
- * ############################################################
- * ####### GENERAL
- * ############################################################
- */
-
-static void clean_path(char *wd)
+static int builtin_log(int argc, char **argv)
 {
-    char homePath[PATH_MAX] = "/home/";
-    strcat(homePath, username);
+    int i;
 
-    // Search for the home directory pattern to replace it whith ~
-    char resulting_path[PATH_MAX];
-    char partial[PATH_MAX];
-    unsigned int i;
-    for(i = 0; i < strlen(wd) && i < PATH_MAX - 1; ++i)
+    // Without arguments, display the current configuration
+    if(argc == 1)
     {
-        partial[i] = wd[i];
-        partial[i + 1] = '\0';
-        if(strcmp(partial, homePath) == 0)
-        {
-            resulting_path[0] = '~';
-            unsigned int j;
-            unsigned int p = 1;
-            for(j = i + 1; j < strlen(wd); ++j)
-            {
-                resulting_path[p] = wd[j];
-                ++p;
-            }
-            resulting_path[p] = '\0';
-            strcpy(wd, resulting_path); 
-            break;
-        }
-    }   
-} // clean_path(char*)
+        char prefix[16] = "";
+        if(log_get_prefix() & LOG_PREFIX_TIME)
+            strcat(prefix, "time ");
+        if(log_get_prefix() & LOG_PREFIX_PID)
+            strcat(prefix, "pid ");
+        printf("level\t%s\n", log_level_name(log_get_level()));
+        printf("fd\t%d\n", log_get_fd());
+        printf("format\t%s\n", log_get_format() == LOG_FORMAT_JSON ? "json" : "text");
+        printf("prefix\t%s\n", prefix[0] ? prefix : "none");
+        return EXIT_SUCCESS;
+    }
 
-static void get_user_machine_name(char *name)
-{
-    char *result;
-    char hostname[1024];
-    uid_t uid = geteuid();
-    // Get the user informations
-    struct passwd *pw = getpwuid(uid);
-    if (pw)
+    for(i = 1; i < argc; ++i)
     {
-        result = pw->pw_name;
-        strcpy(username, result);
-        strcat(result, "@");
-        size_t len = 1024;
-        // Get the hostname
-        if(gethostname(hostname, len) == 0)
+        // Options without value
+        if(strcmp(argv[i], "-j") == 0)
         {
-            strcat(result, hostname);
-            strcat(result, ":");
-            strcpy(name, result);
+            log_set_format(LOG_FORMAT_JSON);
+            continue;
         }
-    
-    }
-} // get_user_machine_name(char*)
-
-static int get_command(FILE * source, char *command)
-{
-    if (source == stdin) {
-        char *white = "\033[0m";
-        char *color = "\033[32m";
-
-        fputs(color, stdout);
-        fputs(user_machine_name, stdout);
-        fputs(white, stdout);
-        fputs(wd, stdout);
-        fputs(prompt_str, stdout);
-    }
-    
-    no_prompt = TRUE;
-    if (!fgets(command, BUFSIZ - 2, source)) {        
-        if (source == stdin && errno != 4)
+        if(strcmp(argv[i], "-t") == 0)
         {
-            printf("\n");
-            return 1;
+            log_set_format(LOG_FORMAT_TEXT);
+            continue;
         }
-        // Manage parralels process, to be cleaned, this is not a good way
-        // TODO ASK in practical
-        no_prompt = TRUE;
-        while(!fgets(command, BUFSIZ - 2, source) && errno == 4);
-    }
-    no_prompt = FALSE;
-    return EXIT_SUCCESS;
-} // int get_command(FILE*, char*)
 
-/*static int expand_arguments(char *command)
-{
-    char *saved_ptr = NULL;
-    char resulting_command[PATH_MAX];
-    char *token = strtok_r(command, " ", &saved_ptr);
-    char *next_tokens = strtok_r(NULL, "", &saved_ptr);
-    resulting_command[0] = '\0';
-    do
-    {       
-        if(token[strlen(token) - 1] == '\n')
-            token[strlen(token) - 1] = '\0';
+        if(i + 1 >= argc)
+        {
+            ERROR("Usage is : log [-l level] [-f fd] [-j|-t] [-p time,pid|none] [-c auto|never]", "\n");
+            return EXIT_FAILURE;
+        }
 
-        // If token is not *
-        if(strcmp(token, "*") != 0)
+        char *value = argv[++i];
+        if(strcmp(argv[i - 1], "-l") == 0)
         {
-            strcat(resulting_command, token);
-            strcat(resulting_command," ");
+            int level = log_level_from_name(value);
+            if(level == -1)
+            {
+                ERROR("Unknown log level", value);
+                return EXIT_FAILURE;
+            }
+            log_set_level(level);
         }
-        else
+        else if(strcmp(argv[i - 1], "-f") == 0)
         {
-            DIR *current_dir = opendir(wd);
-            struct dirent *entry;
-
-            while((entry = readdir(current_dir)))
+            if(log_set_fd(atoi(value)) == -1)
             {
-                if(entry->d_name[0] != '.')
-                {
-                    strcat(resulting_command, entry->d_name);
-                    strcat(resulting_command, " ");
-                }
-            }   
+                ERROR("Invalid log file descriptor", strerror(errno));
+                return EXIT_FAILURE;
+            }
         }
-
-        if(next_tokens != NULL)
+        else if(strcmp(argv[i - 1], "-p") == 0)
         {
-            token = strtok_r(next_tokens, " ", &saved_ptr);
-            next_tokens = strtok_r(NULL, "", &saved_ptr);
+            int prefix = 0;
+            if(strstr(value, "time"))
+                prefix |= LOG_PREFIX_TIME;
+            if(strstr(value, "pid"))
+                prefix |= LOG_PREFIX_PID;
+            log_set_prefix(prefix);
+        }
+        else if(strcmp(argv[i - 1], "-c") == 0)
+        {
+            log_set_color(strcmp(value, "never") == 0 ? LOG_COLOR_NEVER : LOG_COLOR_AUTO);
         }
         else
-            token = NULL;
-
-    } while(token != NULL);
-    
-    strcpy(command, resulting_command);
-
-    return TRUE;
-} // int expand_arguments(char*)*/
+        {
+            ERROR("Unknown log option", argv[i - 1]);
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+} // int builtin_log(int, char**)
 
-static int expand_arguments2(char *command)
+static int builtin_cat(int argc, char **argv)
 {
-    char *saved_ptr = NULL;
-    char resulting_command[PATH_MAX];
-    char *token = strtok_r(command, " ", &saved_ptr);
-    char *next_tokens = strtok_r(NULL, "", &saved_ptr);
-    resulting_command[0] = '\0';
-    
-    // Browse the command    
-    do
-    {       
-        if(token[strlen(token) - 1] == '\n')
-            token[strlen(token) - 1] = '\0';
+    int out = fileno(stdout);
+    int ret = EXIT_SUCCESS;
+    struct stat out_stat;
+    int i;
+
+    fflush(stdout);
+
+    // copy_file_range refuses O_APPEND, emulate it with the offset
+    int flags = fcntl(out, F_GETFL);
+    int append = flags != -1 && (flags & O_APPEND) && fstat(out, &out_stat) == 0
+                 && S_ISREG(out_stat.st_mode);
+    if(append)
+    {
+        lseek(out, 0, SEEK_END);
+        fcntl(out, F_SETFL, flags & ~O_APPEND);
+    }
 
-        // If token is not *
-        if(strcmp(token, "*") != 0)
+    for(i = 1; i < argc || (argc == 1 && i == 1); ++i)
+    {
+        int in = fileno(stdin);
+        if(i < argc && strcmp(argv[i], "-") != 0)
         {
-            strcat(resulting_command, token);
-            strcat(resulting_command," ");
+            in = open(argv[i], O_RDONLY | O_CLOEXEC);
+            if(in == -1)
+            {
+                ERROR(argv[i], strerror(errno));
+                ret = EXIT_FAILURE;
+                continue;
+            }
         }
-        else
+
+        // Ctrl-C stops a read from stdin, a FIFO or a terminal
+        long long copied;
+        while((copied = copy_fd(in, out, NULL)) == -1 && errno == EINTR)
         {
-            // Get pattern replacement
-            glob_t glob_result;
-            int ret;
-            if((ret = glob("*", GLOB_TILDE, NULL, &glob_result)) != 0)
+            if(control_take_interrupt())
             {
-                ERROR("Glob pattern math.", "Can't continue");
-                return FALSE;
-            }  
-            unsigned int i;
-            for(i = 0; i < glob_result.gl_pathc; ++i)
-            {
-                strcat(resulting_command, glob_result.gl_pathv[i]);
-                strcat(resulting_command, " ");
+                ret = 128 + SIGINT;
+                break;
             }
-            globfree(&glob_result);
         }
-
-        // Manage end of the command
-        if(next_tokens != NULL)
+        if(copied == -1 && ret != 128 + SIGINT)
         {
-            token = strtok_r(next_tokens, " ", &saved_ptr);
-            next_tokens = strtok_r(NULL, "", &saved_ptr);
+            ERROR("cat : copy failed", strerror(errno));
+            ret = EXIT_FAILURE;
         }
-        else
-            token = NULL;
-
-    } while(token != NULL);
-    
-    strcpy(command, resulting_command);
-    return TRUE;
-} // int expand_arguments2(char*)
 
-static char** get_background_commands(char *command, int *has_background, int *has_last, int *commands_count)
-{
-    char **background = malloc(sizeof(char*));
-    int background_mem = 1;
+        if(in != fileno(stdin))
+            close(in);
+        if(ret == 128 + SIGINT)
+            break;
+    }
 
-    *commands_count = 0;
+    if(append)
+        fcntl(out, F_SETFL, flags);
 
-    strcat(command, " ");
+    return ret;
+} // int builtin_cat(int, char**)
 
-    char *saved_ptr = NULL;
-    char *cur_command = strtok_r(command, "&", &saved_ptr);
-    char *next_commands = strtok_r(NULL, "", &saved_ptr);
+static int builtin_history(int argc, char **argv)
+{
+    long count = history_count();
+    long first = 0, i;
 
-    // Manage commang, we didn"t find any &
-    if(next_commands == NULL)
+    if(argc == 1 || (argc == 2 && argv[1][0] != '-'))
     {
-        *commands_count = 1;
-        // If the last, so is a front command
-        *has_last = TRUE;
-        *has_background = FALSE;
-        background[0] = command;
-        return background;
+        // Last N entries
+        if(argc == 2)
+        {
+            long last = atol(argv[1]);
+            if(last < count)
+                first = count - last;
+        }
+        for(i = first; i < count; ++i)
+            printf("%6ld  %s\n", i + 1, history_get(i));
+        return EXIT_SUCCESS;
     }
 
-    *has_background = TRUE;
-    *has_last = FALSE;
-
-    background[0] = malloc(sizeof(char) * (strlen(cur_command) + 1));
-    strcpy(background[0], cur_command);
-    background[0][strlen(cur_command)] = '\0';
-    ++*commands_count;
-    
-    int i = 1;
-    // Browse the command
-    do
+    if(strcmp(argv[1], "-c") == 0)
     {
-        // f this is the last command and should not be processed in background
-        if(strcmp(next_commands, " ") == 0)
+        if(history_clear() == -1)
         {
-            *has_last = FALSE;
+            ERROR("Can't clear history", strerror(errno));
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if(argc != 3)
+    {
+        ERROR("Usage is : history [N] | -c | -s pattern | -m max | -r file", "\n");
+        return EXIT_FAILURE;
+    }
+
+    if(strcmp(argv[1], "-s") == 0)
+    {
+        // Newest first, like the reverse search
+        long found = -1;
+        while((found = history_search(argv[2], found)) != -1)
+            printf("%6ld  %s\n", found + 1, history_get(found));
+        return EXIT_SUCCESS;
+    }
+    if(strcmp(argv[1], "-m") == 0)
+    {
+        if(history_set_max(atol(argv[2])) == -1)
+        {
+            ERROR("Invalid history size", argv[2]);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if(strcmp(argv[1], "-r") == 0)
+    {
+        // Import a plain text file, one command per line
+        FILE *file = fopen(argv[2], "re");
+        char line[BUFSIZ];
+        if(file == NULL)
+        {
+            ERROR(argv[2], strerror(errno));
+            return EXIT_FAILURE;
+        }
+        while(fgets(line, sizeof(line), file) != NULL)
+        {
+            line[strcspn(line, "\n")] = '\0';
+            history_add(line);
+        }
+        fclose(file);
+        return EXIT_SUCCESS;
+    }
+
+    ERROR("Unknown history option", argv[1]);
+    return EXIT_FAILURE;
+} // int builtin_history(int, char**)
+
+static int builtin_let(int argc, char **argv)
+{
+    long long result = 0;
+    int i;
+
+    if(argc < 2)
+    {
+        ERROR("Usage is : let expression [expression ...]", "\n");
+        return EXIT_FAILURE;
+    }
+
+    for(i = 1; i < argc; ++i)
+    {
+        if(arith_eval(argv[i], strlen(argv[i]), &result) == -1)
+        {
+            ERROR("let", arith_error());
+            return EXIT_FAILURE;
+        }
+    }
+    return result != 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+} // int builtin_let(int, char**)
+
+// local name[=value] ..., restored when the function returns
+static int builtin_local(int argc, char **argv)
+{
+    char name[256];
+    int i, ret = EXIT_SUCCESS;
+
+    for(i = 1; i < argc; ++i)
+    {
+        char *equal = strchr(argv[i], '=');
+        size_t len = equal != NULL ? (size_t)(equal - argv[i]) : strlen(argv[i]);
+        if(!vars_is_name(argv[i], len) || len >= sizeof(name))
+        {
+            ERROR("local : not a valid name", argv[i]);
+            ret = EXIT_FAILURE;
+            continue;
+        }
+        memcpy(name, argv[i], len);
+        name[len] = '\0';
+
+        if(vars_local(name) == -1)
+        {
+            ERROR("local", "can only be used in a function");
+            return EXIT_FAILURE;
+        }
+        if(equal != NULL)
+            vars_set(name, equal + 1);
+    }
+    return ret;
+} // int builtin_local(int, char**)
+
+static int builtin_stats(int argc, char **argv)
+{
+    if(argc == 2 && strcmp(argv[1], "-r") == 0)
+    {
+        stats_reset();
+        return EXIT_SUCCESS;
+    }
+    if(argc > 1)
+    {
+        ERROR("Usage is : stats [-r]", "\n");
+        return EXIT_FAILURE;
+    }
+    stats_print(stdout);
+    return EXIT_SUCCESS;
+} // int builtin_stats(int, char**)
+
+// cached [-c] : prints the result cache, or clears it
+static int builtin_cached(int argc, char **argv)
+{
+    cache_configure(vars_get(CACHE_DIR_VAR), vars_get_int(CACHE_SIZE_VAR));
+    if(argc == 2 && strcmp(argv[1], "-c") == 0)
+        return cache_clear() == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+    if(argc > 1)
+    {
+        ERROR("Usage is : cached [-c] or cached [-m] [-e NAME] [-i path... --] command", "\n");
+        return EXIT_FAILURE;
+    }
+    cache_print(stdout);
+    return EXIT_SUCCESS;
+} // int builtin_cached(int, char**)
+
+// inotify events, the command runs again once they stop for a while
+static void watch_changed(int fd, short revents, void *data)
+{
+    if(watch_read() > 0)
+        *(int*)data = TRUE;
+} // watch_changed(int, short, void*)
+
+/*
+ * Runs line in a forked shell leading its own process group, so a
+ * cancelled run takes its whole pipeline with it. A waited process is
+ * left to the caller, child_action reaps the others.
+ */
+static pid_t start_group(const char *line, int waited)
+{
+    sigset_t chld_mask, old_mask;
+    pid_t process;
+
+    fflush(stdout);
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+
+    process = fork();
+    if(process == 0)
+    {
+        char command[BUFSIZ];
+        struct sigaction chld_action;
+
+        setpgid(0, 0);
+        reset_signals();
+
+        // Waits for its own commands like a function in a pipeline
+        memset(&chld_action, 0, sizeof(chld_action));
+        chld_action.sa_sigaction = &child_action;
+        chld_action.sa_flags = SA_SIGINFO | SA_RESTART;
+        event_reset();
+        jobs_reset();
+        sigaction(SIGCHLD, &chld_action, NULL);
+
+        // line may be a task command, kept until the table is dropped
+        snprintf(command, BUFSIZ - 2, "%s", line);
+        tasks_free();
+        int ret = launch_line(command, FALSE);
+        fflush(stdout);
+        exit(ret);
+    }
+    if(process == -1)
+    {
+        ERROR("Can't fork process.", strerror(errno));
+    }
+    else
+    {
+        setpgid(process, process);
+        if(waited)
+            wait_process = process;
+        stats_add(STATS_FORKS);
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    return process;
+} // pid_t start_group(const char*, int)
+
+// SIGTERM to the run, SIGKILL if it is still there after the grace time
+static void cancel_watched(pid_t process)
+{
+    long long end = watch_now() + WATCH_KILL_GRACE_MS;
+    int status;
+
+    kill(-process, SIGTERM);
+    while(waitpid(process, &status, WNOHANG) == 0)
+    {
+        long long left = end - watch_now();
+        if(left <= 0)
+        {
+            kill(-process, SIGKILL);
+            waitpid(process, &status, 0);
+            break;
+        }
+        // SIGCHLD wakes the event loop up
+        event_poll((int)left);
+    }
+    wait_process = -1;
+} // cancel_watched(pid_t)
+
+// Time between SIGTERM and SIGKILL of a command past its deadline
+static long long deadline_grace(void)
+{
+    long long grace = deadline_parse(vars_get(DEADLINE_GRACE_VAR));
+
+    return grace >= 0 ? grace : DEADLINE_GRACE_MS;
+} // long long deadline_grace()
+
+/*
+ * Waits for the front process, leader of front_group or in it, with a
+ * deadline of limit ms. Returns its status, DEADLINE_STATUS when the
+ * deadline hit.
+ */
+static int wait_deadline(pid_t process, long long limit, long long grace)
+{
+    int status, expired;
+
+    expired = deadline_wait(process, front_group > 0 ? front_group : process, limit, grace, &status);
+    if(expired == -1 && event_wait_pid(process, &status) != process)
+        status = EXIT_FAILURE << 8;
+    wait_process = -1;
+    front_group = -1;
+    if(expired == 1)
+    {
+        stats_add(STATS_TIMEOUTS);
+        WARNING("Command timed out", "deadline reached");
+        return DEADLINE_STATUS;
+    }
+    return exit_status(status);
+} // int wait_deadline(pid_t, long long, long long)
+
+/*
+ * watch [-d ms] [-n runs] path ... -- command : runs command, then again
+ * once the changes in the paths stop for ms. Directories are watched
+ * with their subdirectories, paths may be globs. A run still going
+ * when changes come is cancelled. Ends after runs complete runs or on
+ * Ctrl-C, with the status of the last run. A pipeline goes in a
+ * function, | would end the command of watch.
+ */
+static int builtin_watch(int argc, char **argv)
+{
+    char line[BUFSIZ] = "";
+    long debounce = WATCH_DEBOUNCE_MS, runs = -1, done = 0;
+    long long deadline = 0;
+    int i, first = 1, separator, changed = FALSE, pending = FALSE;
+    int status = EXIT_SUCCESS;
+    pid_t process;
+
+    for(; first + 1 < argc && argv[first][0] == '-' && argv[first][1] != '-'; first += 2)
+    {
+        if(strcmp(argv[first], "-d") == 0)
+            debounce = atol(argv[first + 1]);
+        else if(strcmp(argv[first], "-n") == 0)
+            runs = atol(argv[first + 1]);
+        else
+            break;
+    }
+    for(separator = first; separator < argc && strcmp(argv[separator], "--") != 0; ++separator);
+    if(separator == first || separator + 1 >= argc || debounce < 0)
+    {
+        ERROR("Usage is : watch [-d ms] [-n runs] path ... -- command", "\n");
+        return EXIT_FAILURE;
+    }
+
+    int fd = watch_open();
+    if(fd == -1)
+    {
+        ERROR("watch : inotify", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    for(i = first; i < separator; ++i)
+    {
+        glob_t matches;
+        size_t match;
+        if(dirs_glob(argv[i], GLOB_NOCHECK, &matches) != 0)
+            continue;
+        for(match = 0; match < matches.gl_pathc; ++match)
+        {
+            if(watch_add(matches.gl_pathv[match]) == -1)
+            {
+                ERROR(matches.gl_pathv[match], strerror(errno));
+                status = EXIT_FAILURE;
+            }
+        }
+        globfree(&matches);
+    }
+    if(status != EXIT_SUCCESS || event_add(fd, POLLIN, watch_changed, &changed) == -1)
+    {
+        watch_close();
+        return EXIT_FAILURE;
+    }
+
+    for(i = separator + 1; i < argc; ++i)
+    {
+        strncat(line, argv[i], sizeof(line) - strlen(line) - 2);
+        strcat(line, " ");
+    }
+
+    control_take_interrupt();
+    process = start_group(line, TRUE);
+    for(;;)
+    {
+        int wait_status;
+        if(process > 0 && waitpid(process, &wait_status, WNOHANG) == process)
+        {
+            status = exit_status(wait_status);
+            wait_process = -1;
+            process = -1;
+            if(runs >= 0 && ++done >= runs)
+                break;
+        }
+        if(control_take_interrupt())
+        {
+            status = 128 + SIGINT;
+            break;
+        }
+        if(changed)
+        {
+            // Every change of a burst pushes the run back
+            changed = FALSE;
+            pending = TRUE;
+            deadline = watch_now() + debounce;
+        }
+
+        int timeout = -1;
+        if(pending)
+        {
+            long long left = deadline - watch_now();
+            if(left <= 0)
+            {
+                pending = FALSE;
+                if(process > 0)
+                    cancel_watched(process);
+                process = start_group(line, TRUE);
+                continue;
+            }
+            timeout = (int)left;
+        }
+        // Nothing to do until a change, a child or a signal
+        event_poll(timeout);
+    }
+
+    if(process > 0)
+        cancel_watched(process);
+    event_remove(fd);
+    watch_close();
+    return status;
+} // int builtin_watch(int, char**)
+
+/*
+ * jobs [-m off|line|hold] : lists the captured background jobs, or sets
+ * how the output of the next ones is captured. line writes their
+ * complete lines as they come, hold when the job ends, both prefixed
+ * with the job id.
+ */
+static int builtin_jobs(int argc, char **argv)
+{
+    if(argc == 3 && strcmp(argv[1], "-m") == 0)
+    {
+        if(jobs_set_mode(argv[2]) == -1)
+        {
+            ERROR("jobs : unknown mode", argv[2]);
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+    if(argc > 1)
+    {
+        ERROR("Usage is : jobs [-m off|line|hold]", "\n");
+        return EXIT_FAILURE;
+    }
+    jobs_update();
+    printf("output : %s\n", jobs_mode_name());
+    jobs_print(stdout);
+    return EXIT_SUCCESS;
+} // int builtin_jobs(int, char**)
+
+// Runs the event loop until every background job has ended
+static int builtin_wait(int argc, char **argv)
+{
+    // Ended jobs already reported by the prompt count too
+    while(jobs_update() > 0 || has_pending_jobs())
+    {
+        if(control_take_interrupt())
+            return 128 + SIGINT;
+        // SIGCHLD and job output wake the event loop up
+        if(event_poll(-1) == -1)
+            return EXIT_FAILURE;
+    }
+    return jobs_failed() > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+} // int builtin_wait(int, char**)
+
+/*
+ * tasks [-j jobs] [-k] [-t trace] file : runs the tasks of file, lines
+ * "name [dependency ...] : command", each one as soon as its
+ * dependencies succeeded and at most jobs at a time, the online CPUs by
+ * default. The first failure cancels the running tasks, with -k only
+ * what depends on it is skipped. Prints the critical path of the run,
+ * -t writes its Chrome trace.
+ */
+static int builtin_tasks(int argc, char **argv)
+{
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    long long deadline = 0;
+    int i, keep_going = FALSE, stopped = FALSE, killed = FALSE, status = EXIT_SUCCESS;
+    const char *trace = NULL;
+
+    for(i = 1; i < argc && argv[i][0] == '-'; ++i)
+    {
+        if(strcmp(argv[i], "-k") == 0)
+            keep_going = TRUE;
+        else if(strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            jobs = atol(argv[++i]);
+        else if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+            trace = argv[++i];
+        else
+            break;
+    }
+    if(i + 1 != argc || jobs < 1)
+    {
+        ERROR("Usage is : tasks [-j jobs] [-k] [-t trace] file", "\n");
+        return EXIT_FAILURE;
+    }
+    if(jobs > TASKS_JOBS_MAX)
+        jobs = TASKS_JOBS_MAX;
+    if(tasks_load(argv[i]) == -1)
+        return EXIT_FAILURE;
+
+    control_take_interrupt();
+    for(;;)
+    {
+        // Children ending together may have raised a single SIGCHLD
+        has_pending_jobs();
+        int task, running = tasks_update();
+        if(!stopped && control_take_interrupt())
+        {
+            status = 128 + SIGINT;
+            stopped = TRUE;
+        }
+        if(!stopped && !keep_going && tasks_failed() > 0)
+            stopped = TRUE;
+        if(stopped && running > 0 && deadline == 0)
+        {
+            tasks_kill(SIGTERM);
+            deadline = watch_now() + WATCH_KILL_GRACE_MS;
+        }
+
+        // Ready tasks fill the free slots
+        int forked = TRUE;
+        while(!stopped && running < jobs && (task = tasks_next()) != -1)
+        {
+            pid_t process = start_group(tasks_command(task), FALSE);
+            tasks_started(task, process);
+            if(process == -1)
+            {
+                forked = FALSE;
+                break;
+            }
+            ++running;
+        }
+        // A task which could not start has ended already
+        if(!forked)
+            continue;
+        if(running == 0)
+            break;
+
+        int timeout = -1;
+        if(deadline != 0 && !killed)
+        {
+            long long left = deadline - watch_now();
+            if(left <= 0)
+            {
+                tasks_kill(SIGKILL);
+                killed = TRUE;
+            }
+            else
+                timeout = (int)left;
+        }
+        // SIGCHLD wakes the event loop up
+        event_poll(timeout);
+    }
+
+    tasks_report(stdout);
+    if(trace != NULL && tasks_trace(trace) == -1)
+    {
+        ERROR(trace, strerror(errno));
+        status = EXIT_FAILURE;
+    }
+    if(status == EXIT_SUCCESS && tasks_failed() > 0)
+        status = EXIT_FAILURE;
+    tasks_free();
+    return status;
+} // int builtin_tasks(int, char**)
+
+/*
+ * timeout [-k grace] duration command : runs command in a forked shell
+ * leading its own process group, which gets SIGTERM after duration and
+ * SIGKILL grace later (ASR2_TIMEOUT_GRACE by default). Durations are
+ * seconds or end with ms, s, m or h, 0 is no deadline. The status is
+ * 124 when the deadline hit. A pipeline goes in a function.
+ */
+static int builtin_timeout(int argc, char **argv)
+{
+    char line[BUFSIZ] = "";
+    long long limit, grace = deadline_grace();
+    int i = 1;
+
+    if(argc > 2 && strcmp(argv[1], "-k") == 0)
+    {
+        grace = deadline_parse(argv[2]);
+        i = 3;
+    }
+    if(i + 1 >= argc || grace < 0 || (limit = deadline_parse(argv[i])) < 0)
+    {
+        ERROR("Usage is : timeout [-k grace] duration command", "\n");
+        return EXIT_FAILURE;
+    }
+    for(++i; i < argc; ++i)
+    {
+        strncat(line, argv[i], sizeof(line) - strlen(line) - 2);
+        strcat(line, " ");
+    }
+
+    pid_t process = start_group(line, TRUE);
+    if(process == -1)
+        return EXIT_FAILURE;
+    if(limit == 0)
+    {
+        int status;
+        pid_t waited = event_wait_pid(process, &status);
+        wait_process = -1;
+        return waited == process ? exit_status(status) : EXIT_FAILURE;
+    }
+    front_group = process;
+    return wait_deadline(process, limit, grace);
+} // int builtin_timeout(int, char**)
+
+// Splits line on IFS into names, the last one gets the rest of the line
+static void assign_fields(char *line, int count, char **names)
+{
+    const char *ifs = vars_get("IFS");
+    char *field = line;
+    int i;
+
+    if(ifs == NULL)
+        ifs = " \t\n";
+    for(i = 0; i < count; ++i)
+    {
+        field += strspn(field, ifs);
+        if(i == count - 1)
+        {
+            // Trailing separators are not part of the rest
+            char *end = field + strlen(field);
+            while(end > field && strchr(ifs, end[-1]) != NULL)
+                --end;
+            *end = '\0';
+            vars_set(names[i], field);
+            break;
+        }
+        size_t len = strcspn(field, ifs);
+        char saved = field[len];
+        field[len] = '\0';
+        vars_set(names[i], field);
+        field[len] = saved;
+        field += len;
+    }
+} // assign_fields(char*, int, char**)
+
+/*
+ * read [-r] [name ...] : a line of stdin split into the names, REPLY
+ * without names. The input after the line is left for the commands
+ * reading stdin next, without reading it a byte at a time.
+ */
+static int builtin_read(int argc, char **argv)
+{
+    static struct input_buffer line = {NULL, 0, 0};
+    static struct input_buffer more = {NULL, 0, 0};
+    int in = fileno(stdin);
+    int method = input_method(in);
+    int raw = FALSE, first = 1, i, got;
+
+    if(argc > 1 && strcmp(argv[1], "-r") == 0)
+    {
+        raw = TRUE;
+        first = 2;
+    }
+    for(i = first; i < argc; ++i)
+    {
+        if(!vars_is_name(argv[i], strlen(argv[i])))
+        {
+            ERROR("read : not a valid name", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    got = input_line(in, &line, method);
+
+    // Without -r a backslash escapes the next character, a newline too
+    while(got == 1 && !raw && line.len > 0 && line.data[line.len - 1] == '\\'
+          && (line.len < 2 || line.data[line.len - 2] != '\\'))
+    {
+        line.data[--line.len] = '\0';
+        int next = input_line(in, &more, method);
+        if(next != 1)
+            break;
+        char *grown = realloc(line.data, line.len + more.len + 1);
+        if(grown == NULL)
+            break;
+        line.data = grown;
+        line.capacity = line.len + more.len + 1;
+        memcpy(line.data + line.len, more.data, more.len + 1);
+        line.len += more.len;
+    }
+    if(got == -1)
+    {
+        ERROR("read", strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if(got == 0 && line.data == NULL)
+    {
+        line.data = calloc(1, 1);
+        line.capacity = line.data != NULL ? 1 : 0;
+        if(line.data == NULL)
+            return EXIT_FAILURE;
+    }
+    if(!raw)
+    {
+        char *from = line.data, *to = line.data;
+        for(; *from != '\0'; ++from)
+        {
+            if(*from == '\\' && from[1] != '\0')
+                ++from;
+            *to++ = *from;
+        }
+        *to = '\0';
+    }
+
+    if(first >= argc)
+        vars_set("REPLY", line.data);
+    else
+        assign_fields(line.data, argc - first, argv + first);
+    return got == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+} // int builtin_read(int, char**)
+
+// Lines collected by mapfile
+struct mapfile_lines {
+    char **lines;
+    size_t count;
+    size_t capacity;
+    int keep_newline;
+}; // struct mapfile_lines
+
+static int mapfile_add(const char *line, size_t len, void *data)
+{
+    struct mapfile_lines *lines = data;
+    char *copy = malloc(len + 2);
+
+    if(copy == NULL)
+        return -1;
+    memcpy(copy, line, len);
+    if(lines->keep_newline)
+        copy[len++] = '\n';
+    copy[len] = '\0';
+
+    if(lines->count == lines->capacity)
+    {
+        size_t capacity = lines->capacity ? lines->capacity * 2 : 64;
+        char **grown = realloc(lines->lines, capacity * sizeof(char*));
+        if(grown == NULL)
+        {
+            free(copy);
+            return -1;
+        }
+        lines->lines = grown;
+        lines->capacity = capacity;
+    }
+    lines->lines[lines->count++] = copy;
+    return 0;
+} // int mapfile_add(const char*, size_t, void*)
+
+/*
+ * mapfile [-t] [-n count] [array] : lines of stdin into array, MAPFILE
+ * by default. Without a count the whole input is read by big chunks,
+ * with one only the count lines are taken from it.
+ */
+static int builtin_mapfile(int argc, char **argv)
+{
+    struct mapfile_lines lines = {NULL, 0, 0, TRUE};
+    const char *name = "MAPFILE";
+    long max = -1;
+    int in = fileno(stdin);
+    int i, ret = 0;
+    size_t n;
+
+    for(i = 1; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-t") == 0)
+            lines.keep_newline = FALSE;
+        else if(strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            max = atol(argv[++i]);
+        else if(argv[i][0] != '-' && i == argc - 1 && vars_is_name(argv[i], strlen(argv[i])))
+            name = argv[i];
+        else
+        {
+            ERROR("Usage is : mapfile [-t] [-n count] [array]", "\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    if(max < 0)
+        ret = input_lines(in, mapfile_add, &lines);
+    else
+    {
+        struct input_buffer line = {NULL, 0, 0};
+        int method = input_method(in);
+        while(ret == 0 && (long)lines.count < max && (ret = input_line(in, &line, method)) == 1)
+            ret = mapfile_add(line.data, line.len, &lines);
+        input_free(&line);
+    }
+
+    if(ret == -1)
+    {
+        ERROR("mapfile", strerror(errno));
+    }
+    else if(vars_set_array(name, lines.lines, lines.count) == -1)
+    {
+        ERROR("mapfile : can't set", name);
+        ret = -1;
+    }
+    for(n = 0; n < lines.count; ++n)
+        free(lines.lines[n]);
+    free(lines.lines);
+    return ret == -1 ? EXIT_FAILURE : EXIT_SUCCESS;
+} // int builtin_mapfile(int, char**)
+
+static int builtin_test(int argc, char **argv)
+{
+    // Stats may be shared with the rest of the line, see condition.c
+    return condition_test(argc, argv);
+} // int builtin_test(int, char**)
+
+static int builtin_sched(int argc, char **argv)
+{
+    // Commands prefixed by sched are handled by run_command, here we
+    // only manage the defaults
+    if(argc == 1)
+    {
+        placement_print("default", &default_placement);
+        placement_print("background", &background_placement);
+        return EXIT_SUCCESS;
+    }
+
+    if(strcmp(argv[1], "-x") == 0 && argc == 2)
+    {
+        placement_clear(&default_placement);
+        placement_clear(&background_placement);
+        return EXIT_SUCCESS;
+    }
+
+    if(strcmp(argv[1], "-D") != 0 && strcmp(argv[1], "-B") != 0)
+    {
+        ERROR("Usage is : sched [-D|-B] [-c cpus] [-r] [-p] [-n nice] [-b] [-l res=val] [cmd args]", "\n");
+        return EXIT_FAILURE;
+    }
+
+    struct placement place;
+    placement_clear(&place);
+    if(placement_parse(&place, argc - 2, argv + 2) != argc - 2)
+    {
+        ERROR("Invalid sched option", "\n");
+        return EXIT_FAILURE;
+    }
+
+    if(argv[1][1] == 'D')
+        default_placement = place;
+    else
+        background_placement = place;
+
+    return EXIT_SUCCESS;
+} // int builtin_sched(int, char**)
+
+
+/*
+ * ############################################################
+ * ####### GENERAL
+ * ############################################################
+ */
+
+// $HOME shown as ~, the path is only compared and moved once
+static void clean_path(char *wd)
+{
+    const char *home = getenv("HOME");
+
+    if(home == NULL || home[0] == '\0' || strcmp(home, "/") == 0)
+        return;
+    size_t len = strlen(home);
+    while(len > 1 && home[len - 1] == '/')
+        --len;
+
+    if(strncmp(wd, home, len) == 0 && (wd[len] == '\0' || wd[len] == '/'))
+    {
+        wd[0] = '~';
+        memmove(wd + 1, wd + len, strlen(wd + len) + 1);
+    }
+} // clean_path(char*)
+
+/*
+ * getpwuid may go through NSS, only a prompt needs it. The static build
+ * cannot load the NSS modules, it takes $USER or $LOGNAME, then the uid.
+ */
+static void get_user_machine_name(char *name)
+{
+    char hostname[256];
+    uid_t uid = geteuid();
+    const char *user = NULL;
+
+#ifndef ASR2_STATIC
+    struct passwd *pw = getpwuid(uid);
+    if (pw)
+        user = pw->pw_name;
+#endif
+    if (user == NULL)
+        user = getenv("USER");
+    if (user == NULL || user[0] == '\0')
+        user = getenv("LOGNAME");
+    if (user != NULL && user[0] != '\0')
+        snprintf(username, PATH_MAX, "%s", user);
+    else
+        snprintf(username, PATH_MAX, "%ld", (long)uid);
+
+    // Get the hostname
+    if(gethostname(hostname, sizeof(hostname)) == 0)
+    {
+        hostname[sizeof(hostname) - 1] = '\0';
+        snprintf(name, PATH_MAX, "%.1024s@%s:", username, hostname);
+    }
+    else
+        snprintf(name, PATH_MAX, "%.1024s:", username);
+} // get_user_machine_name(char*)
+
+// Identity and completion on the first prompt, wd after a change
+static void prepare_prompt(void)
+{
+    if(!identity_ready)
+    {
+        identity_ready = TRUE;
+        get_user_machine_name(user_machine_name);
+
+        // Builtins are completed like PATH commands
+        struct built_in_command *builtin;
+        for(builtin = bltins; builtin->cmd; ++builtin)
+            complete_add_builtin(builtin->cmd);
+    }
+    if(wd_stale)
+    {
+        snprintf(wd, PATH_MAX, "%s", dirs_pwd());
+
+        // Makes wd more "readable"
+        clean_path(wd);
+        wd_stale = FALSE;
+    }
+} // prepare_prompt()
+
+static int get_command(FILE * source, char *command)
+{
+    char *white = "\033[0m";
+    char *color = "\033[32m";
+
+    // Terminal : line editor with history and completion
+    if (source == stdin && isatty(fileno(stdin))) {
+        char prompt[PATH_MAX * 2 + 32];
+        prepare_prompt();
+        if (continuation)
+            snprintf(prompt, sizeof(prompt), "%s", prompt_str);
+        else
+            snprintf(prompt, sizeof(prompt), "%s%s%s%s%s", color, user_machine_name, white, wd, prompt_str);
+
+        fflush(stdout);
+        no_prompt = TRUE;
+        int len = editor_read_line(prompt, command, BUFSIZ - 2);
+        no_prompt = FALSE;
+        if (len == -1)
+            return 1;
+        command[len] = '\n';
+        command[len + 1] = '\0';
+        return EXIT_SUCCESS;
+    }
+
+    if (source == stdin && interactive && continuation)
+        fputs(prompt_str, stdout);
+    else if (source == stdin && interactive) {
+        prepare_prompt();
+        fputs(color, stdout);
+        fputs(user_machine_name, stdout);
+        fputs(white, stdout);
+        fputs(wd, stdout);
+        fputs(prompt_str, stdout);
+    }
+    
+    no_prompt = TRUE;
+    errno = 0;
+    while (!fgets(command, BUFSIZ - 2, source)) {
+        // Interrupted by a signal (SIGCHLD of a background process),
+        // errno alone is not enough, it may be left over from before
+        if (errno == EINTR && !feof(source))
+        {
+            clearerr(source);
+            errno = 0;
+            continue;
+        }
+        if (source == stdin)
+            printf("\n");
+        return 1;
+    }
+    no_prompt = FALSE;
+    return EXIT_SUCCESS;
+} // int get_command(FILE*, char*)
+
+// Only lines typed by the user, without immediate repetitions
+static void record_history(const char *command)
+{
+    char line[BUFSIZ];
+    long count;
+
+    snprintf(line, sizeof(line), "%s", command);
+    line[strcspn(line, "\n")] = '\0';
+    if(line[0] == '\0')
+        return;
+
+    count = history_count();
+    if(count > 0 && strcmp(history_get(count - 1), line) == 0)
+        return;
+    history_add(line);
+} // record_history(const char*)
+
+/*static int expand_arguments(char *command)
+{
+    char *saved_ptr = NULL;
+    char resulting_command[PATH_MAX];
+    char *token = strtok_r(command, " ", &saved_ptr);
+    char *next_tokens = strtok_r(NULL, "", &saved_ptr);
+    resulting_command[0] = '\0';
+    do
+    {       
+        if(token[strlen(token) - 1] == '\n')
+            token[strlen(token) - 1] = '\0';
+
+        // If token is not *
+        if(strcmp(token, "*") != 0)
+        {
+            strcat(resulting_command, token);
+            strcat(resulting_command," ");
+        }
+        else
+        {
+            DIR *current_dir = opendir(wd);
+            struct dirent *entry;
+
+            while((entry = readdir(current_dir)))
+            {
+                if(entry->d_name[0] != '.')
+                {
+                    strcat(resulting_command, entry->d_name);
+                    strcat(resulting_command, " ");
+                }
+            }   
+        }
+
+        if(next_tokens != NULL)
+        {
+            token = strtok_r(next_tokens, " ", &saved_ptr);
+            next_tokens = strtok_r(NULL, "", &saved_ptr);
+        }
+        else
+            token = NULL;
+
+    } while(token != NULL);
+    
+    strcpy(command, resulting_command);
+
+    return TRUE;
+} // int expand_arguments(char*)*/
+
+// Appends word and a space to the growing line of expand_arguments2
+static int append_word(char **line, size_t *len, size_t *size, const char *word)
+{
+    size_t word_len = strlen(word);
+
+    // get_background_commands appends a space to the line
+    if(*len + word_len + 3 > *size)
+    {
+        size_t grown_size = *size * 2;
+        while(*len + word_len + 3 > grown_size)
+            grown_size *= 2;
+        char *grown = realloc(*line, grown_size);
+        if(grown == NULL)
+            return -1;
+        *line = grown;
+        *size = grown_size;
+    }
+    memcpy(*line + *len, word, word_len);
+    *len += word_len;
+    (*line)[(*len)++] = ' ';
+    (*line)[*len] = '\0';
+    return 0;
+} // int append_word(char**, size_t*, size_t*, const char*)
+
+/*
+ * Expands the * and ** words of command in a new line, NULL on error.
+ * The matches of ** go straight in the line split into argv, as long
+ * as they need.
+ */
+static char* expand_arguments2(char *command)
+{
+    char *saved_ptr = NULL;
+    size_t len = 0, size = BUFSIZ;
+    char *resulting_command = malloc(size);
+    char *token;
+    int failed = FALSE;
+
+    if(resulting_command == NULL)
+        return NULL;
+    resulting_command[0] = '\0';
+
+    // Browse the command
+    for(token = strtok_r(command, " ", &saved_ptr); token != NULL && !failed;
+        token = strtok_r(NULL, " ", &saved_ptr))
+    {
+        if(token[strlen(token) - 1] == '\n')
+            token[strlen(token) - 1] = '\0';
+
+        if(strstr(token, "**") != NULL)
+        {
+            // Sorted matches of the tree, the word itself if none
+            struct walk_result matches;
+            size_t i;
+            if(walk_glob(dirs_fd(), token, vars_get(WALK_PRUNE_VAR),
+                         (int)vars_get_int(WALK_THREADS_VAR), &matches) == -1)
+            {
+                ERROR("Glob pattern match.", token);
+                failed = TRUE;
+                break;
+            }
+            if(matches.count == 0)
+                failed = append_word(&resulting_command, &len, &size, token) == -1;
+            for(i = 0; i < matches.count && !failed; ++i)
+                failed = append_word(&resulting_command, &len, &size, matches.paths[i]) == -1;
+            walk_free(&matches);
+        }
+        // If token is not *
+        else if(strcmp(token, "*") != 0)
+            failed = append_word(&resulting_command, &len, &size, token) == -1;
+        else
+        {
+            // Get pattern replacement
+            glob_t glob_result;
+            if(dirs_glob("*", GLOB_TILDE, &glob_result) != 0)
+            {
+                ERROR("Glob pattern math.", "Can't continue");
+                failed = TRUE;
+                break;
+            }
+            unsigned int i;
+            for(i = 0; i < glob_result.gl_pathc && !failed; ++i)
+                failed = append_word(&resulting_command, &len, &size, glob_result.gl_pathv[i]) == -1;
+            globfree(&glob_result);
+        }
+    }
+
+    if(failed)
+    {
+        free(resulting_command);
+        return NULL;
+    }
+    return resulting_command;
+} // char* expand_arguments2(char*)
+
+// $name, ${name} and $((...)) are replaced before the line is split
+static int expand_variables(char *command)
+{
+    char expanded[BUFSIZ];
+
+    if(strchr(command, '$') == NULL)
+        return TRUE;
+    if(vars_expand(command, expanded, BUFSIZ - 2) == -1)
+        return FALSE;
+    strcpy(command, expanded);
+    return TRUE;
+} // int expand_variables(char*)
+
+static char** get_background_commands(char *command, int *has_background, int *has_last, int *commands_count)
+{
+    char **background = malloc(sizeof(char*));
+    int background_mem = 1;
+
+    *commands_count = 0;
+
+    strcat(command, " ");
+
+    char *saved_ptr = NULL;
+    char *cur_command = strtok_r(command, "&", &saved_ptr);
+    char *next_commands = strtok_r(NULL, "", &saved_ptr);
+
+    // Manage commang, we didn"t find any &
+    if(next_commands == NULL)
+    {
+        *commands_count = 1;
+        // If the last, so is a front command
+        *has_last = TRUE;
+        *has_background = FALSE;
+        background[0] = command;
+        return background;
+    }
+
+    *has_background = TRUE;
+    *has_last = FALSE;
+
+    background[0] = malloc(sizeof(char) * (strlen(cur_command) + 1));
+    strcpy(background[0], cur_command);
+    background[0][strlen(cur_command)] = '\0';
+    ++*commands_count;
+    
+    int i = 1;
+    // Browse the command
+    do
+    {
+        // f this is the last command and should not be processed in background
+        if(strcmp(next_commands, " ") == 0)
+        {
+            *has_last = FALSE;
             break;
         }
 
@@ -510,29 +1673,370 @@ static char** get_background_commands(char *command, int *has_background, int *h
 static void clean_command(char *command)
 {
     // Remove \n and ' '
-    while(!isalnum(command[0]))
+    while(isspace(command[0]))
         ++command;
     size_t last = strlen(command) - 1;
     while(command[last] == '\n' || command[last] == ' ')
         command[last--] = '\0';
 } // clean_command(char*)
 
-static int is_empty(const char *command)
+static int is_empty(const char *command)
+{
+    int alpha = TRUE;
+    unsigned int i;
+    for(i = 0; command[i] != '\0'; ++i)
+    {
+        if(!isspace(command[i]))
+        {
+            alpha = FALSE;
+            break;
+        }
+    }
+    return alpha;
+} // static int is_empty(const char*)
+
+static int parse_redirections(int *argc, char **parameters, struct redirection *redir)
+{
+    int i, kept = 0;
+
+    redir->input = NULL;
+    redir->output = NULL;
+    redir->here_string = NULL;
+    redir->here_document = FALSE;
+
+    for(i = 0; i < *argc; ++i)
+    {
+        // <<<word or <<< word, the last input redirection wins
+        if(strncmp(parameters[i], "<<<", 3) == 0)
+        {
+            if(parameters[i][3] == '\0' && i + 1 >= *argc)
+            {
+                ERROR("Missing here-string.", "\n");
+                return -1;
+            }
+            redir->here_string = parameters[i][3] != '\0' ? parameters[i] + 3 : parameters[++i];
+            redir->input = NULL;
+            redir->here_document = FALSE;
+            continue;
+        }
+        // The delimiter is only needed by the parser which read the body
+        if(strncmp(parameters[i], "<<", 2) == 0)
+        {
+            if(strcmp(parameters[i], "<<") == 0 || strcmp(parameters[i], "<<-") == 0)
+                ++i;
+            redir->here_document = TRUE;
+            redir->input = NULL;
+            redir->here_string = NULL;
+            continue;
+        }
+
+        int is_input = strcmp(parameters[i], "<") == 0;
+        if(!is_input && strcmp(parameters[i], ">") != 0)
+        {
+            parameters[kept++] = parameters[i];
+            continue;
+        }
+
+        if(i + 1 >= *argc)
+        {
+            ERROR("Missing redirection file.", "\n");
+            return -1;
+        }
+        if(is_input)
+        {
+            redir->input = parameters[++i];
+            redir->here_string = NULL;
+            redir->here_document = FALSE;
+        }
+        else
+            redir->output = parameters[++i];
+    }
+
+    *argc = kept;
+    return 0;
+} // int parse_redirections(int*, char**, struct redirection*)
+
+// Descriptor of the new stdin : a file, a here-string or the here-document
+static int open_input(const struct redirection *redir)
+{
+    int fd_in;
+
+    if(redir->here_document)
+        return heredoc_open(here_body != NULL ? here_body : "", here_body_len);
+
+    if(redir->here_string != NULL)
+    {
+        // A here-string ends with a newline like a one line document
+        size_t len = strlen(redir->here_string);
+        char *data = malloc(len + 1);
+        if(data == NULL)
+        {
+            ERROR("Can't open here-string.", strerror(errno));
+            return -1;
+        }
+        memcpy(data, redir->here_string, len);
+        data[len] = '\n';
+        fd_in = heredoc_open(data, len + 1);
+        free(data);
+        return fd_in;
+    }
+
+    fd_in = open(redir->input, O_RDONLY);
+    if(fd_in == -1)
+        ERROR("Can't open redirection file.", strerror(errno));
+    return fd_in;
+} // int open_input(const struct redirection*)
+
+/*
+ * Open the redirection files on stdin and stdout. When saved is not
+ * NULL the previous descriptors are kept to be restored afterwards.
+ */
+static int open_redirections(const struct redirection *redir, int saved[2])
+{
+    if(saved != NULL)
+    {
+        saved[0] = -1;
+        saved[1] = -1;
+    }
+
+    if(redir->input != NULL || redir->here_string != NULL || redir->here_document)
+    {
+        int fd_in = open_input(redir);
+        if(fd_in == -1)
+            return -1;
+        if(saved != NULL)
+            saved[0] = fcntl(fileno(stdin), F_DUPFD_CLOEXEC, 10);
+        if(dup2(fd_in, fileno(stdin)) == -1)
+        {
+            ERROR("dup2 : can't redirect stdin to file.", strerror(errno));
+            close(fd_in);
+            restore_redirections(saved);
+            return -1;
+        }
+        close(fd_in);
+    }
+
+    if(redir->output != NULL)
+    {
+        // Flush before redir
+        fflush(stdout);
+
+        // File will be written atthe exit of the programm
+        int fd_out = open(redir->output, O_RDWR|O_CREAT|O_APPEND, 0660);
+        if(fd_out == -1)
+        {
+            ERROR("Can't open redirection file.", strerror(errno));
+            restore_redirections(saved);
+            return -1;
+        }
+        if(saved != NULL)
+            saved[1] = fcntl(fileno(stdout), F_DUPFD_CLOEXEC, 10);
+        if(dup2(fd_out, fileno(stdout)) == -1)
+        {
+            ERROR("dup2 : can't redirect stdout to file.", strerror(errno));
+            close(fd_out);
+            restore_redirections(saved);
+            return -1;
+        }
+        close(fd_out);
+    }
+    return 0;
+} // int open_redirections(const struct redirection*, int[2])
+
+static void restore_redirections(int saved[2])
+{
+    if(saved == NULL)
+        return;
+
+    if(saved[0] != -1)
+    {
+        dup2(saved[0], fileno(stdin));
+        close(saved[0]);
+        saved[0] = -1;
+    }
+    if(saved[1] != -1)
+    {
+        fflush(stdout);
+        dup2(saved[1], fileno(stdout));
+        close(saved[1]);
+        saved[1] = -1;
+    }
+} // restore_redirections(int[2])
+
+static int find_builtin(const char *name, int argc, char **argv)
+{
+    // One hash and one compare, the table follows builtins.def
+    int i = builtins_find(name);
+    if(i == -1)
+        return -1;
+
+    // The cat fast path only knows files, options go to the real one
+    if(bltins[i].function == builtin_cat)
+    {
+        int j;
+        for(j = 1; j < argc; ++j)
+        {
+            if(argv[j][0] == '-' && argv[j][1] != '\0')
+                return -1;
+        }
+    }
+    return i;
+} // int find_builtin(const char*, int, char**)
+
+// Close the pipe ends the shell doesn't need once a stage is launched
+static void close_stage_pipes(int position, int pipefd1[2], int pipefd2[2])
+{
+    if(position == 0 || position == 1)
+    {
+        if(close(pipefd2[0]) == -1)
+        {
+            ERROR("Can't close pipe read end.", strerror(errno));
+        }
+    }
+    if(position == -1 || position == 0)
+    {
+        if(close(pipefd1[1]) == -1)
+        {
+            ERROR("Can't close pipe write end.", strerror(errno));
+        }
+    }
+} // close_stage_pipes(int, int[2], int[2])
+
+static void free_params(int argc, char **params)
+{
+    int i;
+    for(i = 0; i < argc; ++i)
+        free(params[i]);
+    free(params);
+} // free_params(int, char**)
+
+static void apply_placement(int is_front, const struct placement *command_placement, int stage)
+{
+    // Shell defaults, then background ones, then the pipeline and the command prefix
+    struct placement effective = default_placement;
+
+    if(!is_front)
+        placement_merge(&effective, &background_placement);
+    placement_merge(&effective, &pipeline_placement);
+    placement_merge(&effective, command_placement);
+
+    if(!placement_is_empty(&effective))
+        placement_apply(&effective, stage);
+} // apply_placement(int, const struct placement*, int)
+
+/*
+ * Options of the cached prefix, hashed in key with the command words,
+ * the working directory and the input redirection : -i path... input
+ * files by contents (-m by size and mtime), up to the next option or
+ * --, and -e NAME variables. Returns the number of option words.
+ */
+static int cached_key(int argc, char **argv, const struct redirection *redir, struct cache_key *key)
+{
+    int i, metadata = FALSE, inputs = FALSE, command = argc;
+
+    for(i = 0; i < argc; ++i)
+    {
+        if(strcmp(argv[i], "-m") == 0)
+            metadata = TRUE;
+        else if(strcmp(argv[i], "-i") == 0)
+            inputs = TRUE;
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < argc)
+        {
+            inputs = FALSE;
+            ++i;
+        }
+        else if(strcmp(argv[i], "--") == 0)
+        {
+            command = i + 1;
+            break;
+        }
+        else if(!inputs)
+        {
+            command = i;
+            break;
+        }
+    }
+
+    cache_key_init(key);
+    for(i = command; i < argc; ++i)
+        cache_key_add(key, argv[i], strlen(argv[i]));
+    cache_key_add(key, dirs_pwd(), strlen(dirs_pwd()));
+    if(redir->input != NULL)
+        cache_key_file(key, redir->input, metadata);
+    if(redir->here_string != NULL)
+        cache_key_add(key, redir->here_string, strlen(redir->here_string));
+    if(redir->here_document && here_body != NULL)
+        cache_key_add(key, here_body, here_body_len);
+
+    for(i = 0, inputs = FALSE; i < command; ++i)
+    {
+        if(strcmp(argv[i], "-i") == 0)
+            inputs = TRUE;
+        else if(strcmp(argv[i], "-e") == 0 && i + 1 < command)
+        {
+            const char *value = vars_get(argv[++i]);
+            cache_key_add(key, argv[i], strlen(argv[i]));
+            // Unset and empty are different
+            cache_key_add(key, value != NULL ? "=" : "", value != NULL);
+            if(value != NULL)
+                cache_key_add(key, value, strlen(value));
+            inputs = FALSE;
+        }
+        else if(inputs && argv[i][0] != '-')
+            cache_key_file(key, argv[i], metadata);
+    }
+    cache_key_end(key);
+    return command;
+} // int cached_key(int, char**, const struct redirection*, struct cache_key*)
+
+/*
+ * Miss of a cached command, in its forked child : the command runs in a
+ * grandchild writing to memory files, stored, then copied to the real
+ * outputs. Returns in the grandchild, or if nothing can be captured.
+ */
+static void run_cached(const struct cache_key *key)
 {
-    int alpha = TRUE;
-    unsigned int i;
-    for(i = 0; i < strlen(command); ++i)
+    int out = memfd_create("cached_stdout", MFD_CLOEXEC);
+    int err = memfd_create("cached_stderr", MFD_CLOEXEC);
+    pid_t process = -1;
+    int status;
+
+    if(out != -1 && err != -1)
+        process = fork();
+    if(process == -1)
+    {
+        // The command runs anyway, without the cache
+        if(out != -1)
+            close(out);
+        if(err != -1)
+            close(err);
+        return;
+    }
+    if(process == 0)
     {
-        if(isalnum(command[i]))
+        if(dup2(out, STDOUT_FILENO) == -1 || dup2(err, STDERR_FILENO) == -1)
         {
-            alpha = FALSE;
-            break;
+            CRITIC("dup2 : can't capture the cached command.", strerror(errno));
         }
+        close(out);
+        close(err);
+        return;
     }
-    return alpha;
-} // static int is_empty(const char*)
 
-static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd2[2], int *commandParity)
+    while(waitpid(process, &status, 0) == -1 && errno == EINTR);
+    // A killed run is not a result of the command
+    if(!WIFSIGNALED(status) && cache_store(key, WEXITSTATUS(status), out, err) == -1)
+    {
+        WARNING("cached : can't store the result", strerror(errno));
+    }
+    lseek(out, 0, SEEK_SET);
+    copy_fd(out, STDOUT_FILENO, NULL);
+    lseek(err, 0, SEEK_SET);
+    copy_fd(err, STDERR_FILENO, NULL);
+    exit(exit_status(status));
+} // run_cached(const struct cache_key*)
+
+static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd2[2])
 {
     char *saved_ptr, *saved_ptr2 = NULL;
     char *cur_command = strtok_r(command[0], "|", &saved_ptr);
@@ -546,29 +2050,42 @@ static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd
     {
         *has_pipe = FALSE;
         position = 1;
-        ++*commandParity;
-        *commandParity %= 2;
     }
     // Here no pipe created but command has pipe, we are in the first commmand
     else if(next_commands != NULL && !*has_pipe)
     {
         *has_pipe = TRUE;
         position = -1;
-        *commandParity = 0;
     }
     // Here, a pipe was created and we are not in the last of first command
     else if(next_commands != NULL && *has_pipe)
     {   
         position = 0;
-        ++*commandParity;
-        *commandParity %= 2;
     }
-    
-    if(position == 2)
-        *commandParity = 0;
-    
+
+    // A new pipeline starts, forget the placement of the previous one
+    if(position == -1 || position == 2)
+    {
+        pipeline_stage = 0;
+        placement_clear(&pipeline_placement);
+    }
+    int stage = pipeline_stage++;
+
     *command = next_commands;
 
+    // Manage pipes
+    // pipefd2[0] is the read end left by the previous stage and
+    // pipefd1 the pipe toward the next stage
+    if(position == 0 || position == 1)
+        pipefd2[0] = pipefd1[0];
+    if(position == -1 || position == 0)
+    {
+        if(pipe2(pipefd1, O_CLOEXEC) == -1)
+        {
+            CRITIC("FAILED TO CREATE PIPE", strerror(errno));
+        }
+    }
+
     // Clean the command
     clean_command(cur_command);
 
@@ -588,11 +2105,24 @@ static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd
             is_front= TRUE;
         }
 
+        // The first command of the stage reads the previous pipe and
+        // the last one writes to the next pipe
+        int pipe_in = (c == 0 && (position == 0 || position == 1)) ? pipefd2[0] : -1;
+        int pipe_out = (c == commands_count - 1 && (position == -1 || position == 0)) ? pipefd1[1] : -1;
+
+        // The output of a background job may go through the shell, the
+        // command is kept before it is tokenized
+        char job_command[JOBS_LABEL_SIZE];
+        int capture = !is_front && pipe_out == -1 && jobs_mode() != JOBS_OFF;
+        if(capture)
+            snprintf(job_command, sizeof(job_command), "%s", background_commands[c]);
+
         // Get the command name
         char *token = strtok_r(background_commands[c], " ", &saved_ptr2);
 
         if(token == NULL)
         {
+            close_stage_pipes(position, pipefd1, pipefd2);
             return EXIT_SUCCESS;
         }
 
@@ -606,305 +2136,588 @@ static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd
         char **parameters = malloc(sizeof(char*) * parametersCount);
         parameters[argc++] = token;
 
-        // Get the command arguments
-        char *next_tokens = strtok_r(NULL, "", &saved_ptr2);
-        while(next_tokens != NULL)
+        // Get the command arguments, a double space ends them
+        char *next_token;
+        while(*saved_ptr2 != ' ' && (next_token = strtok_r(NULL, " ", &saved_ptr2)) != NULL)
         {
-            if(next_tokens[0] == ' ')
-                break;
-
             if(parametersRemaining == 0)
             {
                 parametersRemaining = parametersCount;
                 parametersCount *= 2;
                 parameters = realloc(parameters, sizeof(char*) * parametersCount);
             }
-            char *next_token = strtok_r(next_tokens, " ", &saved_ptr2);
             if(next_token[strlen(next_token) - 1] == '\n')
                 next_token[strlen(next_token) - 1]= '\0';
 
             parameters[argc++] = next_token;
             --parametersRemaining;
+        }
 
-            next_tokens = strtok_r(NULL, "", &saved_ptr2);
+        // Redirections are removed from the arguments, applied after fork
+        struct redirection redir;
+        if(parse_redirections(&argc, parameters, &redir) == -1 || argc == 0)
+        {
+            close_stage_pipes(position, pipefd1, pipefd2);
+            return EXIT_FAILURE;
         }
+        token = parameters[0];
 
-        int i;
-        // Clean args
-        char **full_params = malloc(sizeof(char*) * (argc + 1));
-        full_params[argc] = NULL;
-        full_params[0] = malloc(PATH_MAX * sizeof(char));
-        for(i = 1; i < argc; ++i)
+        // A line of name=value words only sets shell variables
+        int assignments = 0;
+        while(assignments < argc && vars_is_assignment(parameters[assignments]))
+            ++assignments;
+        if(assignments == argc)
         {
-            full_params[i] = malloc(PATH_MAX * sizeof(char));
-            strcpy(full_params[i], parameters[i]);
+            // In a pipeline or in background it would be a subshell
+            if(is_front && position == 2)
+            {
+                for(assignments = 0; assignments < argc; ++assignments)
+                    vars_assign(parameters[assignments]);
+            }
+            free(parameters);
+            close_stage_pipes(position, pipefd1, pipefd2);
+            return EXIT_SUCCESS;
         }
-        strcpy(full_params[0], token);
 
-        // Manage pipes
-        // If first process
-        if(*has_pipe && position == -1)
+        // Result cache prefix : cached [options] cmd args
+        struct cache_key cache_key;
+        int cache = FALSE, cache_fd = -1;
+        if(strcmp(token, "cached") == 0 && argc > 1)
         {
-            if(pipe(pipefd1) == -1)
+            int consumed = cached_key(argc - 1, parameters + 1, &redir, &cache_key);
+
+            // Only a prefix if a command follows the options
+            if(consumed < argc - 1 && parameters[consumed + 1][0] != '-')
             {
-                CRITIC("FAILED TO CREATE PIPE", strerror(errno));
+                parameters += consumed + 1;
+                argc -= consumed + 1;
+                token = parameters[0];
+                cache = TRUE;
+                cache_configure(vars_get(CACHE_DIR_VAR), vars_get_int(CACHE_SIZE_VAR));
+                cache_fd = cache_open(&cache_key);
+                stats_add(cache_fd != -1 ? STATS_CACHE_HITS : STATS_CACHE_MISSES);
             }
         }
-        else if(*has_pipe || position == 1)
+
+        // Placement prefix : sched [options] cmd args
+        struct placement command_placement;
+        placement_clear(&command_placement);
+        if(strcmp(token, "sched") == 0 && argc > 1)
         {
-            if(*commandParity)
+            struct placement prefix;
+            placement_clear(&prefix);
+            int consumed = placement_parse(&prefix, argc - 1, parameters + 1);
+            if(consumed == -1)
             {
-                if(pipe(pipefd2) == -1)
-                {
-                    CRITIC("FAILED TO CREATE PIPE", strerror(errno));
-                }
+                close_stage_pipes(position, pipefd1, pipefd2);
+                return EXIT_FAILURE;
             }
-            else
+
+            // Only a prefix if a command follows the options
+            if(consumed < argc - 1 && parameters[consumed + 1][0] != '-')
             {
-                if(pipe(pipefd1) == -1)
-                {
-                    CRITIC("FAILED TO CREATE PIPE", strerror(errno));
-                }
+                if(prefix.pipeline)
+                    placement_merge(&pipeline_placement, &prefix);
+                else
+                    command_placement = prefix;
+
+                parameters += consumed + 1;
+                argc -= consumed + 1;
+                token = parameters[0];
             }
         }
 
-        // Search for built in function
-        for(i = 0; bltins[i].cmd; ++i)
-        {     
-            if(strcmp(token, bltins[i].cmd) == 0)
+        int i;
+        // Clean args
+        char **full_params = malloc(sizeof(char*) * (argc + 1));
+        full_params[argc] = NULL;
+        full_params[0] = malloc(PATH_MAX * sizeof(char));
+        // A ** word can give millions of arguments, they take their length
+        for(i = 1; i < argc; ++i)
+            full_params[i] = strdup(parameters[i]);
+        strcpy(full_params[0], token);
+
+        // Search for built in function, then for a shell function
+        int builtin = find_builtin(token, argc, parameters);
+        struct function *function = builtin == -1 ? function_find(token) : NULL;
+
+        // Front builtins and functions out of a pipeline run in the shell itself
+        // A cache hit out of a pipeline is replayed without forking
+        if(cache_fd != -1 && is_front && position == 2)
+        {
+            int saved[2];
+            int ret = EXIT_FAILURE;
+            if(open_redirections(&redir, saved) == 0)
             {
-                if(!is_front)
-                {
-                    pid_t process = fork();
-                    if(!process)
-                    {
-                        // We are in the forked branch                    
-                        bltins[i].function(argc, full_params);
-                        exit(EXIT_SUCCESS);
-                    }
-                    else
-                    {
-                        return EXIT_SUCCESS;
-                    }
-                }
+                fflush(stdout);
+                ret = cache_replay(cache_fd, STDOUT_FILENO, STDERR_FILENO);
+                restore_redirections(saved);
+            }
+            close(cache_fd);
+            free_params(argc, full_params);
+            last_status = ret == -1 ? EXIT_FAILURE : ret;
+            return EXIT_SUCCESS;
+        }
+
+        if((builtin != -1 || function != NULL) && is_front && position == 2 && !cache)
+        {
+            int saved[2];
+            int ret = EXIT_FAILURE;
+            stats_add(builtin != -1 ? STATS_BUILTINS : STATS_FUNCTIONS);
+            if(open_redirections(&redir, saved) == 0)
+            {
+                if(builtin != -1)
+                    ret = bltins[builtin].function(argc, full_params);
                 else
-                {
-                   
-                    return bltins[i].function(argc, parameters);  
-                }                  
+                    ret = function_call(function, argc, full_params, run_line);
+                restore_redirections(saved);
             }
+            free_params(argc, full_params);
+
+            // The status is not returned, it could be taken for a pid
+            last_status = ret;
+            return EXIT_SUCCESS;
         }
 
-        /*
-        * If we are here, it mean the command is not a builtin one.
-        */
-        
-        pid_t process = fork();
+        // Builtins output must not be duplicated in the child
+        fflush(stdout);
+
+        // Block SIGCHLD until the front process is known, otherwise
+        // child_action could reap it before the main loop waits for it
+        sigset_t chld_mask, old_mask;
+        sigemptyset(&chld_mask);
+        sigaddset(&chld_mask, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+
+        // The last command of the shell takes its place like exec,
+        // the code of the child below runs in the shell itself
+        int tail_exec = tail_command && is_front && (position == 1 || position == 2)
+                        && !has_background && builtin == -1 && function == NULL && !cache;
+        if(tail_exec && tail_jobs)
+        {
+            stats_add(STATS_TAIL_FORKS);
+            tail_exec = FALSE;
+        }
+
+        int job = -1, job_fd = -1;
+        if(capture && !tail_exec)
+            job = jobs_open(job_command, &job_fd);
+
+        pid_t process = 0;
+        if(tail_exec)
+        {
+            stats_add(STATS_TAIL_EXECS);
+            stats_save();
+        }
+        else
+            process = fork();
+        if(job != -1 && process != 0)
+            jobs_started(job, process);
+        if(cache_fd != -1 && process != 0)
+            close(cache_fd);
         if(process == -1)
         {
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
             ERROR("Can't fork process.", strerror(errno));
+            free_params(argc, full_params);
+            close_stage_pipes(position, pipefd1, pipefd2);
             return EXIT_FAILURE;
         }
-        wait_process = process;
+        if(process)
+            stats_add(STATS_FORKS);
+
+        // Only the last stage of a front pipeline is waited for
+        if(process && is_front && (position == 1 || position == 2))
+            wait_process = process;
+        if(process > 0 && is_front && front_group != -1)
+        {
+            if(front_group == 0)
+                front_group = process;
+            setpgid(process, front_group);
+        }
+        if(process)
+            sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
         if(!process)
         {
             // We are in the forked branch
             // Reset signals to default
             reset_signals();
 
-            // Search for redirection
-            // Used to redirect output
-            char file[PATH_MAX];
-            int redir = 0;
+            // The group of a front command with a deadline
+            if(is_front && front_group != -1)
+                setpgid(0, front_group);
+            front_group = -1;
 
-            char *args[argc];
+            // CPU affinity, scheduling and limits
+            apply_placement(is_front, &command_placement, stage);
 
-            int i;    
-            for(i = 0; i < argc; ++i)
+            // Manage PIPE, then redirections which take precedence
+            if(pipe_in != -1 && dup2(pipe_in, fileno(stdin)) == -1)
             {
-                // Search for the redirection sign
-                if(strcmp(full_params[i], ">") == 0 && i < argc + 1)
-                {
-                    strcpy(file, full_params[i + 1]);
-                    redir = 1;
-                    args[i] = NULL;
-                    break;
-                }
-                args[i] = malloc(sizeof(char) * strlen(full_params[i]));
-                strcpy(args[i], full_params[i]);
+                CRITIC("dup2 : can't redirect stdin to pipe.", strerror(errno));
             }
-
-            if(sizeof(args) > (size_t)argc)
+            if(pipe_out != -1 && dup2(pipe_out, fileno(stdout)) == -1)
             {
-                args[argc] = NULL;
+                CRITIC("dup2 : can't redirect stdout to pipe.", strerror(errno));
             }
-
-            if(redir == TRUE)
+            if(job_fd != -1 && (dup2(job_fd, STDOUT_FILENO) == -1 || dup2(job_fd, STDERR_FILENO) == -1))
             {
-                // Flush before redir
-                fflush(stdout);
-
-                // File will be written atthe exit of the programm
-                int fd_out = open(file, O_RDWR|O_CREAT|O_APPEND, 0660);
-                if(fd_out == -1)
-                {
-                    ERROR("Can't open redirection file.", strerror(errno));
-                    return EXIT_FAILURE;
-                }
-                if(dup2(fd_out, fileno(stdout)) == -1)
-                {
-                    ERROR("dup2 : can't redirect stdout to file.", strerror(errno));
-                    return EXIT_FAILURE;
-                }
+                CRITIC("dup2 : can't redirect output to job pipe.", strerror(errno));
             }
+            // Closes job_fd and the pipes of the other jobs
+            jobs_reset();
+            close_stage_pipes(position, pipefd1, pipefd2);
+            if(position == -1 || position == 0)
+                close(pipefd1[0]);
 
-            // Manage PIPE
-            // If first process)
-            if(*has_pipe && position == -1)
-            {
-                if(dup2(pipefd1[1], fileno(stdout)) == -1)
-                {
-                    CRITIC("dup2 : can't redirect stdout to pipe.", strerror(errno));
-                }
+            if(open_redirections(&redir, NULL) == -1)
+                exit(EXIT_FAILURE);
 
-                if(close(pipefd1[0])  == -1)
-                {
-                    ERROR("Can't close pipe read end.1", strerror(errno));
-                }             
-            }
-            else if(*has_pipe && position == 0)
+            // Cached command : the stored result, or a run stored on the way
+            if(cache_fd != -1)
             {
-                if(*commandParity)
-                {
-                    if(dup2(pipefd1[0], fileno(stdin)) == -1)
-                    {
-                        CRITIC("dup2 : can't redirect stdin to pipe.", strerror(errno));
-                    }
-                    if(dup2(pipefd2[1], fileno(stdout)) == -1)
-                    {
-                        CRITIC("dup2 : can't redirect stdout to pipe.", strerror(errno));
-                    }
-
-                    if(close(pipefd1[1]) == -1)
-                    {
-                        ERROR("Can't close pipe write end.", strerror(errno));
-                    } 
-                }
-                else
-                {
-                    if(dup2(pipefd2[0], fileno(stdin)) == -1)
-                    {
-                        CRITIC("dup2 : can't redirect stdin to pipe.", strerror(errno));
-                    }
-                    if(dup2(pipefd1[1], fileno(stdout)) == -1)
-                    {
-                        CRITIC("dup2 : can't redirect stdout to pipe.", strerror(errno));
-                    }
-                    
-
-                    if(close(pipefd1[0]) == -1)
-                    {
-                        ERROR("Can't close pipe read end.2", strerror(errno));
-                    }  
-                    if(close(pipefd2[1]) == -1)
-                    {
-                        ERROR("Can't close pipe write end.", strerror(errno));
-                    }  
-                }
+                int ret = cache_replay(cache_fd, STDOUT_FILENO, STDERR_FILENO);
+                exit(ret == -1 ? EXIT_FAILURE : ret);
             }
-            else if(position == 1)
+            if(cache)
+                run_cached(&cache_key);
+
+            // Builtin or function in a pipeline or in background
+            if(builtin != -1 || function != NULL)
             {
-                if(*commandParity)
-                {
-                    if(dup2(pipefd1[0], fileno(stdin)) == -1)
-                    {
-                        CRITIC("dup2 : can't redirect stdin to pipe.", strerror(errno));
-                    }
-
-                    if(close(pipefd1[1]) == -1)
-                    {
-                        ERROR("Can't close pipe write end.", strerror(errno));
-                    }  
-                }
+                int ret;
+                if(builtin != -1)
+                    ret = bltins[builtin].function(argc, full_params);
                 else
                 {
-                    if(dup2(pipefd2[0], fileno(stdin)) == -1)
-                    {
-                        CRITIC("dup2 : can't redirect stdin to pipe.", strerror(errno));
-                    }
-
-                    if(close(pipefd2[1]) == -1)
-                    {
-                        ERROR("Can't close pipe write end.", strerror(errno));
-                    }  
+                    // The function waits for its own commands, SIGCHLD
+                    // has to wake up the event loop of this process
+                    struct sigaction chld_action;
+                    memset(&chld_action, 0, sizeof(chld_action));
+                    chld_action.sa_sigaction = &child_action;
+                    chld_action.sa_flags = SA_SIGINFO | SA_RESTART;
+                    event_reset();
+                    sigaction(SIGCHLD, &chld_action, NULL);
+                    ret = function_call(function, argc, full_params, run_line);
                 }
+                fflush(stdout);
+                exit(ret);
             }
 
             // Execute
-            execvp(token, args);
+            execvp(token, full_params);
 
+            // 127 : not found, 126 : found but not executable
             WARNING("Wrong command", strerror(errno));
-            exit(EXIT_FAILURE);
+            exit(errno == ENOENT ? 127 : 126);
         }
         else
         {
             // Free memory
-            for(i = 0; i < argc + 1; ++i)
-                free(full_params[i]);
-
-            free(full_params);
+            free_params(argc, full_params);
 
-            if(position == -1)
-            {
-                if(close(pipefd1[1]) == -1)
-                {
-                    ERROR("Can't close pipe write end.", strerror(errno));
-                }  
-            }
-            else if(position == 0)
-            {
-                if(*commandParity)
-                {
-                    if(close(pipefd1[0]) == -1)
-                    {
-                        ERROR("Can't close pipe read end.4", strerror(errno));
-                    } 
-                    if(close(pipefd2[1]) == -1)
-                    {
-                        ERROR("Can't close pipe write end.", strerror(errno));
-                    }  
-                }
-                else
-                {
-                    if(close(pipefd1[1]) == -1)
-                    {
-                        ERROR("Can't close pipe write end.", strerror(errno));
-                    } 
-                    if(close(pipefd2[0]) == -1)
-                    {
-                        ERROR("Can't close pipe read end.5", strerror(errno));
-                    } 
-                }
-            }            
-            else if(position == 1)
-            {
-                if(close(pipefd1[0]) == -1)
-                {
-                    ERROR("Can't close pipe read end.6", strerror(errno));
-                } 
-                if(close(pipefd1[1]) == -1)
-                {
-                    ERROR("Can't close pipe write end.", strerror(errno));
-                }
-            }
             if(is_front)
             {                 
+                close_stage_pipes(position, pipefd1, pipefd2);
                 return process;
             }
         }
     }
+    close_stage_pipes(position, pipefd1, pipefd2);
     return EXIT_SUCCESS;
-} // int run_command(char**, int*, int[2], int[2], int*)
+} // int run_command(char**, int*, int[2], int[2])
+
+
+static pid_t launch_pipeline(char *command, int *has_pipe, int pipefd1[2], int pipefd2[2])
+{
+    char *next_command = command;
+    char *expanded = NULL;
+    pid_t process = EXIT_SUCCESS;
+
+    // Every stage is launched before waiting, the caller waits for the last one
+    while(next_command != NULL)
+    {
+        if(is_empty(next_command))
+            break;
+        // The rest of the line is expanded in a new buffer, the previous
+        // one holds next_command until then
+        char *stage = expand_arguments2(next_command);
+        free(expanded);
+        expanded = stage;
+        if(stage == NULL)
+            break;
+        next_command = stage;
+        process = run_command(&next_command, has_pipe, pipefd1, pipefd2);
+    }
+    free(expanded);
+    return process;
+} // pid_t launch_pipeline(char*, int*, int[2], int[2])
+
+// Run a command line with its stdin or stdout temporarily replaced by fd
+static pid_t launch_redirected(const char *line, int fd, int target)
+{
+    int has_pipe = FALSE;
+    int pipefd1[2];
+    int pipefd2[2];
+
+    // expand_arguments2 works in place, give it its own buffer
+    char *command = calloc(BUFSIZ, sizeof(char));
+    strncpy(command, line, BUFSIZ - 2);
+
+    fflush(stdout);
+    int saved = fcntl(target, F_DUPFD_CLOEXEC, 10);
+    if(saved == -1 || dup2(fd, target) == -1)
+    {
+        ERROR("Can't redirect fan-out stream.", strerror(errno));
+        free(command);
+        return EXIT_FAILURE;
+    }
+
+    pid_t process = launch_pipeline(command, &has_pipe, pipefd1, pipefd2);
+
+    fflush(stdout);
+    dup2(saved, target);
+    close(saved);
+    free(command);
+    return process;
+} // pid_t launch_redirected(const char*, int, int)
+
+static int run_fanout(char *command)
+{
+    char *consumers[FANOUT_MAX];
+    int outputs[FANOUT_MAX];
+    pid_t processes[FANOUT_MAX + 1];
+    int count = 0, i;
+
+    // producer |> (consumer1, consumer2, ...)
+    char *operator = strstr(command, "|>");
+    *operator = '\0';
+    char *open_par = strchr(operator + 2, '(');
+    char *close_par = strrchr(operator + 2, ')');
+    if(open_par == NULL || close_par == NULL || close_par < open_par || is_empty(command))
+    {
+        ERROR("Usage is : cmd |> (cmd1, cmd2, ...)", "\n");
+        return EXIT_FAILURE;
+    }
+    *close_par = '\0';
+
+    char *saved_ptr = NULL;
+    char *consumer = strtok_r(open_par + 1, ",", &saved_ptr);
+    while(consumer != NULL)
+    {
+        if(count == FANOUT_MAX)
+        {
+            ERROR("Too many fan-out consumers.", "\n");
+            return EXIT_FAILURE;
+        }
+        if(!is_empty(consumer))
+            consumers[count++] = consumer;
+        consumer = strtok_r(NULL, ",", &saved_ptr);
+    }
+    if(count == 0)
+    {
+        ERROR("Usage is : cmd |> (cmd1, cmd2, ...)", "\n");
+        return EXIT_FAILURE;
+    }
+
+    int producer[2];
+    if(pipe2(producer, O_CLOEXEC) == -1)
+    {
+        ERROR("FAILED TO CREATE PIPE", strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // The children are waited here, keep child_action away from them
+    sigset_t chld_mask, old_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+
+    // Consumers first, each one reads its own pipe
+    for(i = 0; i < count; ++i)
+    {
+        int consumer_pipe[2];
+        if(pipe2(consumer_pipe, O_CLOEXEC) == -1)
+        {
+            CRITIC("FAILED TO CREATE PIPE", strerror(errno));
+        }
+        processes[i] = launch_redirected(consumers[i], consumer_pipe[0], fileno(stdin));
+        close(consumer_pipe[0]);
+        outputs[i] = consumer_pipe[1];
+    }
+    processes[count] = launch_redirected(command, producer[1], fileno(stdout));
+    close(producer[1]);
+
+    // A consumer may exit early, the shell must survive the EPIPE
+    struct sigaction ignore_action, old_sigpipe_action;
+    memset(&ignore_action, 0, sizeof(ignore_action));
+    ignore_action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &ignore_action, &old_sigpipe_action);
+
+    struct fanout fan;
+    if(fanout_start(&fan, producer[0], outputs, count) == 0)
+    {
+        // Ctrl-C stops the pump, the consumers get end of file
+        control_take_interrupt();
+        while(!fan.done && !control_take_interrupt())
+        {
+            if(event_poll(-1) == -1)
+                break;
+        }
+    }
+    else
+    {
+        close(producer[0]);
+        fan.done = TRUE;
+        fan.buffer = NULL;
+        for(i = 0; i < count; ++i)
+            close(outputs[i]);
+    }
+    fanout_finish(&fan);
+
+    sigaction(SIGPIPE, &old_sigpipe_action, NULL);
+
+    // The line status is the producer one
+    int status, result = EXIT_FAILURE;
+    for(i = 0; i <= count; ++i)
+    {
+        if(processes[i] > 1 && waitpid(processes[i], &status, 0) == processes[i] && i == count)
+            result = exit_status(status);
+    }
+    // Inner pipeline stages
+    pid_t reaped;
+    while((reaped = waitpid(-1, &status, WNOHANG)) > 0)
+        jobs_reaped(reaped, status);
+    wait_process = -1;
+
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    return result;
+} // int run_fanout(char*)
+
+// Shell status of a waited process, 128 + signal when it was killed
+static int exit_status(int status)
+{
+    if(WIFSIGNALED(status))
+        return 128 + WTERMSIG(status);
+    return WEXITSTATUS(status);
+} // int exit_status(int)
+
+// Children still running, the finished ones are reaped on the way
+static int has_pending_jobs(void)
+{
+    pid_t pid;
+    int status;
+
+    while((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        jobs_reaped(pid, status);
+        tasks_reaped(pid, status);
+    }
+    return pid == 0;
+} // int has_pending_jobs()
+
+// Children child_action could not reach behind the front process
+static void reap_pending_children(void)
+{
+    if(reap_pending)
+    {
+        reap_pending = FALSE;
+        has_pending_jobs();
+    }
+} // reap_pending_children()
+
+/*
+ * Here-document body of node with its variables expanded, NULL on a
+ * bad expansion. Only called when the body has something to expand.
+ */
+static char* expand_body(const struct control_node *node)
+{
+    // Expansions rarely double a body, ERROR tells when they do
+    size_t size = strlen(node->body) * 2 + BUFSIZ;
+    char *expanded = malloc(size);
+    if(expanded == NULL)
+        return NULL;
+    if(vars_expand(node->body, expanded, size) == -1)
+    {
+        free(expanded);
+        return NULL;
+    }
+    return expanded;
+} // char* expand_body(const struct control_node*)
+
+// Simple command of a control tree, expanded on each run
+static int run_line(const struct control_node *node, int tail)
+{
+    char command[BUFSIZ];
+    char *body = NULL;
+    int status;
+
+    // run_command tokenizes in place, the tree text is kept
+    snprintf(command, BUFSIZ - 2, "%s", node->text);
+
+    // Nothing runs on a bad expansion
+    if(!expand_variables(command))
+        return EXIT_FAILURE;
+    // A quoted delimiter or a body without $ is used as it is
+    if(node->body != NULL && !node->literal && strchr(node->body, '$') != NULL
+       && (body = expand_body(node)) == NULL)
+        return EXIT_FAILURE;
+
+    here_body = body != NULL ? body : node->body;
+    here_body_len = here_body != NULL ? strlen(here_body) : 0;
+    status = launch_line(command, tail);
+    here_body = NULL;
+    here_body_len = 0;
+    free(body);
+    return status;
+} // int run_line(const struct control_node*, int)
+
+// Runs an expanded command line and waits for it
+static int launch_line(char *command, int tail)
+{
+    int has_pipe = FALSE;
+    int pipefd1[2];
+    int pipefd2[2];
+
+    // Fan-out, waits for the producer and all the consumers
+    if(strstr(command, "|>") != NULL)
+    {
+        stats_add(STATS_COMMANDS);
+        return run_fanout(command);
+    }
+
+    stats_add(STATS_COMMANDS);
+
+    // A deadline puts the forked front stages in a process group of
+    // their own, the shell outlives them to signal it
+    long long limit = deadline_parse(vars_get(DEADLINE_VAR));
+    if(limit > 0)
+        front_group = 0;
+
+    // Jobs are looked for before the stages of the pipeline are forked
+    tail_command = tail && limit <= 0;
+    tail_jobs = tail_command && has_pending_jobs();
+
+    // if the pipeline started a new process with fork (0 is built in, 1 is failure)
+    last_status = EXIT_SUCCESS;
+    pid_t process = launch_pipeline(command, &has_pipe, pipefd1, pipefd2);
+    tail_command = FALSE;
+    if(process > 1 && limit > 0)
+        return wait_deadline(process, limit, deadline_grace());
+    front_group = -1;
+    if(process == EXIT_FAILURE)
+        return EXIT_FAILURE;
+    if(process > 1)
+    {
+        int status;
+        // Wait pid of child
+        pid_t waited = event_wait_pid(process, &status);
+        wait_process = -1;
+        return waited == process ? exit_status(status) : EXIT_FAILURE;
+    }
+    return last_status;
+} // int launch_line(char*, int)
 
 
 /*
@@ -919,18 +2732,24 @@ void usage()
     fprintf(stderr, "Usage: [options] ]\n" );
     fprintf(stderr, "\tOptions: \n" );
     fprintf(stderr, "\t\t-h  \t : help\n" );
-    fprintf(stderr, "\t\t-i  \t : interactive (default)\n" );
+    fprintf(stderr, "\t\t-i  \t : interactive (default on a terminal)\n" );
 } // usage()
 
 int main(int argc_l, char **argv_l)
 {
-    int opt, interactive=FALSE;
+    int opt;
 
     FILE *input = stdin;
-    interactive=TRUE;
     int script = FALSE;
 
-    
+    // $0, the script when one is run
+    const char *name = argv_l[0];
+
+    // Without -c or -i, a terminal on stdin makes the shell interactive
+    int forced = FALSE;
+
+    // Diagnostics go to stderr, coloured only on a terminal
+    log_init();
 
     while ((opt = getopt(argc_l, argv_l, "ihc:")) > 0) {
         switch (opt) {
@@ -938,7 +2757,8 @@ int main(int argc_l, char **argv_l)
                 usage();
                 exit(EXIT_SUCCESS);
             case 'c':
-                input = fopen(argv_l[2], "r");
+                // Commands must not inherit the script
+                input = fopen(optarg, "re");
                 if(input == NULL)
                 {
                     ERROR("Error while opening script file", "\n");
@@ -946,11 +2766,11 @@ int main(int argc_l, char **argv_l)
                     break;
                 }
                 script = TRUE;
-                interactive=FALSE;
+                name = optarg;
                 break;
             case 'i':
                 input = stdin;
-                interactive=TRUE;
+                forced = TRUE;
                 break;
             default:
                 usage();
@@ -958,81 +2778,134 @@ int main(int argc_l, char **argv_l)
         }
     }
 
+    interactive = forced || (!script && isatty(fileno(stdin)));
     if (interactive==TRUE) {
         printf( "\n\n\033[34mHello from ASR2 Shell\n");
         printf( "Enter 'help' for a list of built-in commands.\033[37m\n\n");
     }
 
-    // INIT PROMT INFO AND CURRENT PATH
-    if(getcwd(wd, PATH_MAX) == NULL)
+    // CURRENT PATH, the prompt info waits for the first prompt
+    if(dirs_init() == -1)
     {
         ERROR("Can't get current directory", strerror(errno));
     }
 
-    get_user_machine_name(user_machine_name);
-
-    clean_path(wd);
-
     char *command;
-    char *next_command = NULL;
     command = (char *) calloc(BUFSIZ, sizeof(char));
 
+    // Lines of an unfinished construct, parsed again with each new line
+    char *program = NULL;
+    size_t program_len = 0, program_size = 0;
+
     // Signals management
     manage_signals();
+    event_init();
+    stats_init();
+    jobs_init();
 
-    // Pipe management
-    int has_pipe = FALSE;
-    int pipefd1[2];
-    int pipefd2[2];
-    int commandParity = 0;
+    vars_set_int("?", last_status);
+    vars_set("0", name);
 
     while (TRUE) {
 
         if(script && fgetc(input) == EOF)
         {
+            if(program_len > 0)
+            {
+                ERROR("Syntax error", control_error());
+                program_len = 0;
+                continuation = FALSE;
+                last_status = 2;
+            }
+
+            // Without a terminal the shell ends with its script
+            if(!isatty(fileno(stdin)))
+                break;
             input = stdin;
             script = FALSE;
+            interactive = TRUE;
         }
         else if(script)
             fseek(input, -1, SEEK_CUR);
 
-        if (!next_command) {
+        // Output and end of the captured jobs, between two commands
+        reap_pending_children();
+        if(jobs_update() > 0 && event_poll(0) > 0)
+            jobs_update();
 
-            int value;
-            if ((value = get_command(input, command)))
+        int value;
+        if ((value = get_command(input, command)))
+        {
+            if(program_len > 0)
+            {
+                ERROR("Syntax error", control_error());
+            }
+            else if(interactive || !feof(input))
             {
                 ERROR("Command management", strerror(errno));
-                break;
             }
-            next_command = command;
+            break;
         }
+        if(!script && isatty(fileno(input)))
+            record_history(command);
 
-        if (is_empty(next_command) || ! expand_arguments2(next_command)) {
-            free(command);
-            command = (char *) calloc(BUFSIZ, sizeof(char));
-            next_command = NULL;
-            continue;
+        // Ctrl-C while continuing drops the construct
+        if(control_take_interrupt() && program_len > 0)
+        {
+            program_len = 0;
+            continuation = FALSE;
         }
 
-        // if run_command started a new process with fork (0 is built in, 1 is failure)
-        pid_t process = run_command(&next_command, &has_pipe, pipefd1, pipefd2, &commandParity);
-        if(process > 1)
+        size_t len = strlen(command);
+        if(program_len + len + 1 > program_size)
         {
-            int status;
-            // Wait pid of child
-            int ret;
-            do
-	    {
-		waitpid(process, &status, 0);
-            }while(!WIFEXITED(status) && !WIFSIGNALED(status));
-            wait_process = -1;
+            size_t size = program_size ? program_size * 2 : BUFSIZ;
+            while(size < program_len + len + 1)
+                size *= 2;
+            char *grown = realloc(program, size);
+            if(grown == NULL)
+            {
+                CRITIC("Out of memory", strerror(errno));
+            }
+            program = grown;
+            program_size = size;
         }
+        memcpy(program + program_len, command, len + 1);
+        program_len += len;
+
+        // Only the delimiter line can end a here-document body
+        if(continuation && control_heredoc_line(command))
+            continue;
 
-        if(next_command == NULL){
-            free(command);
-            command = (char *) calloc(BUFSIZ, sizeof(char));
-        }         
+        // Parsed once, loop bodies are not parsed again on each iteration
+        struct control_node *tree;
+        int parsed = control_parse(program, &tree);
+        continuation = parsed == CONTROL_INCOMPLETE;
+        if(continuation)
+            continue;
+        program_len = 0;
+
+        if(parsed == CONTROL_ERROR)
+        {
+            ERROR("Syntax error", control_error());
+            last_status = 2;
+            vars_set_int("?", last_status);
+            continue;
+        }
+        // Nothing runs after the end of a script without a terminal,
+        // its last command can replace the shell
+        int tail = FALSE;
+        if(script && !isatty(fileno(stdin)))
+        {
+            int next = fgetc(input);
+            tail = next == EOF;
+            if(!tail)
+                ungetc(next, input);
+        }
+        last_status = control_run(tree, run_line, tail);
+        control_free(tree);
     }
+    free(program);
     free(command);
-    return EXIT_SUCCESS;
+    return last_status;
 } // int main(int, char**)
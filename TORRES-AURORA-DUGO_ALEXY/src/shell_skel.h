@@ -10,6 +10,7 @@
 // SYSTEM INCLUDES
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
@@ -19,6 +20,34 @@
 #include <pwd.h>
 #include <glob.h>
 
+// MODULES INCLUDES
+#include "log.h"
+#include "placement.h"
+#include "event.h"
+#include "fanout.h"
+#include "copy.h"
+#include "history.h"
+#include "editor.h"
+#include "complete.h"
+#include "vars.h"
+#include "arith.h"
+#include "condition.h"
+#include "control.h"
+#include "function.h"
+#include "stats.h"
+#include "heredoc.h"
+#include "input.h"
+#include "dirs.h"
+#include "watch.h"
+#include "jobs.h"
+#include "walk.h"
+#include "cache.h"
+#include "tasks.h"
+#include "deadline.h"
+
+// Generated from builtins.def by tools/builtins_gen.c
+#include "builtins_hash.h"
+
 
 // Define FALSE and TRUE values, makes the code more understandable.
 #ifndef FALSE
@@ -31,47 +60,6 @@
 // Max args count
 #define ARG_MAX 10
 
-// Output MACRO
-#define CRITIC(OUT, CODE) do { \
-    fputs("\033[31m", stderr); \
-    fputs("[CRITIC] ", stderr); \
-    fputs(OUT, stderr); \
-    fputs("\n", stderr); \
-    fputs(CODE, stderr); \
-    fputs("\n", stderr); \
-    fputs("\033[37m", stderr); \
-    fflush(stderr); \
-    exit(EXIT_FAILURE); \
-}while(0);
-
-#define ERROR(OUT, CODE) do { \
-    fputs("\033[91m", stderr); \
-    fputs("[ERROR] ", stderr); \
-    fputs(OUT, stderr); \
-    fputs("\n", stderr); \
-    fputs(CODE, stderr); \
-    fputs("\n", stderr); \
-    fputs("\033[37m", stderr); \
-    fflush(stderr); \
-}while(0);
-
-#define WARNING(OUT, CODE) do { \
-    fputs("\033[93m", stdout); \
-    fputs("[WARNING] ", stdout); \
-    fputs(OUT, stdout); \
-    fputs("\n", stdout); \
-    fputs(CODE, stdout); \
-    fputs("\n", stdout); \
-    fputs("\033[37m", stdout); \
-    fflush(stdout); \
-}while(0);
-
-#define INFO(OUT) do { \
-    fputs(OUT, stdout); \
-    fputs("\n", stdout); \
-    fflush(stdout); \
-}while(0);
-
 /*
  *removed this define since it was already defined in dirent.h
  *#define PATH_MAX 1000
@@ -80,18 +68,54 @@
 // Prompt char
 static char *prompt_str = "> ";
 
-// User and hostname
+// User and hostname, looked up when the first prompt is shown
 static char user_machine_name[PATH_MAX];
 static char username[PATH_MAX];
+static int identity_ready = FALSE;
 
-// Current directory
+// Current directory, cleaned when a prompt shows it after a change
 static char wd[PATH_MAX];
+static int wd_stale = TRUE;
+
+// Terminal or -i : banner, prompts and completion, not for scripts
+static int interactive = FALSE;
 
 // Lock that tells us if we are waiting for a front process to end
 static int wait_process = -1;
 
+// child_action stopped at the front process, other children may have
+// ended behind it
+static volatile sig_atomic_t reap_pending = FALSE;
+
 static int no_prompt = TRUE;
 
+// Lines read so far belong to an unfinished if, while or for
+static int continuation = FALSE;
+
+// Exit status of the last command, builtins run in the shell set it
+static int last_status = EXIT_SUCCESS;
+
+// The command being launched is the last one of the shell, with jobs
+// still running it is forked anyway
+static int tail_command = FALSE;
+static int tail_jobs = FALSE;
+
+// Here-document of the command being launched, expanded
+static const char *here_body = NULL;
+static size_t here_body_len = 0;
+
+// Placement defaults for every command and for background jobs
+static struct placement default_placement;
+static struct placement background_placement;
+
+// Placement of the pipeline being launched and index of its current stage
+static struct placement pipeline_placement;
+static int pipeline_stage = 0;
+
+// Process group of a front command with a deadline, 0 until its first
+// stage is forked, -1 without a deadline. Ctrl-C is forwarded to it.
+static volatile pid_t front_group = -1;
+
 /*
  * ############################################################
  * #######   SIGNALS MANAGEMENT
@@ -125,13 +149,30 @@ static int builtin_help(int argc, char **argv);
 static int builtin_cd(int argc, char **argv);
 static int builtin_pwd(int argc, char **argv);
 static int builtin_exec(int argc, char **argv);
+static int builtin_log(int argc, char **argv);
+static int builtin_sched(int argc, char **argv);
+static int builtin_cat(int argc, char **argv);
+static int builtin_history(int argc, char **argv);
+static int builtin_let(int argc, char **argv);
+static int builtin_test(int argc, char **argv);
+static int builtin_local(int argc, char **argv);
+static int builtin_stats(int argc, char **argv);
+static int builtin_cached(int argc, char **argv);
+static int builtin_read(int argc, char **argv);
+static int builtin_mapfile(int argc, char **argv);
+static int builtin_pushd(int argc, char **argv);
+static int builtin_popd(int argc, char **argv);
+static int builtin_dirs(int argc, char **argv);
+static int builtin_watch(int argc, char **argv);
+static int builtin_jobs(int argc, char **argv);
+static int builtin_wait(int argc, char **argv);
+static int builtin_tasks(int argc, char **argv);
+static int builtin_timeout(int argc, char **argv);
 static int builtin_exit(int argc, char **argv) {exit(EXIT_SUCCESS);}
 static struct built_in_command bltins[] = {
-    {"cd", "Change working directory", builtin_cd},
-    {"exec", "Exec command, replacing this shell with the exec'd process", builtin_exec},
-    {"pwd", "Print working directory", builtin_pwd},
-    {"exit", "Exit from shell()", builtin_exit},
-    {"help", "List shell built-in commands", builtin_help},
+#define BUILTIN(name, descr, function) {name, descr, function},
+#include "builtins.def"
+#undef BUILTIN
     {NULL, NULL, NULL}
 }; // static struct built_in_command bltins[]
 
@@ -145,13 +186,53 @@ static struct built_in_command bltins[] = {
 // static int expand_arguments(char *command);
 
 static void clean_path(char *wd);
+static void update_wd(void);
+static void print_dirs(void);
 static int is_empty(const char *command);
 static void get_user_machine_name(char *name);
+static void prepare_prompt(void);
 static int get_command(FILE * source, char *command);
-static int expand_arguments2(char *command);
+static void record_history(const char *command);
+static int append_word(char **line, size_t *len, size_t *size, const char *word);
+static char* expand_arguments2(char *command);
+static int expand_variables(char *command);
 static char** get_background_commands(char *command, int *has_background, int *has_last, int *commands_count);
 static void clean_command(char *command);
-static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd2[2], int *commandParity);
+static void watch_changed(int fd, short revents, void *data);
+static pid_t start_group(const char *line, int waited);
+static void cancel_watched(pid_t process);
+static int wait_deadline(pid_t process, long long limit, long long grace);
+static long long deadline_grace(void);
+static void assign_fields(char *line, int count, char **names);
+static int mapfile_add(const char *line, size_t len, void *data);
+// Redirections of a command, files are opened after fork
+struct redirection {
+    char *input;                /* < file */
+    char *output;               /* > file */
+    char *here_string;          /* <<< word */
+    int here_document;          /* << delimiter, the body is here_body */
+}; // struct redirection
+
+static int parse_redirections(int *argc, char **parameters, struct redirection *redir);
+static int open_input(const struct redirection *redir);
+static int open_redirections(const struct redirection *redir, int saved[2]);
+static void restore_redirections(int saved[2]);
+static int find_builtin(const char *name, int argc, char **argv);
+static void close_stage_pipes(int position, int pipefd1[2], int pipefd2[2]);
+static void free_params(int argc, char **params);
+static void apply_placement(int is_front, const struct placement *command_placement, int stage);
+static int cached_key(int argc, char **argv, const struct redirection *redir, struct cache_key *key);
+static void run_cached(const struct cache_key *key);
+static int run_command(char **command, int *has_pipe, int pipefd1[2], int pipefd2[2]);
+static pid_t launch_pipeline(char *command, int *has_pipe, int pipefd1[2], int pipefd2[2]);
+static pid_t launch_redirected(const char *line, int fd, int target);
+static int run_fanout(char *command);
+static int exit_status(int status);
+static int has_pending_jobs(void);
+static void reap_pending_children(void);
+static char* expand_body(const struct control_node *node);
+static int run_line(const struct control_node *node, int tail);
+static int launch_line(char *command, int tail);
 
 
 /*
@@ -0,0 +1,90 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <unistd.h>
+#include <fcntl.h>
+
+// HEADER
+#include "stats.h"
+
+static long counters[STATS_COUNT];
+
+// Forked children inherit the counters and the exit handler, only the
+// shell itself saves them
+static pid_t shell_pid = -1;
+
+static const char *names[STATS_COUNT] = {
+    "commands", "forks", "builtins", "functions", "tail_execs", "tail_forks",
+    "cache_hits", "cache_misses", "timeouts"
+};
+
+/*
+ * ############################################################
+ * #######   STATISTICS
+ * ############################################################
+ */
+
+void stats_init(void)
+{
+    shell_pid = getpid();
+    atexit(stats_save);
+} // stats_init()
+
+void stats_add(int counter)
+{
+    ++counters[counter];
+} // stats_add(int)
+
+long stats_get(int counter)
+{
+    return counters[counter];
+} // long stats_get(int)
+
+void stats_reset(void)
+{
+    memset(counters, 0, sizeof(counters));
+} // stats_reset()
+
+void stats_print(FILE *out)
+{
+    int i;
+
+    for(i = 0; i < STATS_COUNT; ++i)
+        fprintf(out, "%-12s %ld\n", names[i], counters[i]);
+
+    long cached = counters[STATS_CACHE_HITS] + counters[STATS_CACHE_MISSES];
+    if(cached > 0)
+        fprintf(out, "%-12s %.1f%%\n", "cache_rate", 100.0 * counters[STATS_CACHE_HITS] / cached);
+} // stats_print(FILE*)
+
+/*
+ * One line "pid=... name=value ..." per process in $ASR2_STATS, written
+ * with a single O_APPEND write so concurrent shells don't mix lines.
+ * Called at exit and right before a tail exec replaces the shell.
+ */
+void stats_save(void)
+{
+    const char *path = getenv(STATS_FILE_VAR);
+    char line[512];
+    int len, i, fd;
+
+    if(path == NULL || path[0] == '\0' || getpid() != shell_pid)
+        return;
+
+    len = snprintf(line, sizeof(line), "pid=%ld", (long)getpid());
+    for(i = 0; i < STATS_COUNT; ++i)
+        len += snprintf(line + len, sizeof(line) - len, " %s=%ld", names[i], counters[i]);
+    len += snprintf(line + len, sizeof(line) - len, "\n");
+
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if(fd == -1)
+        return;
+    if(write(fd, line, len) != len)
+    {
+        // Statistics are best effort
+    }
+    close(fd);
+} // stats_save()
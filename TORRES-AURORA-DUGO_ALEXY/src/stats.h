@@ -0,0 +1,35 @@
+#ifndef DEF_STATS_H
+#define DEF_STATS_H
+
+// STD INCLUDES
+#include <stdio.h>
+
+// When set, the counters are appended to this file as the shell exits
+#define STATS_FILE_VAR "ASR2_STATS"
+
+// Counters
+#define STATS_COMMANDS      0   /* simple commands run */
+#define STATS_FORKS         1
+#define STATS_BUILTINS      2   /* builtins run in the shell */
+#define STATS_FUNCTIONS     3   /* functions called in the shell */
+#define STATS_TAIL_EXECS    4   /* last commands exec'd without fork */
+#define STATS_TAIL_FORKS    5   /* last commands forked, jobs were pending */
+#define STATS_CACHE_HITS    6   /* cached commands replayed */
+#define STATS_CACHE_MISSES  7   /* cached commands run and stored */
+#define STATS_TIMEOUTS      8   /* commands stopped by their deadline */
+#define STATS_COUNT         9
+
+/*
+ * ############################################################
+ * #######   STATISTICS
+ * ############################################################
+ */
+
+void stats_init(void);
+void stats_add(int counter);
+long stats_get(int counter);
+void stats_reset(void);
+void stats_print(FILE *out);
+void stats_save(void);
+
+#endif // DEF_STATS_H
@@ -0,0 +1,605 @@
+// Needed for getline and the e mode of fopen
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <errno.h>
+#include <limits.h>
+
+// HEADER
+#include "tasks.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+struct task {
+    char name[TASKS_NAME_SIZE];
+    char *command;
+    char *names;                /* dependencies as read, until resolved */
+    int *depends;
+    int depend_count;
+    int *next;                  /* tasks depending on this one */
+    int next_count;
+    int waiting;                /* dependencies not done yet */
+    int height;                 /* tasks on the longest chain from this one */
+    int state;
+    int lane;                   /* running slot, the thread of the trace */
+    pid_t pid;
+    volatile sig_atomic_t reaped;
+    int status;
+    long long start;            /* microseconds */
+    long long end;
+    long long chain;            /* longest chain of run tasks ending here */
+    int previous;               /* dependency before it on that chain */
+}; // struct task
+
+static struct task *tasks = NULL;
+static int count = 0;
+
+// Topological order, dependencies first
+static int *order = NULL;
+
+// Start of the first task, microseconds
+static long long origin = 0;
+
+static int failures = 0;
+static int lanes[TASKS_JOBS_MAX];
+
+/*
+ * ############################################################
+ * #######   HELPERS
+ * ############################################################
+ */
+
+// Monotonic microseconds, async signal safe
+static long long now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+} // long long now_us()
+
+static int find(const char *name)
+{
+    int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(strcmp(tasks[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+} // int find(const char*)
+
+static void load_error(const char *path, long line, const char *reason)
+{
+    char where[PATH_MAX + 32];
+
+    snprintf(where, sizeof(where), "tasks : %s:%ld", path, line);
+    ERROR(where, reason);
+} // load_error(const char*, long, const char*)
+
+/*
+ * Adds the task of line "name [dependency ...] : command". Returns 0,
+ * 1 for a blank or comment line, -1 on a bad line.
+ */
+static int parse_line(char *line, const char **reason)
+{
+    char *cursor, *separator = NULL, *command, *end, *saved;
+
+    line += strspn(line, " \t\n");
+    if(*line == '\0' || *line == '#')
+        return 1;
+    for(cursor = line; *cursor != '\0'; cursor += strspn(cursor, " \t\n"))
+    {
+        if(cursor[0] == TASKS_SEPARATOR[0] && (cursor[1] == '\0' || strchr(" \t\n", cursor[1]) != NULL))
+        {
+            separator = cursor;
+            break;
+        }
+        cursor += strcspn(cursor, " \t\n");
+    }
+    if(separator == NULL)
+    {
+        *reason = "missing " TASKS_SEPARATOR " before the command";
+        return -1;
+    }
+
+    *separator = '\0';
+    command = separator + 1;
+    command += strspn(command, " \t");
+    end = command + strlen(command);
+    while(end > command && (end[-1] == '\n' || end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    *end = '\0';
+
+    char *name = strtok_r(line, " \t", &saved);
+    if(name == NULL || *command == '\0')
+    {
+        *reason = "a task needs a name and a command";
+        return -1;
+    }
+    if(strlen(name) >= TASKS_NAME_SIZE)
+    {
+        *reason = "task name too long";
+        return -1;
+    }
+    if(find(name) != -1)
+    {
+        *reason = "task defined twice";
+        return -1;
+    }
+
+    if(count % 16 == 0)
+    {
+        struct task *grown = realloc(tasks, (count + 16) * sizeof(struct task));
+        if(grown == NULL)
+        {
+            *reason = strerror(errno);
+            return -1;
+        }
+        tasks = grown;
+    }
+    struct task *task = &tasks[count];
+    memset(task, 0, sizeof(*task));
+    strcpy(task->name, name);
+    task->command = strdup(command);
+    task->names = strdup(saved != NULL ? saved : "");
+    if(task->command == NULL || task->names == NULL)
+    {
+        free(task->command);
+        free(task->names);
+        *reason = strerror(errno);
+        return -1;
+    }
+    ++count;
+    return 0;
+} // int parse_line(char*, const char**)
+
+// Dependencies by index and the tasks depending on each one
+static int resolve(const char **reason, int *task)
+{
+    int i, j;
+
+    for(*task = 0; *task < count; ++*task)
+    {
+        struct task *current = &tasks[*task];
+        char *saved, *name;
+
+        current->depends = malloc((strlen(current->names) / 2 + 1) * sizeof(int));
+        if(current->depends == NULL)
+        {
+            *reason = strerror(errno);
+            return -1;
+        }
+        for(name = strtok_r(current->names, " \t", &saved); name != NULL; name = strtok_r(NULL, " \t", &saved))
+        {
+            int depend = find(name);
+            if(depend == -1)
+            {
+                *reason = "unknown dependency";
+                return -1;
+            }
+            current->depends[current->depend_count++] = depend;
+            ++tasks[depend].next_count;
+        }
+        free(current->names);
+        current->names = NULL;
+    }
+
+    for(i = 0; i < count; ++i)
+    {
+        tasks[i].next = malloc((tasks[i].next_count + 1) * sizeof(int));
+        if(tasks[i].next == NULL)
+        {
+            *task = i;
+            *reason = strerror(errno);
+            return -1;
+        }
+        tasks[i].next_count = 0;
+    }
+    for(i = 0; i < count; ++i)
+    {
+        for(j = 0; j < tasks[i].depend_count; ++j)
+        {
+            struct task *depend = &tasks[tasks[i].depends[j]];
+            depend->next[depend->next_count++] = i;
+        }
+    }
+    return 0;
+} // int resolve(const char**, int*)
+
+// Kahn order of the tasks, the index of a task on a cycle if any
+static int sort_tasks(void)
+{
+    int head = 0, tail = 0, i, j;
+
+    order = malloc((count + 1) * sizeof(int));
+    if(order == NULL)
+        return 0;
+    for(i = 0; i < count; ++i)
+    {
+        tasks[i].waiting = tasks[i].depend_count;
+        if(tasks[i].waiting == 0)
+            order[tail++] = i;
+    }
+    while(head < tail)
+    {
+        struct task *task = &tasks[order[head++]];
+        for(j = 0; j < task->next_count; ++j)
+        {
+            if(--tasks[task->next[j]].waiting == 0)
+                order[tail++] = task->next[j];
+        }
+    }
+    if(tail == count)
+        return -1;
+    for(i = 0; i < count; ++i)
+    {
+        if(tasks[i].waiting > 0)
+            return i;
+    }
+    return 0;
+} // int sort_tasks()
+
+// Marks what depends on a failed task as skipped
+static void skip_next(const struct task *task)
+{
+    int i;
+
+    for(i = 0; i < task->next_count; ++i)
+    {
+        struct task *next = &tasks[task->next[i]];
+        if(next->state == TASK_WAITING || next->state == TASK_READY)
+        {
+            next->state = TASK_SKIPPED;
+            skip_next(next);
+        }
+    }
+} // skip_next(const struct task*)
+
+/*
+ * ############################################################
+ * #######   TASK GRAPH
+ * ############################################################
+ */
+
+/*
+ * Reads the tasks of path, one per line : "name [dependency ...] :
+ * command". Dependencies may be defined further down, # starts a
+ * comment line. Returns -1 on a bad file, a missing dependency or a
+ * cycle.
+ */
+int tasks_load(const char *path)
+{
+    const char *reason = NULL;
+    char *line = NULL;
+    size_t size = 0;
+    long number = 0;
+    int i, task;
+
+    tasks_free();
+    FILE *file = fopen(path, "re");
+    if(file == NULL)
+    {
+        ERROR(path, strerror(errno));
+        return -1;
+    }
+    while(getline(&line, &size, file) != -1)
+    {
+        ++number;
+        if(parse_line(line, &reason) == -1)
+        {
+            load_error(path, number, reason);
+            free(line);
+            fclose(file);
+            tasks_free();
+            return -1;
+        }
+    }
+    free(line);
+    fclose(file);
+
+    if(resolve(&reason, &task) == -1)
+    {
+        ERROR(tasks[task].name, reason);
+        tasks_free();
+        return -1;
+    }
+    if((task = sort_tasks()) != -1)
+    {
+        if(order == NULL)
+        {
+            ERROR("tasks", strerror(errno));
+        }
+        else
+        {
+            ERROR("tasks : dependency cycle through", tasks[task].name);
+        }
+        tasks_free();
+        return -1;
+    }
+
+    // Longest chains first keeps the critical path going
+    for(i = count - 1; i >= 0; --i)
+    {
+        struct task *current = &tasks[order[i]];
+        int j;
+        current->height = 1;
+        for(j = 0; j < current->next_count; ++j)
+        {
+            if(tasks[current->next[j]].height + 1 > current->height)
+                current->height = tasks[current->next[j]].height + 1;
+        }
+    }
+    for(i = 0; i < count; ++i)
+    {
+        tasks[i].waiting = tasks[i].depend_count;
+        tasks[i].state = tasks[i].waiting == 0 ? TASK_READY : TASK_WAITING;
+        tasks[i].lane = -1;
+        tasks[i].pid = -1;
+        tasks[i].previous = -1;
+    }
+    memset(lanes, 0, sizeof(lanes));
+    origin = 0;
+    failures = 0;
+    return count;
+} // int tasks_load(const char*)
+
+// Also called by forked children, which don't run the graph
+void tasks_free(void)
+{
+    struct task *old = tasks;
+    int i, old_count = count;
+
+    // child_action looks the table up, empty it first
+    count = 0;
+    tasks = NULL;
+    for(i = 0; i < old_count; ++i)
+    {
+        free(old[i].command);
+        free(old[i].names);
+        free(old[i].depends);
+        free(old[i].next);
+    }
+    free(old);
+    free(order);
+    order = NULL;
+} // tasks_free()
+
+// Ready task on the longest chain, -1 if none or every lane is busy
+int tasks_next(void)
+{
+    int i, best = -1;
+
+    for(i = 0; i < TASKS_JOBS_MAX && lanes[i]; ++i);
+    if(i == TASKS_JOBS_MAX)
+        return -1;
+    for(i = 0; i < count; ++i)
+    {
+        if(tasks[i].state == TASK_READY && (best == -1 || tasks[i].height > tasks[best].height))
+            best = i;
+    }
+    return best;
+} // int tasks_next()
+
+const char* tasks_command(int task)
+{
+    return tasks[task].command;
+} // const char* tasks_command(int)
+
+// Called with SIGCHLD blocked, pid -1 when the fork failed
+void tasks_started(int task, pid_t pid)
+{
+    struct task *current = &tasks[task];
+
+    current->start = now_us();
+    if(origin == 0)
+        origin = current->start;
+    for(current->lane = 0; lanes[current->lane]; ++current->lane);
+    lanes[current->lane] = 1;
+    current->pid = pid;
+    current->state = TASK_RUNNING;
+    if(pid == -1)
+    {
+        current->end = current->start;
+        current->status = 127 << 8;
+        current->reaped = 1;
+    }
+} // tasks_started(int, pid_t)
+
+// Status of a task reaped by child_action, async signal safe
+void tasks_reaped(pid_t pid, int status)
+{
+    int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(tasks[i].state == TASK_RUNNING && tasks[i].pid == pid && !tasks[i].reaped)
+        {
+            tasks[i].status = status;
+            tasks[i].end = now_us();
+            tasks[i].reaped = 1;
+            return;
+        }
+    }
+} // tasks_reaped(pid_t, int)
+
+/*
+ * Ends the reaped tasks, readies what depended on them or skips it on
+ * a failure. Returns the number of tasks still running.
+ */
+int tasks_update(void)
+{
+    int i, j, running = 0;
+
+    for(i = 0; i < count; ++i)
+    {
+        struct task *task = &tasks[i];
+        if(task->state != TASK_RUNNING)
+            continue;
+        if(!task->reaped)
+        {
+            ++running;
+            continue;
+        }
+        lanes[task->lane] = 0;
+        double elapsed = (task->end - task->start) / 1e3;
+        if(WIFEXITED(task->status) && WEXITSTATUS(task->status) == 0)
+        {
+            task->state = TASK_DONE;
+            for(j = 0; j < task->next_count; ++j)
+            {
+                struct task *next = &tasks[task->next[j]];
+                if(--next->waiting == 0 && next->state == TASK_WAITING)
+                    next->state = TASK_READY;
+            }
+            printf("[%s] done  %.1f ms\n", task->name, elapsed);
+        }
+        else
+        {
+            task->state = TASK_FAILED;
+            ++failures;
+            skip_next(task);
+            if(WIFSIGNALED(task->status))
+                printf("[%s] signal %d  %.1f ms\n", task->name, WTERMSIG(task->status), elapsed);
+            else
+                printf("[%s] exit %d  %.1f ms\n", task->name, WEXITSTATUS(task->status), elapsed);
+        }
+    }
+    fflush(stdout);
+    return running;
+} // int tasks_update()
+
+int tasks_failed(void)
+{
+    return failures;
+} // int tasks_failed()
+
+// Signals the process groups of the running tasks
+void tasks_kill(int signum)
+{
+    int i;
+
+    for(i = 0; i < count; ++i)
+    {
+        if(tasks[i].state == TASK_RUNNING && !tasks[i].reaped && tasks[i].pid > 0)
+            kill(-tasks[i].pid, signum);
+    }
+} // tasks_kill(int)
+
+/*
+ * Counts, wall time, the sum of the task times and the critical path :
+ * the chain of dependent tasks whose times add up to the most.
+ */
+void tasks_report(FILE *out)
+{
+    int i, j, done = 0, failed = 0, last = -1;
+    long long work = 0, wall = 0;
+
+    for(i = 0; i < count; ++i)
+    {
+        struct task *task = &tasks[order[i]];
+        task->chain = 0;
+        task->previous = -1;
+        if(task->state != TASK_DONE && task->state != TASK_FAILED)
+            continue;
+        done += task->state == TASK_DONE;
+        failed += task->state == TASK_FAILED;
+        work += task->end - task->start;
+        if(task->end - origin > wall)
+            wall = task->end - origin;
+        for(j = 0; j < task->depend_count; ++j)
+        {
+            if(tasks[task->depends[j]].chain > task->chain)
+            {
+                task->chain = tasks[task->depends[j]].chain;
+                task->previous = task->depends[j];
+            }
+        }
+        task->chain += task->end - task->start;
+        if(last == -1 || task->chain > tasks[last].chain)
+            last = order[i];
+    }
+
+    fprintf(out, "tasks       %d done, %d failed, %d skipped\n", done, failed, count - done - failed);
+    fprintf(out, "wall        %.1f ms\n", wall / 1e3);
+    fprintf(out, "work        %.1f ms", work / 1e3);
+    if(wall > 0)
+        fprintf(out, " (%.2f parallel)", (double)work / wall);
+    fputc('\n', out);
+    if(last == -1)
+        return;
+
+    // The chain is linked backwards, print it from its first task
+    int *path = malloc(count * sizeof(int)), length = 0;
+    fprintf(out, "critical    %.1f ms", tasks[last].chain / 1e3);
+    if(path != NULL)
+    {
+        for(i = last; i != -1; i = tasks[i].previous)
+            path[length++] = i;
+        fputs(" :", out);
+        for(i = length - 1; i >= 0; --i)
+            fprintf(out, " %s%s", tasks[path[i]].name, i > 0 ? " >" : "");
+        free(path);
+    }
+    fputc('\n', out);
+} // tasks_report(FILE*)
+
+static void json_string(FILE *out, const char *string)
+{
+    fputc('"', out);
+    for(; *string != '\0'; ++string)
+    {
+        if(*string == '"' || *string == '\\')
+            fprintf(out, "\\%c", *string);
+        else if((unsigned char)*string < 0x20)
+            fprintf(out, "\\u%04x", *string);
+        else
+            fputc(*string, out);
+    }
+    fputc('"', out);
+} // json_string(FILE*, const char*)
+
+/*
+ * Writes the tasks which ran as complete events of the Chrome trace
+ * format (chrome://tracing, Perfetto), one thread per lane.
+ */
+int tasks_trace(const char *path)
+{
+    FILE *out = fopen(path, "we");
+    int i, first = 1;
+
+    if(out == NULL)
+        return -1;
+    fputs("{\"traceEvents\":[\n", out);
+    for(i = 0; i < count; ++i)
+    {
+        struct task *task = &tasks[i];
+        if(task->state != TASK_DONE && task->state != TASK_FAILED)
+            continue;
+        fprintf(out, "%s{\"name\":", first ? "" : ",\n");
+        json_string(out, task->name);
+        fprintf(out, ",\"cat\":\"task\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":1,\"tid\":%d,",
+                task->start - origin, task->end - task->start, task->lane);
+        fprintf(out, "\"args\":{\"status\":%d,\"command\":", WIFEXITED(task->status) ? WEXITSTATUS(task->status) : 128 + WTERMSIG(task->status));
+        json_string(out, task->command);
+        fputs("}}", out);
+        first = 0;
+    }
+    fputs("\n],\"displayTimeUnit\":\"ms\"}\n", out);
+    return fclose(out);
+} // int tasks_trace(const char*)
@@ -0,0 +1,43 @@
+#ifndef DEF_TASKS_H
+#define DEF_TASKS_H
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <stdio.h>
+
+// Longest task name
+#define TASKS_NAME_SIZE 64
+
+// Most tasks running at the same time, they are the lanes of the trace
+#define TASKS_JOBS_MAX 64
+
+// Word between the name and dependencies of a task and its command
+#define TASKS_SEPARATOR ":"
+
+// States of a task
+#define TASK_WAITING 0          /* dependencies not done yet */
+#define TASK_READY   1
+#define TASK_RUNNING 2
+#define TASK_DONE    3
+#define TASK_FAILED  4
+#define TASK_SKIPPED 5          /* a dependency failed or the run stopped */
+
+/*
+ * ############################################################
+ * #######   TASK GRAPH
+ * ############################################################
+ */
+
+int tasks_load(const char *path);
+void tasks_free(void);
+int tasks_next(void);
+const char* tasks_command(int task);
+void tasks_started(int task, pid_t pid);
+void tasks_reaped(pid_t pid, int status);
+int tasks_update(void);
+int tasks_failed(void);
+void tasks_kill(int signum);
+void tasks_report(FILE *out);
+int tasks_trace(const char *path);
+
+#endif // DEF_TASKS_H
@@ -0,0 +1,590 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+// SYSTEM INCLUDES
+#include <unistd.h>
+
+// HEADER
+#include "vars.h"
+#include "arith.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   TABLE
+ * ############################################################
+ */
+
+static struct var **table = NULL;
+static size_t bucket_count = 0;
+static size_t var_count = 0;
+
+// Innermost function call, NULL out of functions
+static struct var_frame *frames = NULL;
+
+static size_t hash_name(const char *name)
+{
+    size_t hash = 2166136261u;
+
+    for(; *name != '\0'; ++name)
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash;
+} // size_t hash_name(const char*)
+
+static struct var* find(const char *name)
+{
+    struct var *var;
+
+    if(table == NULL)
+        return NULL;
+    for(var = table[hash_name(name) & (bucket_count - 1)]; var != NULL; var = var->next)
+    {
+        if(strcmp(var->name, name) == 0)
+            return var;
+    }
+    return NULL;
+} // struct var* find(const char*)
+
+static int grow(void)
+{
+    size_t count = bucket_count ? bucket_count * 2 : VARS_BUCKETS;
+    struct var **grown = calloc(count, sizeof(struct var*));
+    size_t i;
+
+    if(grown == NULL)
+        return -1;
+    for(i = 0; i < bucket_count; ++i)
+    {
+        while(table[i] != NULL)
+        {
+            struct var *var = table[i];
+            table[i] = var->next;
+            size_t bucket = hash_name(var->name) & (count - 1);
+            var->next = grown[bucket];
+            grown[bucket] = var;
+        }
+    }
+    free(table);
+    table = grown;
+    bucket_count = count;
+    return 0;
+} // int grow()
+
+/*
+ * ############################################################
+ * #######   VARIABLES
+ * ############################################################
+ */
+
+static const char* positional(const char *name)
+{
+    if(name[0] == '#')
+        return frames->count;
+    if(name[0] == '@' || name[0] == '*')
+        return frames->all;
+
+    int index = atoi(name);
+    return index < frames->argc ? frames->argv[index] : NULL;
+} // const char* positional(const char*)
+
+// Positional parameters of the call, shell variables, then the environment
+const char* vars_get(const char *name)
+{
+    struct var *var;
+
+    if(frames != NULL && ((name[0] >= '1' && name[0] <= '9')
+                          || ((name[0] == '#' || name[0] == '@' || name[0] == '*') && name[1] == '\0')))
+        return positional(name);
+
+    var = find(name);
+
+    if(var != NULL)
+        return var->value;
+    return getenv(name);
+} // const char* vars_get(const char*)
+
+/*
+ * A variable already in the environment stays exported, so PATH=...
+ * is seen by the commands started after it.
+ */
+int vars_set(const char *name, const char *value)
+{
+    struct var *var = find(name);
+    size_t len = strlen(value);
+
+    if(var == NULL)
+    {
+        if((var_count >= bucket_count && grow() == -1)
+           || (var = calloc(1, sizeof(struct var))) == NULL)
+            return -1;
+        var->name = strdup(name);
+        if(var->name == NULL)
+        {
+            free(var);
+            return -1;
+        }
+        size_t bucket = hash_name(name) & (bucket_count - 1);
+        var->next = table[bucket];
+        table[bucket] = var;
+        var->exported = getenv(name) != NULL;
+        ++var_count;
+    }
+
+    // Loop counters are set again and again, keep the buffer
+    if(len + 1 > var->capacity)
+    {
+        size_t capacity = len + 1 < 32 ? 32 : len + 1;
+        char *value_buffer = realloc(var->value, capacity);
+        if(value_buffer == NULL)
+            return -1;
+        var->value = value_buffer;
+        var->capacity = capacity;
+    }
+    memcpy(var->value, value, len + 1);
+
+    if(var->exported)
+        setenv(name, value, 1);
+    return 0;
+} // int vars_set(const char*, const char*)
+
+int vars_unset(const char *name)
+{
+    struct var **link;
+
+    unsetenv(name);
+    if(table == NULL)
+        return 0;
+    for(link = &table[hash_name(name) & (bucket_count - 1)]; *link != NULL; link = &(*link)->next)
+    {
+        if(strcmp((*link)->name, name) == 0)
+        {
+            struct var *var = *link;
+            *link = var->next;
+            free(var->name);
+            free(var->value);
+            free(var);
+            --var_count;
+            break;
+        }
+    }
+    return 0;
+} // int vars_unset(const char*)
+
+// Unset or not a number is 0, like in bash arithmetic
+long long vars_get_int(const char *name)
+{
+    const char *value = vars_get(name);
+
+    if(value == NULL)
+        return 0;
+    return strtoll(value, NULL, 0);
+} // long long vars_get_int(const char*)
+
+int vars_set_int(const char *name, long long value)
+{
+    char buffer[24];
+
+    snprintf(buffer, sizeof(buffer), "%lld", value);
+    return vars_set(name, buffer);
+} // int vars_set_int(const char*, long long)
+
+int vars_is_name(const char *name, size_t len)
+{
+    size_t i;
+
+    if(len == 0 || isdigit((unsigned char)name[0]))
+        return 0;
+    for(i = 0; i < len; ++i)
+    {
+        if(!isalnum((unsigned char)name[i]) && name[i] != '_')
+            return 0;
+    }
+    return 1;
+} // int vars_is_name(const char*, size_t)
+
+int vars_is_assignment(const char *word)
+{
+    const char *equal = strchr(word, '=');
+
+    return equal != NULL && vars_is_name(word, equal - word);
+} // int vars_is_assignment(const char*)
+
+// name=value, returns -1 if word is not an assignment
+int vars_assign(const char *word)
+{
+    char name[256];
+    const char *equal = strchr(word, '=');
+
+    if(equal == NULL || !vars_is_name(word, equal - word) || (size_t)(equal - word) >= sizeof(name))
+        return -1;
+    memcpy(name, word, equal - word);
+    name[equal - word] = '\0';
+    return vars_set(name, equal + 1);
+} // int vars_assign(const char*)
+
+/*
+ * ############################################################
+ * #######   ARRAYS
+ * ############################################################
+ */
+
+/*
+ * An array is the variables name[0] to name[count - 1] and name[#]
+ * holding count, name is its first element like in bash. Brackets
+ * are not allowed in assignments, so only arrays set them.
+ */
+int vars_set_array(const char *name, char **values, size_t count)
+{
+    char key[256 + 32];
+    size_t old = vars_array_count(name), i;
+
+    if(strlen(name) >= 256)
+        return -1;
+    for(i = count; i < old; ++i)
+    {
+        snprintf(key, sizeof(key), "%s[%zu]", name, i);
+        vars_unset(key);
+    }
+    for(i = 0; i < count; ++i)
+    {
+        snprintf(key, sizeof(key), "%s[%zu]", name, i);
+        if(vars_set(key, values[i]) == -1)
+            return -1;
+    }
+    snprintf(key, sizeof(key), "%s[#]", name);
+    if(vars_set_int(key, count) == -1)
+        return -1;
+    if(count == 0)
+        return vars_unset(name);
+    return vars_set(name, values[0]);
+} // int vars_set_array(const char*, char**, size_t)
+
+size_t vars_array_count(const char *name)
+{
+    char key[256 + 32];
+    struct var *var;
+
+    snprintf(key, sizeof(key), "%s[#]", name);
+    var = find(key);
+    return var != NULL ? strtoul(var->value, NULL, 10) : 0;
+} // size_t vars_array_count(const char*)
+
+/*
+ * ############################################################
+ * #######   EXPANSION
+ * ############################################################
+ */
+
+static int append(char *output, size_t size, size_t *len, const char *text, size_t count)
+{
+    if(*len + count >= size)
+    {
+        ERROR("Expansion too long", "\n");
+        return -1;
+    }
+    memcpy(output + *len, text, count);
+    *len += count;
+    return 0;
+} // int append(char*, size_t, size_t*, const char*, size_t)
+
+/*
+ * ${name[index]}, ${name[@]}, ${#name[@]} and ${#name} : elements and
+ * count of arrays, length of variables. The index is arithmetic.
+ */
+static int expand_array(char *name, char *output, size_t size, size_t *len)
+{
+    char key[256 + 32];
+    int count_only = name[0] == '#';
+    char *bracket;
+    const char *value;
+    size_t i, count;
+
+    if(count_only)
+        ++name;
+    bracket = strchr(name, '[');
+    if(bracket == NULL)
+    {
+        // ${#name}
+        value = vars_get(name);
+        snprintf(key, sizeof(key), "%zu", value != NULL ? strlen(value) : 0);
+        return append(output, size, len, key, strlen(key));
+    }
+
+    size_t index_len = strlen(bracket + 1);
+    if(!vars_is_name(name, bracket - name) || index_len == 0 || bracket[index_len] != ']')
+    {
+        ERROR("Bad substitution", name);
+        return -1;
+    }
+    *bracket = '\0';
+    bracket[index_len] = '\0';
+    count = vars_array_count(name);
+
+    if(strcmp(bracket + 1, "@") == 0 || strcmp(bracket + 1, "*") == 0)
+    {
+        if(count_only)
+        {
+            snprintf(key, sizeof(key), "%zu", count);
+            return append(output, size, len, key, strlen(key));
+        }
+        for(i = 0; i < count; ++i)
+        {
+            snprintf(key, sizeof(key), "%s[%zu]", name, i);
+            value = vars_get(key);
+            if((i > 0 && append(output, size, len, " ", 1) == -1)
+               || (value != NULL && append(output, size, len, value, strlen(value)) == -1))
+                return -1;
+        }
+        return 0;
+    }
+
+    long long index;
+    if(arith_eval(bracket + 1, index_len - 1, &index) == -1)
+    {
+        ERROR("Array index", arith_error());
+        return -1;
+    }
+    // Negative indexes count from the end
+    if(index < 0)
+        index += count;
+    snprintf(key, sizeof(key), "%s[%lld]", name, index);
+    value = index >= 0 ? vars_get(key) : NULL;
+    if(count_only)
+    {
+        snprintf(key, sizeof(key), "%zu", value != NULL ? strlen(value) : 0);
+        value = key;
+    }
+    if(value == NULL)
+        return 0;
+    return append(output, size, len, value, strlen(value));
+} // int expand_array(char*, char*, size_t, size_t*)
+
+// End of the $(( )) starting at text, NULL if not closed
+static const char* arith_end(const char *text)
+{
+    int depth = 0;
+
+    for(; *text != '\0'; ++text)
+    {
+        if(*text == '(')
+            ++depth;
+        else if(*text == ')')
+        {
+            if(depth == 0 && text[1] == ')')
+                return text;
+            if(--depth < 0)
+                return NULL;
+        }
+    }
+    return NULL;
+} // const char* arith_end(const char*)
+
+/*
+ * Expand $name, ${name}, arrays, $$ and $((expression)) of input into output.
+ * The expression text is not expanded first, its variables are read
+ * by the compiled form so the cached compilation stays valid.
+ */
+int vars_expand(const char *input, char *output, size_t size)
+{
+    char name[256];
+    size_t len = 0;
+    const char *c = input;
+
+    while(*c != '\0')
+    {
+        const char *dollar = strchr(c, '$');
+        if(dollar == NULL)
+            dollar = c + strlen(c);
+        if(append(output, size, &len, c, dollar - c) == -1)
+            return -1;
+        c = dollar;
+        if(*c == '\0')
+            break;
+
+        const char *value = NULL;
+        const char *next = c + 1;
+
+        if(strncmp(c, "$((", 3) == 0)
+        {
+            const char *end = arith_end(c + 3);
+            long long result;
+            if(end == NULL)
+            {
+                ERROR("Arithmetic expansion", "missing ))");
+                return -1;
+            }
+            if(arith_eval(c + 3, end - (c + 3), &result) == -1)
+            {
+                ERROR("Arithmetic expansion", arith_error());
+                return -1;
+            }
+            snprintf(name, sizeof(name), "%lld", result);
+            value = name;
+            next = end + 2;
+        }
+        else if(c[1] == '{')
+        {
+            const char *end = strchr(c + 2, '}');
+            if(end == NULL || (size_t)(end - c - 2) >= sizeof(name))
+            {
+                ERROR("Bad substitution", c);
+                return -1;
+            }
+            memcpy(name, c + 2, end - c - 2);
+            name[end - c - 2] = '\0';
+            next = end + 1;
+            if((name[0] == '#' && name[1] != '\0') || strchr(name, '[') != NULL)
+            {
+                if(expand_array(name, output, size, &len) == -1)
+                    return -1;
+            }
+            else
+                value = vars_get(name);
+        }
+        else if(c[1] == '$')
+        {
+            snprintf(name, sizeof(name), "%ld", (long)getpid());
+            value = name;
+            next = c + 2;
+        }
+        else if(isdigit((unsigned char)c[1]) || (c[1] != '\0' && strchr("?#@*!", c[1]) != NULL))
+        {
+            // Special parameters are single characters
+            name[0] = c[1];
+            name[1] = '\0';
+            value = vars_get(name);
+            next = c + 2;
+        }
+        else if(isalpha((unsigned char)c[1]) || c[1] == '_')
+        {
+            size_t n = 1;
+            while(isalnum((unsigned char)c[n + 1]) || c[n + 1] == '_')
+                ++n;
+            if(n >= sizeof(name))
+                n = sizeof(name) - 1;
+            memcpy(name, c + 1, n);
+            name[n] = '\0';
+            value = vars_get(name);
+            next = c + 1 + n;
+        }
+        else
+        {
+            // A lone $ is kept
+            value = "$";
+        }
+
+        if(value != NULL && append(output, size, &len, value, strlen(value)) == -1)
+            return -1;
+        c = next;
+    }
+
+    output[len] = '\0';
+    return 0;
+} // int vars_expand(const char*, char*, size_t)
+
+/*
+ * ############################################################
+ * #######   FUNCTION CALLS
+ * ############################################################
+ */
+
+// argv[0] is the function name, $0 stays the one of the shell
+int vars_push_args(int argc, char **argv)
+{
+    struct var_frame *frame = calloc(1, sizeof(struct var_frame));
+    size_t size = 1;
+    int i;
+
+    if(frame == NULL || (frame->argv = calloc(argc + 1, sizeof(char*))) == NULL)
+    {
+        free(frame);
+        return -1;
+    }
+    frame->argc = argc;
+    for(i = 0; i < argc; ++i)
+    {
+        frame->argv[i] = strdup(argv[i]);
+        size += strlen(argv[i]) + 1;
+    }
+
+    // "$@" is a single word list in this shell, as "$*"
+    frame->all = malloc(size);
+    if(frame->all == NULL)
+    {
+        for(i = 0; i < argc; ++i)
+            free(frame->argv[i]);
+        free(frame->argv);
+        free(frame);
+        return -1;
+    }
+    frame->all[0] = '\0';
+    for(i = 1; i < argc; ++i)
+    {
+        if(i > 1)
+            strcat(frame->all, " ");
+        strcat(frame->all, frame->argv[i]);
+    }
+    snprintf(frame->count, sizeof(frame->count), "%d", argc - 1);
+
+    frame->prev = frames;
+    frames = frame;
+    return 0;
+} // int vars_push_args(int, char**)
+
+void vars_pop_args(void)
+{
+    struct var_frame *frame = frames;
+    int i;
+
+    if(frame == NULL)
+        return;
+    frames = frame->prev;
+
+    // Locals get their outer values back
+    while(frame->saved != NULL)
+    {
+        struct var_saved *saved = frame->saved;
+        frame->saved = saved->next;
+        if(saved->value == NULL)
+            vars_unset(saved->name);
+        else
+            vars_set(saved->name, saved->value);
+        free(saved->name);
+        free(saved->value);
+        free(saved);
+    }
+
+    for(i = 0; i < frame->argc; ++i)
+        free(frame->argv[i]);
+    free(frame->argv);
+    free(frame->all);
+    free(frame);
+} // vars_pop_args()
+
+// name is restored when the current call returns, -1 out of a function
+int vars_local(const char *name)
+{
+    struct var_saved *saved;
+    const char *value;
+
+    if(frames == NULL)
+        return -1;
+    for(saved = frames->saved; saved != NULL; saved = saved->next)
+    {
+        if(strcmp(saved->name, name) == 0)
+            return 0;
+    }
+
+    saved = calloc(1, sizeof(struct var_saved));
+    if(saved == NULL)
+        return -1;
+    saved->name = strdup(name);
+    value = vars_get(name);
+    saved->value = value != NULL ? strdup(value) : NULL;
+    saved->next = frames->saved;
+    frames->saved = saved;
+    return 0;
+} // int vars_local(const char*)
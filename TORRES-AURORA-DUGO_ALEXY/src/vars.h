@@ -0,0 +1,71 @@
+#ifndef DEF_VARS_H
+#define DEF_VARS_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+// Initial buckets of the variable table, doubled when full
+#define VARS_BUCKETS 256
+
+/*
+ * ############################################################
+ * #######   VARIABLES
+ * ############################################################
+ */
+
+// Shell variable, the value buffer is reused by later assignments
+struct var {
+    char *name;
+    char *value;
+    size_t capacity;            /* size of the value buffer */
+    int exported;               /* was in the environment, kept in sync */
+    struct var *next;
+}; // struct var
+
+const char* vars_get(const char *name);
+int vars_set(const char *name, const char *value);
+int vars_unset(const char *name);
+long long vars_get_int(const char *name);
+int vars_set_int(const char *name, long long value);
+int vars_is_name(const char *name, size_t len);
+int vars_is_assignment(const char *word);
+int vars_assign(const char *word);
+int vars_expand(const char *input, char *output, size_t size);
+
+/*
+ * ############################################################
+ * #######   ARRAYS
+ * ############################################################
+ */
+
+int vars_set_array(const char *name, char **values, size_t count);
+size_t vars_array_count(const char *name);
+
+/*
+ * ############################################################
+ * #######   FUNCTION CALLS
+ * ############################################################
+ */
+
+// Value hidden by local, restored when the call returns
+struct var_saved {
+    char *name;
+    char *value;                /* NULL if it was unset */
+    struct var_saved *next;
+}; // struct var_saved
+
+// Positional parameters and locals of one function call
+struct var_frame {
+    int argc;
+    char **argv;                /* argv[1] is $1 */
+    char *all;                  /* $@ and $*, joined by spaces */
+    char count[16];             /* $# */
+    struct var_saved *saved;
+    struct var_frame *prev;
+}; // struct var_frame
+
+int vars_push_args(int argc, char **argv);
+void vars_pop_args(void);
+int vars_local(const char *name);
+
+#endif // DEF_VARS_H
@@ -0,0 +1,623 @@
+// Needed for O_DIRECTORY, fstatat and syscall
+#define _GNU_SOURCE
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <signal.h>
+#include <dirent.h>
+#include <limits.h>
+#include <errno.h>
+
+// HEADER
+#include "walk.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+// Record of getdents64, the libc may not have a wrapper
+struct walk_dirent {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+}; // struct walk_dirent
+
+/*
+ * Directory to read. The pattern is matched like an automaton : bit s
+ * of states is set when the components before s matched the path.
+ */
+struct walk_item {
+    char *path;                 /* relative to the top of the walk */
+    size_t len;
+    uint64_t states;
+}; // struct walk_item
+
+// Deque of a thread, it pops at the tail and the others steal at the head
+struct walk_queue {
+    pthread_mutex_t lock;
+    struct walk_item *items;
+    size_t head;
+    size_t tail;
+    size_t capacity;
+}; // struct walk_queue
+
+struct walk_prune {
+    char *pattern;
+    int dir_only;
+    int anchored;               /* matched against the path, not the name */
+}; // struct walk_prune
+
+struct walk;
+
+struct walk_worker {
+    struct walk *walk;
+    int index;
+    pthread_t thread;
+    int started;
+    struct walk_queue queue;
+    char **matches;
+    size_t count;
+    size_t capacity;
+    char *dirents;
+    char path[PATH_MAX];        /* prefix of the pattern, then the entry */
+}; // struct walk_worker
+
+struct walk {
+    int fd;                     /* top of the walk */
+    size_t prefix_len;
+    char *components[WALK_DEPTH_MAX];
+    int globstar[WALK_DEPTH_MAX];
+    int literal[WALK_DEPTH_MAX];
+    int depth;
+    struct walk_prune *prune;
+    int prune_count;
+    struct walk_worker *workers;
+    int count;
+    long pending;               /* directories pushed, not read yet */
+    long queued;                /* directories in the deques */
+    int sleepers;
+    int failed;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+}; // struct walk
+
+#define STATE(s) ((uint64_t)1 << (s))
+
+/*
+ * ############################################################
+ * #######   MATCHING
+ * ############################################################
+ */
+
+// ** also matches no directory, the next component is tried right away
+static uint64_t closure(const struct walk *walk, uint64_t states)
+{
+    int s;
+
+    for(s = 0; s < walk->depth; ++s)
+    {
+        if((states & STATE(s)) && walk->globstar[s])
+            states |= STATE(s + 1);
+    }
+    return states;
+} // uint64_t closure(const struct walk*, uint64_t)
+
+/*
+ * States after an entry of a directory reached with states. ** goes
+ * down directories but hidden ones, as the last component it matches
+ * every entry.
+ */
+static uint64_t step(const struct walk *walk, uint64_t states, const char *name, int is_dir)
+{
+    uint64_t next = 0;
+    int s, hidden = name[0] == '.';
+
+    for(s = 0; s < walk->depth; ++s)
+    {
+        if(!(states & STATE(s)))
+            continue;
+        if(walk->globstar[s])
+        {
+            if(hidden)
+                continue;
+            if(is_dir)
+                next |= STATE(s);
+            if(s == walk->depth - 1)
+                next |= STATE(walk->depth);
+        }
+        else if(walk->literal[s] ? strcmp(walk->components[s], name) == 0
+                                 : fnmatch(walk->components[s], name, FNM_PERIOD) == 0)
+            next |= STATE(s + 1);
+    }
+    return closure(walk, next);
+} // uint64_t step(const struct walk*, uint64_t, const char*, int)
+
+static int pruned(const struct walk *walk, const char *name, const char *path, int is_dir)
+{
+    int i;
+
+    for(i = 0; i < walk->prune_count; ++i)
+    {
+        const struct walk_prune *prune = &walk->prune[i];
+        if(prune->dir_only && !is_dir)
+            continue;
+        if(prune->anchored ? fnmatch(prune->pattern, path, FNM_PATHNAME) == 0
+                           : fnmatch(prune->pattern, name, 0) == 0)
+            return 1;
+    }
+    return 0;
+} // int pruned(const struct walk*, const char*, const char*, int)
+
+static int parse_prune(struct walk *walk, const char *list)
+{
+    char *copy, *saved_ptr = NULL, *entry;
+    int count = 1;
+    const char *c;
+
+    walk->prune_count = 0;
+    if(list == NULL || list[0] == '\0')
+        return 0;
+    for(c = list; *c != '\0'; ++c)
+        count += *c == ':';
+    walk->prune = calloc(count, sizeof(struct walk_prune));
+    if(walk->prune == NULL)
+        return -1;
+
+    copy = strdup(list);
+    if(copy == NULL)
+        return -1;
+    for(entry = strtok_r(copy, ":", &saved_ptr); entry != NULL; entry = strtok_r(NULL, ":", &saved_ptr))
+    {
+        struct walk_prune *prune = &walk->prune[walk->prune_count];
+        size_t len = strlen(entry);
+
+        if(len > 1 && entry[len - 1] == '/')
+        {
+            entry[--len] = '\0';
+            prune->dir_only = 1;
+        }
+        int leading = entry[0] == '/';
+        if(leading)
+            ++entry;
+        if(entry[0] == '\0')
+            continue;
+        prune->anchored = leading || strchr(entry, '/') != NULL;
+        prune->pattern = strdup(entry);
+        if(prune->pattern == NULL)
+            break;
+        ++walk->prune_count;
+    }
+    free(copy);
+    return 0;
+} // int parse_prune(struct walk*, const char*)
+
+/*
+ * ############################################################
+ * #######   WORK STEALING
+ * ############################################################
+ */
+
+static int queue_push(struct walk_queue *queue, struct walk_item *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    if(queue->tail == queue->capacity)
+    {
+        // Stolen items leave room at the head
+        if(queue->head > queue->capacity / 2)
+        {
+            memmove(queue->items, queue->items + queue->head,
+                    (queue->tail - queue->head) * sizeof(struct walk_item));
+            queue->tail -= queue->head;
+            queue->head = 0;
+        }
+        else
+        {
+            size_t capacity = queue->capacity ? queue->capacity * 2 : 64;
+            struct walk_item *grown = realloc(queue->items, capacity * sizeof(struct walk_item));
+            if(grown == NULL)
+            {
+                pthread_mutex_unlock(&queue->lock);
+                return -1;
+            }
+            queue->items = grown;
+            queue->capacity = capacity;
+        }
+    }
+    queue->items[queue->tail++] = *item;
+    pthread_mutex_unlock(&queue->lock);
+    return 0;
+} // int queue_push(struct walk_queue*, struct walk_item*)
+
+// The newest item of its own deque, depth first like a recursion
+static int queue_pop(struct walk_queue *queue, struct walk_item *item)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if(queue->tail > queue->head)
+    {
+        *item = queue->items[--queue->tail];
+        found = 1;
+        if(queue->tail == queue->head)
+            queue->tail = queue->head = 0;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+} // int queue_pop(struct walk_queue*, struct walk_item*)
+
+// The oldest item of another deque, the top of a large subtree
+static int queue_steal(struct walk_queue *queue, struct walk_item *item)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if(queue->tail > queue->head)
+    {
+        *item = queue->items[queue->head++];
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+} // int queue_steal(struct walk_queue*, struct walk_item*)
+
+static void push(struct walk_worker *worker, char *path, size_t len, uint64_t states)
+{
+    struct walk *walk = worker->walk;
+    struct walk_item item = {path, len, states};
+
+    __atomic_add_fetch(&walk->pending, 1, __ATOMIC_SEQ_CST);
+    if(path == NULL || queue_push(&worker->queue, &item) == -1)
+    {
+        free(path);
+        walk->failed = 1;
+        __atomic_sub_fetch(&walk->pending, 1, __ATOMIC_SEQ_CST);
+        return;
+    }
+    __atomic_add_fetch(&walk->queued, 1, __ATOMIC_SEQ_CST);
+
+    // Sleepers check queued under the lock, they can't miss this one
+    if(__atomic_load_n(&walk->sleepers, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&walk->idle_lock);
+        pthread_cond_signal(&walk->idle_cond);
+        pthread_mutex_unlock(&walk->idle_lock);
+    }
+} // push(struct walk_worker*, char*, size_t, uint64_t)
+
+static int take(struct walk_worker *worker, struct walk_item *item)
+{
+    struct walk *walk = worker->walk;
+    int i, found = queue_pop(&worker->queue, item);
+
+    for(i = 1; !found && i < walk->count; ++i)
+        found = queue_steal(&walk->workers[(worker->index + i) % walk->count].queue, item);
+    if(found)
+        __atomic_sub_fetch(&walk->queued, 1, __ATOMIC_SEQ_CST);
+    return found;
+} // int take(struct walk_worker*, struct walk_item*)
+
+/*
+ * ############################################################
+ * #######   WALK
+ * ############################################################
+ */
+
+static void add_match(struct walk_worker *worker, const char *path)
+{
+    if(worker->count == worker->capacity)
+    {
+        size_t capacity = worker->capacity ? worker->capacity * 2 : 256;
+        char **grown = realloc(worker->matches, capacity * sizeof(char*));
+        if(grown == NULL)
+        {
+            worker->walk->failed = 1;
+            return;
+        }
+        worker->matches = grown;
+        worker->capacity = capacity;
+    }
+    if((worker->matches[worker->count] = strdup(path)) == NULL)
+        worker->walk->failed = 1;
+    else
+        ++worker->count;
+} // add_match(struct walk_worker*, const char*)
+
+static void visit(struct walk_worker *worker, const struct walk_item *item, const char *name, int is_dir)
+{
+    struct walk *walk = worker->walk;
+    char *path = worker->path + walk->prefix_len;
+    size_t name_len = strlen(name);
+    size_t len = item->len + (item->len > 0) + name_len;
+    uint64_t states = step(walk, item->states, name, is_dir);
+
+    if(states == 0 || walk->prefix_len + len >= PATH_MAX)
+        return;
+    if(item->len > 0)
+    {
+        memcpy(path, item->path, item->len);
+        path[item->len] = '/';
+    }
+    memcpy(path + len - name_len, name, name_len + 1);
+    if(walk->prune_count > 0 && pruned(walk, name, path, is_dir))
+        return;
+
+    if(states & STATE(walk->depth))
+        add_match(worker, worker->path);
+    states &= ~STATE(walk->depth);
+    if(is_dir && states != 0)
+        push(worker, strdup(path), len, states);
+} // visit(struct walk_worker*, const struct walk_item*, const char*, int)
+
+static void read_directory(struct walk_worker *worker, struct walk_item *item)
+{
+    int fd = openat(worker->walk->fd, item->len > 0 ? item->path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    long ret;
+
+    // Unreadable directories are left out like glob does
+    if(fd == -1)
+        return;
+    while((ret = syscall(SYS_getdents64, fd, worker->dirents, WALK_DIRENT_SIZE)) > 0)
+    {
+        long offset;
+        for(offset = 0; offset < ret;)
+        {
+            struct walk_dirent *entry = (struct walk_dirent*)(worker->dirents + offset);
+            const char *name = entry->d_name;
+            offset += entry->d_reclen;
+
+            if(name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+                continue;
+            int is_dir = entry->d_type == DT_DIR;
+            if(entry->d_type == DT_UNKNOWN)
+            {
+                struct stat st;
+                is_dir = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+            }
+            visit(worker, item, name, is_dir);
+        }
+    }
+    close(fd);
+} // read_directory(struct walk_worker*, struct walk_item*)
+
+static void* work(void *data)
+{
+    struct walk_worker *worker = data;
+    struct walk *walk = worker->walk;
+    struct walk_item item;
+
+    for(;;)
+    {
+        if(take(worker, &item))
+        {
+            read_directory(worker, &item);
+            free(item.path);
+            if(__atomic_sub_fetch(&walk->pending, 1, __ATOMIC_SEQ_CST) == 0)
+            {
+                pthread_mutex_lock(&walk->idle_lock);
+                pthread_cond_broadcast(&walk->idle_cond);
+                pthread_mutex_unlock(&walk->idle_lock);
+            }
+            continue;
+        }
+
+        // Nothing to steal, sleep until a push or the end of the walk
+        pthread_mutex_lock(&walk->idle_lock);
+        __atomic_add_fetch(&walk->sleepers, 1, __ATOMIC_SEQ_CST);
+        while(__atomic_load_n(&walk->queued, __ATOMIC_SEQ_CST) == 0
+              && __atomic_load_n(&walk->pending, __ATOMIC_SEQ_CST) > 0)
+            pthread_cond_wait(&walk->idle_cond, &walk->idle_lock);
+        __atomic_sub_fetch(&walk->sleepers, 1, __ATOMIC_SEQ_CST);
+        int done = __atomic_load_n(&walk->pending, __ATOMIC_SEQ_CST) == 0;
+        pthread_mutex_unlock(&walk->idle_lock);
+        if(done)
+            return NULL;
+    }
+} // void* work(void*)
+
+static int compare_paths(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+} // int compare_paths(const void*, const void*)
+
+/*
+ * Literal directory of pattern, written in prefix with a trailing /,
+ * and its other components. Returns the length of the prefix, -1 if
+ * the pattern has too many components.
+ */
+static int split_pattern(struct walk *walk, char *pattern, char *prefix)
+{
+    char *saved_ptr = NULL, *component;
+    size_t len = 0;
+    int literal = 1;
+
+    prefix[0] = '\0';
+    if(pattern[0] == '/')
+        prefix[len++] = '/';
+    walk->depth = 0;
+    for(component = strtok_r(pattern, "/", &saved_ptr); component != NULL;
+        component = strtok_r(NULL, "/", &saved_ptr))
+    {
+        if(literal && strpbrk(component, "*?[") == NULL)
+        {
+            size_t component_len = strlen(component);
+            if(len + component_len + 2 >= PATH_MAX)
+                return -1;
+            memcpy(prefix + len, component, component_len);
+            len += component_len;
+            prefix[len++] = '/';
+            continue;
+        }
+        literal = 0;
+
+        int globstar = strcmp(component, "**") == 0;
+        // a/**/**/b is a/**/b
+        if(globstar && walk->depth > 0 && walk->globstar[walk->depth - 1])
+            continue;
+        if(walk->depth == WALK_DEPTH_MAX)
+            return -1;
+        walk->components[walk->depth] = component;
+        walk->globstar[walk->depth] = globstar;
+        walk->literal[walk->depth] = strpbrk(component, "*?[\\") == NULL;
+        ++walk->depth;
+    }
+    prefix[len] = '\0';
+    return (int)len;
+} // int split_pattern(struct walk*, char*, char*)
+
+// Runs the threads, the calling one is the first of them
+static void run_workers(struct walk *walk, const char *prefix)
+{
+    sigset_t all, old;
+    int i;
+
+    for(i = 0; i < walk->count; ++i)
+    {
+        struct walk_worker *worker = &walk->workers[i];
+        worker->walk = walk;
+        worker->index = i;
+        pthread_mutex_init(&worker->queue.lock, NULL);
+        worker->dirents = malloc(WALK_DIRENT_SIZE);
+        if(worker->dirents == NULL)
+            walk->failed = 1;
+        memcpy(worker->path, prefix, walk->prefix_len);
+    }
+    if(walk->failed)
+        return;
+    push(&walk->workers[0], strdup(""), 0, closure(walk, STATE(0)));
+
+    // Signals are for the shell thread
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    for(i = 1; i < walk->count; ++i)
+        walk->workers[i].started = pthread_create(&walk->workers[i].thread, NULL, work, &walk->workers[i]) == 0;
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    work(&walk->workers[0]);
+    for(i = 1; i < walk->count; ++i)
+    {
+        if(walk->workers[i].started)
+            pthread_join(walk->workers[i].thread, NULL);
+    }
+} // run_workers(struct walk*, const char*)
+
+// Matches of every thread sorted together, the workers are freed
+static int gather(struct walk *walk, struct walk_result *result)
+{
+    size_t total = 0;
+    int i, ret = 0;
+
+    for(i = 0; i < walk->count; ++i)
+        total += walk->workers[i].count;
+    if(!walk->failed && total > 0 && (result->paths = malloc(total * sizeof(char*))) != NULL)
+    {
+        for(i = 0; i < walk->count; ++i)
+        {
+            memcpy(result->paths + result->count, walk->workers[i].matches,
+                   walk->workers[i].count * sizeof(char*));
+            result->count += walk->workers[i].count;
+            walk->workers[i].count = 0;
+        }
+        qsort(result->paths, result->count, sizeof(char*), compare_paths);
+    }
+    else if(total > 0 || walk->failed)
+        ret = -1;
+
+    for(i = 0; i < walk->count; ++i)
+    {
+        struct walk_worker *worker = &walk->workers[i];
+        size_t match;
+        for(match = 0; match < worker->count; ++match)
+            free(worker->matches[match]);
+        free(worker->matches);
+        free(worker->queue.items);
+        free(worker->dirents);
+        pthread_mutex_destroy(&worker->queue.lock);
+    }
+    return ret;
+} // int gather(struct walk*, struct walk_result*)
+
+/*
+ * Paths matching pattern from dirfd, where ** matches any number of
+ * directories. The tree under the literal directory of the pattern is
+ * read by threads stealing directories from each other. Entries
+ * matching the prune list are neither matched nor entered, symbolic
+ * links are not followed. Returns 0, with no path if nothing matched,
+ * or -1.
+ */
+int walk_glob(int dirfd, const char *pattern, const char *prune, int threads, struct walk_result *result)
+{
+    struct walk walk;
+    char prefix[PATH_MAX];
+    char *copy = strdup(pattern);
+    int i, prefix_len, ret = -1;
+
+    result->paths = NULL;
+    result->count = 0;
+    memset(&walk, 0, sizeof(walk));
+    if(copy == NULL)
+        return -1;
+
+    prefix_len = split_pattern(&walk, copy, prefix);
+    if(prefix_len != -1 && walk.depth > 0 && parse_prune(&walk, prune) == 0)
+    {
+        walk.prefix_len = prefix_len;
+        walk.fd = openat(dirfd, prefix_len > 0 ? prefix : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+        if(threads <= 0)
+            threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if(threads < 1)
+            threads = 1;
+        if(threads > WALK_THREADS_MAX)
+            threads = WALK_THREADS_MAX;
+
+        // A missing directory matches nothing
+        if(walk.fd == -1)
+            ret = 0;
+        else if((walk.workers = calloc(threads, sizeof(struct walk_worker))) != NULL)
+        {
+            walk.count = threads;
+            pthread_mutex_init(&walk.idle_lock, NULL);
+            pthread_cond_init(&walk.idle_cond, NULL);
+            run_workers(&walk, prefix);
+            ret = gather(&walk, result);
+            pthread_mutex_destroy(&walk.idle_lock);
+            pthread_cond_destroy(&walk.idle_cond);
+            free(walk.workers);
+        }
+        if(walk.fd != -1)
+            close(walk.fd);
+    }
+
+    for(i = 0; i < walk.prune_count; ++i)
+        free(walk.prune[i].pattern);
+    free(walk.prune);
+    free(copy);
+    return ret;
+} // int walk_glob(int, const char*, const char*, int, struct walk_result*)
+
+void walk_free(struct walk_result *result)
+{
+    size_t i;
+
+    for(i = 0; i < result->count; ++i)
+        free(result->paths[i]);
+    free(result->paths);
+    result->paths = NULL;
+    result->count = 0;
+} // walk_free(struct walk_result*)
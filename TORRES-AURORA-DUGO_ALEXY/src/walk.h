@@ -0,0 +1,41 @@
+#ifndef DEF_WALK_H
+#define DEF_WALK_H
+
+// STD INCLUDES
+#include <stddef.h>
+
+/*
+ * Shell variables read for ** patterns : the prune list, names or
+ * paths separated by ':' like .gitignore lines (a trailing / for
+ * directories only, a / inside anchors to the top of the walk), and
+ * the number of threads, the online CPUs by default.
+ */
+#define WALK_PRUNE_VAR   "GLOB_PRUNE"
+#define WALK_THREADS_VAR "GLOB_THREADS"
+
+// Most threads walking a tree
+#define WALK_THREADS_MAX 16
+
+// Most components of a pattern after its literal directory, they are
+// the bits of a 64 bit word with one more for a complete match
+#define WALK_DEPTH_MAX 63
+
+// getdents64 buffer of each thread
+#define WALK_DIRENT_SIZE (64 * 1024)
+
+/*
+ * ############################################################
+ * #######   RECURSIVE GLOB
+ * ############################################################
+ */
+
+// Matching paths, sorted
+struct walk_result {
+    char **paths;
+    size_t count;
+}; // struct walk_result
+
+int walk_glob(int dirfd, const char *pattern, const char *prune, int threads, struct walk_result *result);
+void walk_free(struct walk_result *result);
+
+#endif // DEF_WALK_H
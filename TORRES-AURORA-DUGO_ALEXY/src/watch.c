@@ -0,0 +1,190 @@
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// SYSTEM INCLUDES
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+
+// HEADER
+#include "watch.h"
+#include "log.h"
+
+/*
+ * ############################################################
+ * #######   STATE
+ * ############################################################
+ */
+
+static int inotify_fd = -1;
+
+// Path of each watch descriptor, they are small numbers given in order
+static char **paths = NULL;
+static int path_count = 0;
+
+static int remember(int wd, const char *path)
+{
+    if(wd >= path_count)
+    {
+        int count = path_count ? path_count : 64;
+        while(count <= wd)
+            count *= 2;
+        char **grown = realloc(paths, count * sizeof(char*));
+        if(grown == NULL)
+            return -1;
+        memset(grown + path_count, 0, (count - path_count) * sizeof(char*));
+        paths = grown;
+        path_count = count;
+    }
+    // The same inode watched again keeps its descriptor
+    if(paths[wd] != NULL && strcmp(paths[wd], path) == 0)
+        return 0;
+    free(paths[wd]);
+    paths[wd] = strdup(path);
+    return paths[wd] == NULL ? -1 : 0;
+} // int remember(int, const char*)
+
+/*
+ * Watches a directory and its subdirectories, hidden ones like .git
+ * are left out. A file is watched alone.
+ */
+static int add_tree(char *path, size_t len)
+{
+    struct stat st;
+    int wd;
+
+    if(stat(path, &st) == -1)
+        return -1;
+    wd = inotify_add_watch(inotify_fd, path, WATCH_EVENTS);
+    if(wd == -1 || remember(wd, path) == -1)
+        return -1;
+    if(!S_ISDIR(st.st_mode))
+        return 0;
+
+    DIR *dir = opendir(path);
+    struct dirent *entry;
+    if(dir == NULL)
+        return -1;
+    while((entry = readdir(dir)) != NULL)
+    {
+        size_t name_len = strlen(entry->d_name);
+        if(entry->d_name[0] == '.' || len + 1 + name_len >= PATH_MAX)
+            continue;
+        if(entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN)
+            continue;
+
+        path[len] = '/';
+        memcpy(path + len + 1, entry->d_name, name_len + 1);
+        if(entry->d_type == DT_DIR || (stat(path, &st) == 0 && S_ISDIR(st.st_mode)))
+            add_tree(path, len + 1 + name_len);
+        path[len] = '\0';
+    }
+    closedir(dir);
+    return 0;
+} // int add_tree(char*, size_t)
+
+/*
+ * ############################################################
+ * #######   FILE WATCH
+ * ############################################################
+ */
+
+int watch_open(void)
+{
+    if(inotify_fd == -1)
+        inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return inotify_fd;
+} // int watch_open()
+
+int watch_add(const char *path)
+{
+    char buffer[PATH_MAX];
+    size_t len = strlen(path);
+
+    if(len >= PATH_MAX)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memcpy(buffer, path, len + 1);
+    // A trailing / would be doubled in the subdirectories
+    while(len > 1 && buffer[len - 1] == '/')
+        buffer[--len] = '\0';
+    return add_tree(buffer, len);
+} // int watch_add(const char*)
+
+/*
+ * Reads the pending events, returns how many are changes. New
+ * directories are watched, a file replaced by rename is watched again.
+ */
+int watch_read(void)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[PATH_MAX];
+    int changes = 0;
+    ssize_t len;
+
+    while((len = read(inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        char *c = buffer;
+        while(c < buffer + len)
+        {
+            struct inotify_event *event = (struct inotify_event*)c;
+            c += sizeof(struct inotify_event) + event->len;
+
+            const char *dir = event->wd < path_count ? paths[event->wd] : NULL;
+            if(dir == NULL)
+                continue;
+            if(event->mask & IN_IGNORED)
+            {
+                // Watch gone with its inode, the path may exist again
+                snprintf(path, PATH_MAX, "%s", dir);
+                free(paths[event->wd]);
+                paths[event->wd] = NULL;
+                watch_add(path);
+                continue;
+            }
+            if((event->mask & WATCH_EVENTS) == 0)
+                continue;
+            if(event->len > 0 && event->name[0] == '.')
+                continue;
+            if((event->mask & (IN_CREATE | IN_MOVED_TO)) && (event->mask & IN_ISDIR)
+               && snprintf(path, PATH_MAX, "%s/%s", dir, event->name) < PATH_MAX)
+                watch_add(path);
+            ++changes;
+        }
+    }
+    if(len == -1 && errno != EAGAIN)
+        return -1;
+    return changes;
+} // int watch_read()
+
+void watch_close(void)
+{
+    int i;
+
+    if(inotify_fd != -1)
+        close(inotify_fd);
+    inotify_fd = -1;
+    for(i = 0; i < path_count; ++i)
+        free(paths[i]);
+    free(paths);
+    paths = NULL;
+    path_count = 0;
+} // watch_close()
+
+// Monotonic milliseconds, for the debounce
+long long watch_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+} // long long watch_now()
@@ -0,0 +1,29 @@
+#ifndef DEF_WATCH_H
+#define DEF_WATCH_H
+
+// SYSTEM INCLUDES
+#include <sys/inotify.h>
+
+// Quiet time after the last change before the command runs again
+#define WATCH_DEBOUNCE_MS 25
+
+// Time a cancelled run gets after SIGTERM before SIGKILL
+#define WATCH_KILL_GRACE_MS 500
+
+// Changes of a file or in a directory which trigger a run
+#define WATCH_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE \
+                      | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/*
+ * ############################################################
+ * #######   FILE WATCH
+ * ############################################################
+ */
+
+int watch_open(void);
+int watch_add(const char *path);
+int watch_read(void);
+void watch_close(void);
+long long watch_now(void);
+
+#endif // DEF_WATCH_H
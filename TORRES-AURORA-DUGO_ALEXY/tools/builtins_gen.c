@@ -0,0 +1,129 @@
+// Builds the perfect hash of the builtin names of src/builtins.def : a
+// seed for which every name falls in its own slot of a power of two
+// table, written as a header with the lookup function, like gperf.
+//
+// Usage : builtins_gen > builtins_hash.h
+
+// STD INCLUDES
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// Seeds tried for a table size before it is doubled
+#define SEED_TRIES 1000000
+
+// Largest table, slots are signed chars
+#define MAX_SIZE 4096
+
+#define BUILTIN(name, descr, function) name,
+static const char *names[] = {
+#include "builtins.def"
+};
+#undef BUILTIN
+
+#define NAME_COUNT (sizeof(names) / sizeof(names[0]))
+
+// FNV-1a with a seed, the same code is written in the header
+#define HASH_CODE \
+    "    unsigned int hash = BUILTINS_HASH_SEED;\n" \
+    "\n" \
+    "    for(; *name != '\\0'; ++name)\n" \
+    "        hash = (hash ^ (unsigned char)*name) * 16777619u;\n" \
+    "    return hash ^ (hash >> 15);\n"
+
+static unsigned int hash(const char *name, unsigned int seed)
+{
+    unsigned int hash = seed;
+
+    for(; *name != '\0'; ++name)
+        hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash ^ (hash >> 15);
+} // unsigned int hash(const char*, unsigned int)
+
+// Fills slots and returns 0 if seed separates all the names
+static int try_seed(unsigned int seed, unsigned int size, int *slots)
+{
+    unsigned int i;
+
+    for(i = 0; i < size; ++i)
+        slots[i] = -1;
+    for(i = 0; i < NAME_COUNT; ++i)
+    {
+        unsigned int slot = hash(names[i], seed) & (size - 1);
+        if(slots[slot] != -1)
+            return -1;
+        slots[slot] = i;
+    }
+    return 0;
+} // int try_seed(unsigned int, unsigned int, int*)
+
+int main(void)
+{
+    static int slots[MAX_SIZE];
+    unsigned int size = 1, seed = 0, i;
+    int found = 0;
+
+    if(NAME_COUNT > 127)
+    {
+        fprintf(stderr, "builtins_gen : too many builtins\n");
+        return EXIT_FAILURE;
+    }
+    for(i = 0; i < NAME_COUNT; ++i)
+    {
+        if(strpbrk(names[i], "\"\\") != NULL)
+        {
+            fprintf(stderr, "builtins_gen : bad builtin name %s\n", names[i]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Twice the names at least keeps the search short
+    while(size < NAME_COUNT * 2)
+        size *= 2;
+    for(; size <= MAX_SIZE && !found; size *= 2)
+    {
+        for(seed = 2166136261u; seed < 2166136261u + SEED_TRIES; ++seed)
+        {
+            if(try_seed(seed, size, slots) == 0)
+            {
+                found = 1;
+                break;
+            }
+        }
+    }
+    if(!found)
+    {
+        fprintf(stderr, "builtins_gen : no perfect hash found\n");
+        return EXIT_FAILURE;
+    }
+    size /= 2;
+
+    printf("// Generated by tools/builtins_gen.c from src/builtins.def, do not edit\n");
+    printf("#ifndef DEF_BUILTINS_HASH_H\n#define DEF_BUILTINS_HASH_H\n\n");
+    printf("// STD INCLUDES\n#include <string.h>\n\n");
+    printf("#define BUILTINS_COUNT %u\n", (unsigned int)NAME_COUNT);
+    printf("#define BUILTINS_HASH_SIZE %u\n", size);
+    printf("#define BUILTINS_HASH_SEED %uu\n\n", seed);
+
+    printf("static const char *const builtins_names[BUILTINS_COUNT] = {\n");
+    for(i = 0; i < NAME_COUNT; ++i)
+        printf("    \"%s\",\n", names[i]);
+    printf("};\n\n");
+
+    printf("// Index in builtins_names of the name hashed to a slot, -1 for none\n");
+    printf("static const signed char builtins_slots[BUILTINS_HASH_SIZE] = {");
+    for(i = 0; i < size; ++i)
+        printf("%s%d,", i % 16 == 0 ? "\n    " : " ", slots[i]);
+    printf("\n};\n\n");
+
+    printf("static inline unsigned int builtins_hash(const char *name)\n{\n%s}\n\n", HASH_CODE);
+
+    printf("// Index of name in builtins.def, -1 if it is not a builtin\n");
+    printf("static inline int builtins_find(const char *name)\n{\n");
+    printf("    int index = builtins_slots[builtins_hash(name) & (BUILTINS_HASH_SIZE - 1)];\n\n");
+    printf("    if(index == -1 || strcmp(builtins_names[index], name) != 0)\n");
+    printf("        return -1;\n");
+    printf("    return index;\n}\n\n");
+    printf("#endif // DEF_BUILTINS_HASH_H\n");
+    return EXIT_SUCCESS;
+} // int main()